@@ -0,0 +1,205 @@
+// include/health/backend_health.hpp
+/**
+ * @file backend_health.hpp
+ * @brief Активная проверка бэкендов за WireGuard-туннелем.
+ *
+ * Отдельный поток раз в interval отправляет каждому бэкенду пробу:
+ *  - UDP — Long Header с версией вида 0x?a?a?a?a (RFC 9000 §6.3, §15), на который
+ *    QUIC-сервер обязан ответить Version Negotiation; ответ сопоставляется по CID;
+ *  - TCP — неблокирующий connect(), успех — завершённое рукопожатие.
+ * Проба без ответа до следующей считается потерянной; отказ (ICMP unreachable, RST) —
+ * тоже. По ответам ведутся EWMA RTT и доли потерь, а состояние бэкенда меняется
+ * с гистерезисом: fall неудач подряд — «недоступен», rise успехов подряд — «доступен».
+ *
+ * Прокси читают состояние без блокировок (атомарные поля) на каждом новом соединении,
+ * поэтому переключение происходит сразу после смены состояния, без ожидания своих таймеров.
+ *
+ * @author Telian Edward <telianedward@icloud.com>
+ * @assisted-by AI-Assistant
+ * @date 2025-11-20
+ * @version 1.0
+ * @license MIT
+ */
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <netinet/in.h>
+
+constexpr size_t HEALTH_PROBE_SIZE = 1200;         ///< Размер UDP-пробы (минимум для ответа QUIC-сервера)
+constexpr uint32_t HEALTH_PROBE_VERSION = 0x1a2a3a4a; ///< Версия, вынуждающая Version Negotiation
+
+/**
+ * @brief Вид пробы.
+ */
+enum class HealthProbeKind {
+    Udp,  ///< QUIC: Version Negotiation в ответ на неизвестную версию
+    Tcp   ///< TCP: завершение connect()
+};
+
+/**
+ * @brief Проверяемый бэкенд.
+ */
+struct HealthTarget {
+    std::string ip;                          ///< IPv4-адрес
+    int port = 0;                            ///< Порт
+    HealthProbeKind kind = HealthProbeKind::Udp; ///< Вид пробы
+};
+
+/**
+ * @brief Настройки проверки.
+ */
+struct HealthCheckOptions {
+    std::chrono::milliseconds interval{250};  ///< Период проб (он же срок ожидания ответа)
+    unsigned fall = 2;                        ///< Неудач подряд до «недоступен»
+    unsigned rise = 3;                        ///< Успехов подряд до «доступен»
+    double rtt_alpha = 0.125;                 ///< Вес нового замера в EWMA RTT
+    double loss_alpha = 0.1;                  ///< Вес новой пробы в EWMA доли потерь
+    std::chrono::seconds stats_interval{10};  ///< Период вывода RTT и потерь (0 — не выводить)
+};
+
+/**
+ * @brief Состояние одного бэкенда.
+ */
+struct BackendHealthSnapshot {
+    bool up = true;          ///< Доступен
+    uint32_t rtt_us = 0;     ///< EWMA RTT, мкс (0 — ещё нет замеров)
+    uint32_t rtt_last_us = 0; ///< Последний замер RTT, мкс
+    double loss = 0.0;       ///< EWMA доли потерянных проб (0..1)
+    uint64_t probes = 0;     ///< Отправлено проб
+    uint64_t failures = 0;   ///< Потеряно или отклонено
+    uint64_t transitions = 0; ///< Смен состояния
+};
+
+/**
+ * @brief Поток активной проверки бэкендов.
+ *
+ * Все бэкенды изначально считаются доступными. is_up(), snapshot() и generation()
+ * можно вызывать из любого потока.
+ */
+class BackendHealthChecker {
+public:
+    /**
+     * @brief Конструктор.
+     * @param targets Бэкенды; индекс в векторе — индекс в is_up() и snapshot().
+     * @param options Настройки.
+     */
+    explicit BackendHealthChecker(std::vector<HealthTarget> targets, const HealthCheckOptions &options = {});
+
+    /**
+     * @brief Деструктор: останавливает поток проверки.
+     */
+    ~BackendHealthChecker();
+
+    BackendHealthChecker(const BackendHealthChecker &) = delete;
+    BackendHealthChecker &operator=(const BackendHealthChecker &) = delete;
+
+    /**
+     * @brief Запускает поток проверки.
+     * @return false, если адрес бэкенда некорректен или поток уже запущен.
+     */
+    [[nodiscard]] bool start();
+
+    /**
+     * @brief Останавливает поток проверки и ждёт его завершения.
+     */
+    void stop() noexcept;
+
+    /**
+     * @brief Возвращает число бэкендов.
+     */
+    [[nodiscard]] size_t size() const noexcept { return targets_.size(); }
+
+    /**
+     * @brief Проверяет, доступен ли бэкенд (индекс вне диапазона — недоступен).
+     */
+    [[nodiscard]] bool is_up(size_t index) const noexcept
+    {
+        return index < targets_.size() && states_[index].up.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Возвращает счётчик смен состояния всех бэкендов.
+     *
+     * Прокси сравнивает его с запомненным и перестраивает таблицы только при изменении.
+     */
+    [[nodiscard]] uint64_t generation() const noexcept { return generation_.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Возвращает RTT, потери и счётчики бэкенда.
+     */
+    [[nodiscard]] BackendHealthSnapshot snapshot(size_t index) const noexcept;
+
+    /**
+     * @brief Выводит RTT туннеля, потери и состояние каждого бэкенда.
+     */
+    void log_stats() const noexcept;
+
+private:
+    /// Разделяемое состояние бэкенда (пишет поток проверки, читают прокси)
+    struct SharedState {
+        std::atomic<bool> up{true};
+        std::atomic<uint32_t> rtt_us{0};
+        std::atomic<uint32_t> rtt_last_us{0};
+        std::atomic<uint32_t> loss_ppm{0};   ///< EWMA потерь, миллионные доли
+        std::atomic<uint64_t> probes{0};
+        std::atomic<uint64_t> failures{0};
+        std::atomic<uint64_t> transitions{0};
+    };
+
+    /// Состояние пробы (только поток проверки)
+    struct ProbeState {
+        sockaddr_in addr{};
+        int fd = -1;                  ///< UDP: постоянный подключённый сокет; TCP: сокет текущей пробы
+        bool outstanding = false;     ///< Проба ждёт ответа
+        uint64_t seq = 0;             ///< Номер текущей пробы (в CID UDP-пробы)
+        std::chrono::steady_clock::time_point sent_at{};
+        unsigned successes = 0;       ///< Успехов подряд
+        unsigned fails = 0;           ///< Неудач подряд
+        double rtt_us = 0.0;          ///< EWMA RTT
+        double loss = 0.0;            ///< EWMA доли потерь
+    };
+
+    std::vector<HealthTarget> targets_;
+    HealthCheckOptions options_;
+    std::unique_ptr<SharedState[]> states_;
+    std::vector<ProbeState> probes_;
+    std::atomic<uint64_t> generation_{0};
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+    uint64_t probe_tag_ = 0;          ///< Случайная часть CID проб этого процесса
+
+    /**
+     * @brief Цикл потока проверки.
+     */
+    void run() noexcept;
+
+    /**
+     * @brief Отправляет очередную пробу бэкенду.
+     */
+    void send_probe(size_t index) noexcept;
+
+    /**
+     * @brief Обрабатывает готовность сокета пробы.
+     * @param index Бэкенд.
+     * @param revents События poll().
+     */
+    void handle_probe_event(size_t index, short revents) noexcept;
+
+    /**
+     * @brief Учитывает результат пробы: EWMA, гистерезис, смена состояния.
+     * @param index Бэкенд.
+     * @param ok true — ответ получен.
+     */
+    void record_result(size_t index, bool ok) noexcept;
+
+    /**
+     * @brief Закрывает сокет пробы.
+     */
+    void close_probe(ProbeState &probe) noexcept;
+};
@@ -29,10 +29,52 @@
 #include <sys/epoll.h>
 #include <thread>
 #include "../logger/logger.h"
+#include "../health/backend_health.hpp"
 #include <openssl/ssl.h>
 #include <openssl/err.h>
 #include <memory>
 #include <queue>
+#include <array>
+#include <chrono>
+
+constexpr std::chrono::seconds HTTP1_BACKEND_CONNECT_TIMEOUT{5}; ///< Срок установления TCP-соединения с бэкендом
+constexpr std::chrono::seconds HTTP1_STATS_INTERVAL{10};         ///< Период вывода статистики реактора
+constexpr size_t HTTP1_IO_BUFFER_SIZE = 256 * 1024;              ///< Буфер чтения реактора (общий для всех соединений)
+
+/**
+ * @brief Счётчики подключений к бэкенду и гистограмма времени connect().
+ */
+struct Http1ConnectStats {
+    static constexpr size_t BUCKETS = 14; ///< Корзины log2 по миллисекундам: <1, <2, <4, … <4096, ≥4096
+    uint64_t started = 0;        ///< Начато подключений
+    uint64_t connected = 0;      ///< Установлено
+    uint64_t failed = 0;         ///< Отклонено (RST, ICMP unreachable) или ошибка сокета
+    uint64_t timed_out = 0;      ///< Не установлено за HTTP1_BACKEND_CONNECT_TIMEOUT
+    uint64_t early_bytes = 0;    ///< Байт от клиента, поставленных в очередь до подключения бэкенда
+    std::array<uint64_t, BUCKETS> latency{}; ///< latency[0] — меньше 1 мс, latency[i] — [2^(i-1), 2^i) мс
+};
+
+/**
+ * @brief Водяные знаки очереди отправки одного направления (клиент ← бэкенд или бэкенд ← клиент).
+ *
+ * Очередь — байты, прочитанные из источника, но ещё не принятые сокетом получателя.
+ * Для полной загрузки канала high должен быть не меньше BDP пути к получателю.
+ */
+struct Http1QueueWatermarks {
+    size_t high = 1024 * 1024; ///< Выше — источник снимается с EPOLLIN (превышение — не более HTTP1_IO_BUFFER_SIZE)
+    size_t low = 256 * 1024;   ///< Не выше — чтение источника возобновляется
+};
+
+/**
+ * @brief Очереди отправки реактора: текущий объём и срабатывания водяных знаков.
+ */
+struct Http1QueueStats {
+    uint64_t to_clients = 0;  ///< Байт в очередях к клиентам сейчас
+    uint64_t to_backends = 0; ///< Байт в очередях к бэкендам сейчас
+    uint64_t peak = 0;        ///< Наибольшая очередь одного сокета, байт
+    uint64_t paused = 0;      ///< Остановок чтения источника (очередь выше high)
+    uint64_t resumed = 0;     ///< Возобновлений чтения (очередь не выше low)
+};
 
 /**
  * @brief Класс HTTP/1.1 сервера с использованием epoll.
@@ -40,6 +82,8 @@
  * Слушает входящие TCP-соединения на указанном порту и обрабатывает HTTP/1.1 запросы.
  * Поддерживает: GET, HEAD, favicon.ico, main.css, main.js.
  * Использует современный API OpenSSL 3.0+.
+ * В режиме enable_reactors() работает по потоку-реактору на ядро; каждый реактор —
+ * отдельный экземпляр класса со своим сокетом, epoll и соединениями.
  */
 class Http1Server {
 public:
@@ -75,7 +119,64 @@ public:
      */
     [[nodiscard]] bool is_running() const noexcept;
 
+    /**
+     * @brief Добавляет резервный бэкенд (вызывать до run()).
+     *
+     * Используется, только если включена проверка бэкендов и основной недоступен.
+     * @param ip IP-адрес бэкенда.
+     * @param port Порт бэкенда.
+     */
+    void add_backup_backend(const std::string &ip, int port);
+
+    /**
+     * @brief Включает проверку бэкендов TCP-пробами (вызывать до run()).
+     *
+     * Новое соединение подключается к первому доступному бэкенду (основной — первый);
+     * если недоступны все, клиент отключается сразу, без 5-секундного ожидания connect().
+     * @param options Период проб, гистерезис и веса EWMA.
+     */
+    void enable_health_check(const HealthCheckOptions &options = {});
+
+    /**
+     * @brief Включает режим «поток на ядро» (вызывать до run()).
+     *
+     * Каждый поток-реактор открывает свой слушающий сокет на том же порту (SO_REUSEPORT —
+     * ядро распределяет новые соединения), свой epoll и свои карты соединений: TLS handshake
+     * и копирование данных идут параллельно, без блокировок между потоками.
+     * Общие только SSL-контекст и проверка бэкендов.
+     * @param count Число реакторов (0 — по числу доступных ядер).
+     * @param pin_cpu Закрепить i-й реактор за i-м доступным ядром.
+     */
+    void enable_reactors(unsigned count = 0, bool pin_cpu = true);
+
+    /**
+     * @brief Возвращает счётчики подключений к бэкенду этого реактора.
+     */
+    [[nodiscard]] Http1ConnectStats connect_stats() const noexcept { return connect_stats_; }
+
+    /**
+     * @brief Задаёт водяные знаки очередей отправки (вызывать до run()).
+     *
+     * Когда очередь к получателю превышает high, источник перестаёт читаться (снимается EPOLLIN),
+     * и TCP сам притормаживает отправителя; чтение возобновляется, когда очередь опустится до low.
+     * Так память соединения ограничена, даже если клиент медленнее бэкенда.
+     * @param to_client Очередь ответа клиенту (источник — бэкенд).
+     * @param to_backend Очередь запроса бэкенду (источник — клиент).
+     */
+    void set_queue_watermarks(const Http1QueueWatermarks &to_client, const Http1QueueWatermarks &to_backend);
+
+    /**
+     * @brief Возвращает объём очередей отправки этого реактора (для подбора водяных знаков).
+     */
+    [[nodiscard]] Http1QueueStats queue_stats() const noexcept { return queue_stats_; }
+
 private:
+    /// Адрес бэкенда
+    struct BackendEndpoint {
+        std::string ip; ///< IP-адрес
+        int port;       ///< Порт
+    };
+
     // 👇 Структура для отслеживания незавершённых отправок
     struct PendingSend {
         int fd;          ///< Сокет назначения
@@ -99,6 +200,18 @@ private:
         SSL_CTX *ssl_ctx_;                               ///< SSL-контекст для TLS
     int epoll_fd_;                        ///< Дескриптор epoll
 
+    std::vector<BackendEndpoint> backends_;           ///< [0] — основной, далее резервные
+    bool health_check_ = false;                       ///< Включена ли проверка бэкендов
+    HealthCheckOptions health_options_;               ///< Настройки проверки
+    std::shared_ptr<BackendHealthChecker> health_;    ///< Поток проверки (создаётся в run(), общий для реакторов)
+
+    unsigned reactors_ = 1;                           ///< Число реакторов (0 — по числу ядер)
+    bool pin_cpu_ = false;                            ///< Закреплять реакторы за ядрами
+    unsigned reactor_index_ = 0;                      ///< Номер реактора (0 — основной)
+    std::vector<std::unique_ptr<Http1Server>> workers_; ///< Дополнительные реакторы (только у основного)
+    Http1QueueWatermarks client_marks_;               ///< Водяные знаки очереди к клиенту
+    Http1QueueWatermarks backend_marks_;              ///< Водяные знаки очереди к бэкенду
+
     // 🟡 ЗАТЕМ — SSL-ПОЛЯ
 
     std::unordered_map<int, SSL *> ssl_connections_; ///< Карта: client_fd → SSL*
@@ -110,11 +223,16 @@ private:
      *          - backend_fd: дескриптор сокета бэкенда.
      *          - ssl: указатель на SSL-объект (nullptr, если нет TLS).
      *          - handshake_done: true, если TLS handshake завершён.
+     *          - backend_connected: false, пока connect() к бэкенду в процессе (CONNECTING).
      */
     struct ConnectionInfo {
         int backend_fd;      ///< Дескриптор сокета бэкенда
         SSL *ssl;            ///< Указатель на SSL-объект (nullptr, если нет TLS)
         bool handshake_done; ///< true, если TLS handshake завершён
+        bool backend_connected = false; ///< true — CONNECTED, false — CONNECTING
+        bool backend_eof = false;       ///< Бэкенд закрыл соединение; закрыть после отправки очереди клиенту
+        bool client_eof = false;        ///< Клиент закрыл соединение; закрыть после отправки запроса бэкенду
+        std::chrono::steady_clock::time_point connect_started{}; ///< Начало connect() к бэкенду
     };
 
     // 🟢 Карта активных соединений: client_fd → ConnectionInfo
@@ -124,10 +242,188 @@ private:
     std::unordered_map<int, time_t> timeouts_; ///< Карта таймаутов: client_fd → время последней активности
 
     /**
-     * @brief Создает и подключается к сокету сервера в России.
+     * @brief Слот компактной таблицы «дескриптор → соединение».
+     *
+     * В epoll зарегистрированы оба сокета соединения; номера дескрипторов малы и плотны,
+     * поэтому событие разбирается индексом в векторе, без поиска в хэш-таблице.
+     */
+    struct FdSlot {
+        int client_fd = -1;      ///< Соединение (ключ connections_), -1 — слот свободен
+        bool backend = false;    ///< Дескриптор — сокет бэкенда
+        bool want_write = false; ///< В epoll взведён EPOLLOUT
+        bool read_paused = false; ///< EPOLLIN снят: очередь к другой стороне выше high
+        bool detached = false;   ///< Снят с epoll после EOF, ждёт закрытия соединения
+        bool handshake_write = false; ///< TLS handshake ждёт записи (SSL_ERROR_WANT_WRITE)
+        size_t queued = 0;       ///< Байт в очереди отправки на этот сокет
+    };
+    std::vector<FdSlot> fd_slots_; ///< Индекс — номер дескриптора (клиента или бэкенда)
+    size_t connecting_ = 0;        ///< Соединений в состоянии CONNECTING
+
+    Http1ConnectStats connect_stats_;                 ///< Подключения к бэкенду и время connect()
+    Http1QueueStats queue_stats_;                     ///< Объём очередей отправки и остановки чтения
+    std::vector<int> resume_reads_;                   ///< Клиенты, возобновлённые с данными в буфере SSL
+    std::unique_ptr<char[]> io_buffer_;               ///< Буфер чтения реактора (HTTP1_IO_BUFFER_SIZE)
+    std::chrono::steady_clock::time_point last_stats_{}; ///< Время последнего вывода статистики
+
+    /**
+     * @brief Конструктор дополнительного реактора: копирует настройки основного.
+     *
+     * SSL-контекст общий (счётчик ссылок), сокет, epoll и карты соединений — свои.
+     * @param primary Основной экземпляр.
+     * @param index Номер реактора.
+     */
+    Http1Server(const Http1Server &primary, unsigned index);
+
+    /**
+     * @brief Открывает слушающий сокет реактора (SO_REUSEPORT) и его epoll.
+     * @return true при успехе.
+     */
+    [[nodiscard]] bool open_listener() noexcept;
+
+    /**
+     * @brief Цикл событий реактора до stop().
+     * @return true при штатном завершении.
+     */
+    [[nodiscard]] bool serve() noexcept;
+
+    /**
+     * @brief Закрепляет текущий поток за ядром, соответствующим номеру реактора.
+     */
+    void pin_to_cpu() const noexcept;
+
+    /**
+     * @brief Начинает неблокирующее подключение к серверу в России.
+     *
+     * Не ждёт завершения: при EINPROGRESS сокет возвращается в состоянии CONNECTING,
+     * а завершение обрабатывает handle_backend_connect() по EPOLLOUT.
+     * @param connected Выход: true, если соединение установлено сразу.
      * @return Дескриптор сокета или -1 при ошибке.
      */
-    [[nodiscard]] int connect_to_backend() noexcept;
+    [[nodiscard]] int connect_to_backend(bool &connected) noexcept;
+
+    /**
+     * @brief Завершает подключение к бэкенду (EPOLLOUT/EPOLLERR на подключающемся сокете).
+     *
+     * При успехе переводит соединение в CONNECTED и отправляет накопленные данные клиента,
+     * при ошибке закрывает соединение с клиентом.
+     * @param backend_fd Дескриптор сокета бэкенда.
+     */
+    void handle_backend_connect(int backend_fd) noexcept;
+
+    /**
+     * @brief Обрабатывает события сокета бэкенда: завершение connect(), досылку запроса, ответ клиенту.
+     * @param backend_fd Дескриптор сокета бэкенда.
+     * @param client_fd Дескриптор сокета клиента того же соединения.
+     * @param events_mask Маска событий epoll.
+     */
+    void handle_backend_events(int backend_fd, int client_fd, uint32_t events_mask) noexcept;
+
+    /**
+     * @brief Отправляет данные из очереди pending_sends_ (через SSL, если fd — клиент).
+     *
+     * Взводит EPOLLOUT, если очередь не опустела, и снимает, если опустела.
+     * @param fd Дескриптор назначения.
+     * @return false при фатальной ошибке отправки.
+     */
+    [[nodiscard]] bool flush_pending(int fd) noexcept;
+
+    /**
+     * @brief Читает из сокета (через SSL, если задан), пока не заполнится буфер или источник не опустеет.
+     *
+     * Сокеты в epoll edge-triggered: новое событие придёт только с новыми данными,
+     * поэтому источник читается до EAGAIN (SSL_ERROR_WANT_READ).
+     * @param eof Выход: true — источник закрыт или ошибка чтения.
+     * @return Число прочитанных байт.
+     */
+    [[nodiscard]] size_t read_source(int fd, SSL *ssl, char *buffer, size_t len, bool &eof) noexcept;
+
+    /**
+     * @brief Пишет в сокет (через SSL, если задан), пока не отправлено всё или сокет не вернул EAGAIN.
+     * @return Число отправленных байт или -1 при фатальной ошибке.
+     */
+    [[nodiscard]] ssize_t write_some(int fd, SSL *ssl, const char *data, size_t len) noexcept;
+
+    /**
+     * @brief Отправляет блок сразу или ставит неотправленный остаток в очередь fd.
+     *
+     * Копируется только остаток: блок, ушедший целиком, в очередь не попадает.
+     * @param hold true — только поставить в очередь (получатель ещё не готов).
+     * @return false при фатальной ошибке отправки.
+     */
+    [[nodiscard]] bool send_or_queue(int to_fd, const char *data, size_t len, bool hold) noexcept;
+
+    /**
+     * @brief Приводит события fd в epoll к состоянию слота.
+     *
+     * EPOLLIN — если чтение не остановлено, EPOLLOUT — если есть очередь отправки
+     * или TLS handshake ждёт записи.
+     * Без force epoll_ctl вызывается, только если изменилась потребность в EPOLLOUT.
+     * @param force Обновить и при неизменном EPOLLOUT (остановка или возобновление чтения).
+     */
+    void update_epoll_interest(int fd, bool force = false) noexcept;
+
+    /**
+     * @brief Продлевает таймаут соединения, к которому относится fd (клиент или бэкенд).
+     * @param fd Сокет, по которому прошли данные.
+     */
+    void refresh_timeout(int fd) noexcept;
+
+    /**
+     * @brief Взводит или снимает EPOLLOUT клиента на время TLS handshake.
+     * @param fd Сокет клиента.
+     * @param ssl_error Результат SSL_get_error() последнего шага handshake (0 — handshake завершён).
+     */
+    void await_handshake(int fd, int ssl_error) noexcept;
+
+    /**
+     * @brief Останавливает или возобновляет чтение сокета (backpressure по водяным знакам).
+     * @param fd Источник данных.
+     * @param paused true — снять EPOLLIN, false — вернуть.
+     */
+    void set_read_paused(int fd, bool paused) noexcept;
+
+    /**
+     * @brief Удаляет очередь отправки fd и освобождает его слот (при закрытии соединения).
+     */
+    void drop_queue(int fd) noexcept;
+
+    /**
+     * @brief Возвращает слот дескриптора или nullptr, если он не принадлежит соединению.
+     */
+    [[nodiscard]] FdSlot *fd_slot(int fd) noexcept;
+
+    /**
+     * @brief Записывает слот дескриптора (пустой слот — освободить).
+     */
+    void set_fd_slot(int fd, const FdSlot &slot) noexcept;
+
+    /**
+     * @brief Завершает соединение после закрытия бэкендом: close_notify клиенту и close_connection().
+     * @param client_fd Дескриптор сокета клиента.
+     */
+    void finish_connection(int client_fd) noexcept;
+
+    /**
+     * @brief Закрывает соединение: оба сокета, SSL-объект и все записи в картах.
+     * @param client_fd Дескриптор сокета клиента.
+     */
+    void close_connection(int client_fd) noexcept;
+
+    /**
+     * @brief Закрывает соединения, бэкенд которых не подключился за HTTP1_BACKEND_CONNECT_TIMEOUT.
+     */
+    void expire_backend_connects() noexcept;
+
+    /**
+     * @brief Выводит счётчики и гистограмму времени подключения к бэкенду.
+     */
+    void log_stats() const noexcept;
+
+    /**
+     * @brief Выбирает бэкенд для нового соединения по результатам проверки.
+     * @return Индекс в backends_ или -1, если все недоступны.
+     */
+    [[nodiscard]] int select_backend() const noexcept;
 
     /**
      * @brief Устанавливает неблокирующий режим сокета.
@@ -169,12 +465,14 @@ private:
      * @param from_fd Дескриптор сокета источника (клиент или бэкенд).
      * @param to_fd Дескриптор сокета назначения (бэкенд или клиент).
      * @param ssl Указатель на SSL-объект (nullptr, если нет TLS).
+     * @param hold true — только поставить прочитанное в очередь (бэкенд ещё подключается
+     *             или TLS handshake клиента не завершён).
      * @return true если соединение активно и можно продолжать, false если нужно закрыть соединение.
      * @throws Никаких исключений — используется noexcept.
-     * @warning Не вызывать при отсутствии данных — может привести к busy-waiting.
      * @note Если `from_fd` связан с SSL-объектом — используется SSL_read(). Иначе — recv().
+     * @note Источник читается до EAGAIN блоками по HTTP1_IO_BUFFER_SIZE (edge-triggered epoll).
      */
-    [[nodiscard]] bool forward_data(int from_fd, int to_fd, SSL *ssl) noexcept;
+    [[nodiscard]] bool forward_data(int from_fd, int to_fd, SSL *ssl, bool hold = false) noexcept;
 
     /**
      * @brief Получает SSL-объект по дескриптору сокета.
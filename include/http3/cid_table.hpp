@@ -0,0 +1,100 @@
+// include/http3/cid_table.hpp
+/**
+ * @file cid_table.hpp
+ * @brief Хэш-таблица Connection ID → индекс сессии с открытой адресацией.
+ *
+ * Ключи (до 20 байт) хранятся прямо в слотах таблицы, поиск выполняется
+ * по std::span<const uint8_t>, указывающему в буфер приёма, — без выделения памяти.
+ * Линейное пробирование с однобайтовыми метками (старшие биты хэша) в отдельном
+ * массиве: при промахе просматриваются только метки, ключи сравниваются лишь
+ * при совпадении метки. Удаление — обратным сдвигом, без «надгробий».
+ *
+ * Хэш ключевой (ключ выбирается случайно для каждой таблицы): CID выбирает
+ * удалённая сторона, и без ключа можно подобрать CID с одинаковым хэшем.
+ *
+ * @author Telian Edward <telianedward@icloud.com>
+ * @assisted-by AI-Assistant
+ * @date 2025-11-13
+ * @version 1.0
+ * @license MIT
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "connection_id.hpp"
+
+/**
+ * @brief Таблица CID → uint32_t (индекс сессии) с открытой адресацией.
+ */
+class CidTable {
+public:
+    /// Значение, возвращаемое find() при отсутствии ключа
+    static constexpr uint32_t NOT_FOUND = UINT32_MAX;
+
+    /**
+     * @brief Конструктор.
+     * @param initial_capacity Начальное число записей, которое поместится без перестроения.
+     */
+    explicit CidTable(size_t initial_capacity = 1024);
+
+    /**
+     * @brief Ищет CID.
+     * @param cid Байты CID (не длиннее MAX_CID_LENGTH).
+     * @return Значение или NOT_FOUND.
+     */
+    [[nodiscard]] uint32_t find(std::span<const uint8_t> cid) const noexcept;
+
+    /**
+     * @brief Добавляет CID, если его ещё нет.
+     * @param cid Байты CID (не длиннее MAX_CID_LENGTH).
+     * @param value Значение (не NOT_FOUND).
+     * @return true, если запись добавлена; false, если CID уже есть или некорректен.
+     */
+    bool insert(std::span<const uint8_t> cid, uint32_t value);
+
+    /**
+     * @brief Удаляет CID.
+     * @param cid Байты CID.
+     * @return true, если запись была.
+     */
+    bool erase(std::span<const uint8_t> cid) noexcept;
+
+    /**
+     * @brief Возвращает число записей.
+     */
+    [[nodiscard]] size_t size() const noexcept { return size_; }
+
+    /**
+     * @brief Возвращает число слотов.
+     */
+    [[nodiscard]] size_t capacity() const noexcept { return tags_.size(); }
+
+    /**
+     * @brief Оценка памяти на одну запись с учётом метки и заполнения 3/4.
+     */
+    [[nodiscard]] static constexpr size_t bytes_per_entry() noexcept { return (sizeof(Slot) + 1) * 4 / 3; }
+
+private:
+    /// Слот таблицы: ключ хранится по значению
+    struct Slot {
+        uint8_t key[MAX_CID_LENGTH];
+        uint8_t len;
+        uint32_t value;
+    };
+
+    static constexpr uint8_t EMPTY = 0; ///< Метка пустого слота (у занятых старший бит установлен)
+
+    std::vector<uint8_t> tags_; ///< Метки слотов (EMPTY или 0x80 | 7 бит хэша)
+    std::vector<Slot> slots_;   ///< Ключи и значения
+    size_t mask_ = 0;           ///< capacity - 1 (ёмкость — степень двойки)
+    size_t size_ = 0;           ///< Число записей
+    uint64_t seed_[4]{};        ///< Ключ хэш-функции
+
+    [[nodiscard]] uint64_t hash(std::span<const uint8_t> cid) const noexcept;
+    [[nodiscard]] static uint8_t tag_of(uint64_t h) noexcept { return static_cast<uint8_t>(0x80 | (h >> 57)); }
+    [[nodiscard]] size_t find_slot(std::span<const uint8_t> cid, uint64_t h) const noexcept;
+    void rehash(size_t new_capacity);
+    void place(std::span<const uint8_t> cid, uint64_t h, uint32_t value) noexcept;
+};
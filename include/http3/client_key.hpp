@@ -21,7 +21,7 @@
 /**
  * @brief Структура для хранения ключа клиента.
  *
- * Используется как ключ в session_map и Deduplicator.
+ * Хранится в записи сессии QuicSession.
  */
 struct ClientKey {
     uint32_t addr;          ///< IPv4-адрес клиента
@@ -0,0 +1,76 @@
+// include/http3/connection_id.hpp
+/**
+ * @file connection_id.hpp
+ * @brief Connection ID QUIC фиксированного размера без выделения памяти.
+ *
+ * CID хранится внутри структуры (до 20 байт, RFC 9000 §17.2), поэтому его можно
+ * собрать прямо из заголовка пакета на стеке и использовать как ключ поиска
+ * в таблицах маршрутизации без обращения к куче.
+ *
+ * @author Telian Edward <telianedward@icloud.com>
+ * @assisted-by AI-Assistant
+ * @date 2025-11-12
+ * @version 1.0
+ * @license MIT
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+/// Максимальная длина Connection ID (QUIC v1)
+constexpr size_t MAX_CID_LENGTH = 20;
+
+/**
+ * @brief Connection ID, хранящийся по значению.
+ */
+struct ConnectionId {
+    uint8_t len = 0;                   ///< Длина CID в байтах
+    uint8_t bytes[MAX_CID_LENGTH]{};   ///< Байты CID (хвост после len — нули)
+
+    ConnectionId() = default;
+
+    /**
+     * @brief Создаёт CID из байтов заголовка пакета.
+     * @param data Начало CID.
+     * @param length Длина CID (обрезается до MAX_CID_LENGTH).
+     */
+    ConnectionId(const uint8_t *data, size_t length) noexcept
+        : len(static_cast<uint8_t>(std::min(length, MAX_CID_LENGTH))) {
+        std::memcpy(bytes, data, len);
+    }
+
+    /**
+     * @brief Возвращает указатель на байты CID.
+     */
+    [[nodiscard]] const uint8_t *data() const noexcept { return bytes; }
+
+    /**
+     * @brief Возвращает длину CID.
+     */
+    [[nodiscard]] size_t size() const noexcept { return len; }
+
+    /**
+     * @brief Проверяет, пуст ли CID.
+     */
+    [[nodiscard]] bool empty() const noexcept { return len == 0; }
+
+    bool operator==(const ConnectionId &other) const noexcept {
+        return len == other.len && std::memcmp(bytes, other.bytes, len) == 0;
+    }
+};
+
+/**
+ * @brief Хэш-функция для ConnectionId (FNV-1a по байтам CID).
+ */
+struct ConnectionIdHash {
+    size_t operator()(const ConnectionId &cid) const noexcept {
+        uint64_t hash = 14695981039346656037ULL;
+        for (size_t i = 0; i < cid.len; ++i) {
+            hash ^= cid.bytes[i];
+            hash *= 1099511628211ULL;
+        }
+        return static_cast<size_t>(hash);
+    }
+};
@@ -0,0 +1,83 @@
+// include/http3/maglev_table.hpp
+/**
+ * @file maglev_table.hpp
+ * @brief Таблица согласованного хэширования Maglev для выбора бэкенда.
+ *
+ * Каждый бэкенд задаёт перестановку слотов таблицы (offset и skip из хэшей его имени);
+ * слоты заполняются по очереди из перестановок, пока таблица не заполнится
+ * (Eisenbud et al., «Maglev», NSDI 2016). Бэкенды получают почти равные доли слотов,
+ * а при добавлении или удалении одного бэкенда меняется владелец лишь малой доли
+ * слотов сверх неизбежной.
+ *
+ * Поиск — одно обращение к массиву: индекс слота получается из хэша умножением
+ * со сдвигом, без деления.
+ *
+ * @author Telian Edward <telianedward@icloud.com>
+ * @assisted-by AI-Assistant
+ * @date 2025-11-19
+ * @version 1.0
+ * @license MIT
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Таблица Maglev: хэш ключа → индекс бэкенда.
+ */
+class MaglevTable {
+public:
+    static constexpr uint32_t DEFAULT_SIZE = 65537;   ///< Размер таблицы по умолчанию (простое число)
+    static constexpr uint16_t NO_BACKEND = UINT16_MAX; ///< Результат lookup() для пустой таблицы
+
+    /**
+     * @brief Конструктор.
+     * @param size Число слотов (округляется вверх до простого; должно заметно превышать число бэкендов).
+     */
+    explicit MaglevTable(uint32_t size = DEFAULT_SIZE);
+
+    /**
+     * @brief Перестраивает таблицу.
+     *
+     * Результат зависит только от имён и их порядка, поэтому одинаков во всех потоках и процессах.
+     * @param names Устойчивые имена бэкендов (например, "ip:port"); индекс в векторе — результат lookup().
+     * @param enabled Какие бэкенды участвуют (пустой вектор — все).
+     * @return false, если участвующих бэкендов нет (таблица очищается).
+     */
+    bool build(const std::vector<std::string> &names, const std::vector<bool> &enabled = {});
+
+    /**
+     * @brief Возвращает бэкенд для хэша ключа.
+     */
+    [[nodiscard]] uint16_t lookup(uint64_t hash) const noexcept
+    {
+        if (table_.empty())
+        {
+            return NO_BACKEND;
+        }
+        // Умножение со сдвигом отображает 32 бита хэша на [0, size) без деления
+        return table_[(static_cast<uint64_t>(static_cast<uint32_t>(hash ^ (hash >> 32))) * size_) >> 32];
+    }
+
+    /**
+     * @brief Хэш ключа (CID, адрес клиента) с фиксированными константами — одинаков во всех потоках.
+     */
+    [[nodiscard]] static uint64_t hash(std::span<const uint8_t> key) noexcept;
+
+    /**
+     * @brief Возвращает число слотов.
+     */
+    [[nodiscard]] uint32_t size() const noexcept { return size_; }
+
+    /**
+     * @brief Возвращает содержимое таблицы (для оценки распределения и перестроений).
+     */
+    [[nodiscard]] const std::vector<uint16_t> &slots() const noexcept { return table_; }
+
+private:
+    uint32_t size_;                ///< Число слотов (простое)
+    std::vector<uint16_t> table_;  ///< Слот → индекс бэкенда (пусто — бэкендов нет)
+};
@@ -0,0 +1,76 @@
+// include/http3/prefix_rate_limiter.hpp
+/**
+ * @file prefix_rate_limiter.hpp
+ * @brief Ограничение частоты новых соединений по префиксу адреса источника.
+ *
+ * Каждому префиксу (/24 для IPv4, /48 для IPv6) соответствует token bucket.
+ * Корзины лежат в массиве фиксированного размера и выбираются ключевым хэшем префикса
+ * в двух независимых строках (как в count-min sketch): соединение допускается, если
+ * жетон есть хотя бы в одной из двух корзин префикса, а списывается из обеих.
+ * Так память постоянна при любом числе источников, а честный префикс урезается,
+ * только если обе его корзины делит с атакующими.
+ *
+ * @author Telian Edward <telianedward@icloud.com>
+ * @assisted-by AI-Assistant
+ * @date 2025-11-17
+ * @version 1.0
+ * @license MIT
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <netinet/in.h>
+
+/**
+ * @brief Хэшированный массив token bucket'ов по префиксам адресов.
+ */
+class PrefixRateLimiter {
+public:
+    static constexpr size_t ROWS = 2; ///< Строк (независимых хэшей)
+
+    /**
+     * @brief Конструктор.
+     * @param rate Новых соединений в секунду на префикс.
+     * @param burst Ёмкость корзины (допустимый всплеск).
+     * @param buckets Корзин в строке (округляется вверх до степени двойки).
+     */
+    PrefixRateLimiter(uint32_t rate, uint32_t burst, size_t buckets);
+
+    /**
+     * @brief Решает, допустить ли новое соединение с IPv4-адреса (префикс /24).
+     * @param addr Адрес в сетевом порядке байт.
+     * @param now_ms Монотонное время в миллисекундах.
+     * @return true, если жетон был и списан.
+     */
+    [[nodiscard]] bool admit_ipv4(uint32_t addr, uint64_t now_ms) noexcept;
+
+    /**
+     * @brief Решает, допустить ли новое соединение с IPv6-адреса (префикс /48).
+     * @param addr Адрес.
+     * @param now_ms Монотонное время в миллисекундах.
+     * @return true, если жетон был и списан.
+     */
+    [[nodiscard]] bool admit_ipv6(const in6_addr &addr, uint64_t now_ms) noexcept;
+
+    /**
+     * @brief Возвращает память, занятую корзинами (не зависит от числа источников).
+     */
+    [[nodiscard]] size_t memory_bytes() const noexcept { return buckets_.size() * sizeof(Bucket); }
+
+private:
+    /// Корзина: жетоны в тысячных долях и время последнего пополнения
+    struct Bucket {
+        uint32_t tokens_milli;
+        uint32_t stamp_ms;    ///< Младшие 32 бита времени (разность считается по модулю 2^32)
+    };
+
+    std::vector<Bucket> buckets_; ///< ROWS строк подряд
+    size_t mask_;                 ///< Корзин в строке - 1
+    uint32_t rate_milli_;         ///< Пополнение: тысячных жетона в миллисекунду (= жетонов в секунду)
+    uint32_t burst_milli_;        ///< Ёмкость в тысячных жетона
+    uint64_t seed_[ROWS]{};       ///< Ключи хэшей строк
+
+    [[nodiscard]] bool admit(uint64_t prefix, uint64_t now_ms) noexcept;
+    void refill(Bucket &bucket, uint32_t now) const noexcept;
+};
@@ -0,0 +1,398 @@
+// include/http3/quic_header.hpp
+/**
+ * @file quic_header.hpp
+ * @brief Разбор заголовков QUIC-пакетов без выделения памяти.
+ *
+ * QuicHeaderView — «представление» над std::span<const uint8_t> принятого датаграммы:
+ * поля заголовка не копируются, а возвращаются как подотрезки исходного буфера.
+ * Длины токена и поля Length декодируются как varint RFC 9000 §16; все примитивы —
+ * constexpr и noexcept, поэтому проверяются на этапе компиляции.
+ *
+ * Номер пакета и его длина (младшие биты первого байта) защищены Header Protection
+ * (RFC 9001 §5.4): без снятия защиты доступны только как «сырые» байты с провода.
+ *
+ * @author Telian Edward <telianedward@icloud.com>
+ * @assisted-by AI-Assistant
+ * @date 2025-11-15
+ * @version 1.0
+ * @license MIT
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include "connection_id.hpp"
+
+/// Версия QUIC v1 (RFC 9000)
+constexpr uint32_t QUIC_VERSION_1 = 0x00000001;
+/// Версия QUIC v2 (RFC 9369): другие коды типов Long Header
+constexpr uint32_t QUIC_VERSION_2 = 0x6b3343cf;
+/// Максимальное значение varint (2^62 - 1)
+constexpr uint64_t QUIC_VARINT_MAX = (uint64_t{1} << 62) - 1;
+
+/**
+ * @brief Возвращает длину varint по его первому байту (1, 2, 4 или 8).
+ */
+[[nodiscard]] constexpr size_t quic_varint_length(uint8_t first) noexcept
+{
+    return size_t{1} << (first >> 6);
+}
+
+/**
+ * @brief Возвращает минимальную длину кодирования значения varint (0 — значение не кодируется).
+ */
+[[nodiscard]] constexpr size_t quic_varint_size(uint64_t value) noexcept
+{
+    if (value < (uint64_t{1} << 6)) return 1;
+    if (value < (uint64_t{1} << 14)) return 2;
+    if (value < (uint64_t{1} << 30)) return 4;
+    if (value <= QUIC_VARINT_MAX) return 8;
+    return 0;
+}
+
+/**
+ * @brief Декодирует varint RFC 9000 §16.
+ * @param in Буфер.
+ * @param pos Смещение varint; при успехе сдвигается за него.
+ * @param value Декодированное значение.
+ * @return false, если varint не помещается в буфер.
+ */
+[[nodiscard]] constexpr bool quic_varint_decode(std::span<const uint8_t> in, size_t &pos, uint64_t &value) noexcept
+{
+    if (pos >= in.size())
+    {
+        return false;
+    }
+    const size_t len = quic_varint_length(in[pos]);
+    if (in.size() - pos < len)
+    {
+        return false;
+    }
+    uint64_t v = in[pos] & 0x3F;
+    for (size_t i = 1; i < len; ++i)
+    {
+        v = (v << 8) | in[pos + i];
+    }
+    value = v;
+    pos += len;
+    return true;
+}
+
+/**
+ * @brief Тип QUIC-пакета (не зависит от версии: коды v2 приводятся к этим значениям).
+ */
+enum class QuicPacketType : uint8_t {
+    Initial,
+    ZeroRtt,
+    Handshake,
+    Retry,
+    VersionNegotiation,
+    Short,      ///< 1-RTT (Short Header)
+    Unknown     ///< Long Header неизвестной версии: разобраны только инварианты RFC 8999
+};
+
+/**
+ * @brief Представление заголовка одного QUIC-пакета поверх буфера датаграммы.
+ *
+ * Для Long Header пакетов с полем Length (Initial, 0-RTT, Handshake) packet_size()
+ * указывает на конец пакета — с него начинается следующий склеенный пакет датаграммы.
+ * Для остальных пакет занимает датаграмму до конца.
+ */
+class QuicHeaderView {
+public:
+    static constexpr size_t RETRY_INTEGRITY_TAG_SIZE = 16; ///< Retry Integrity Tag (RFC 9001 §5.8)
+
+    constexpr QuicHeaderView() noexcept = default;
+
+    /**
+     * @brief Разбирает заголовок пакета в начале буфера.
+     * @param packet Датаграмма (или её хвост для склеенных пакетов).
+     * @param short_dcid_len Длина DCID Short Header пакета (в самом пакете не передаётся).
+     * @return false, если заголовок обрезан или длины невозможны.
+     *
+     * CID длиннее 20 байт отвергаются только для QUIC v1 и v2; у других версий они допустимы
+     * (до 255 байт), чтобы на такой пакет можно было ответить Version Negotiation (RFC 9000 §17.2).
+     */
+    [[nodiscard]] constexpr bool parse(std::span<const uint8_t> packet, size_t short_dcid_len = 0) noexcept
+    {
+        *this = QuicHeaderView{};
+        if (packet.empty())
+        {
+            return false;
+        }
+        data_ = packet.data();
+        first_ = packet[0];
+        if ((first_ & 0x80) == 0)
+        {
+            return parse_short(packet, short_dcid_len);
+        }
+        return parse_long(packet);
+    }
+
+    /// Long Header (бит формы установлен)
+    [[nodiscard]] constexpr bool is_long() const noexcept { return (first_ & 0x80) != 0; }
+    /// Фиксированный бит (RFC 9000 §17.2; может быть сброшен по RFC 9287)
+    [[nodiscard]] constexpr bool fixed_bit() const noexcept { return (first_ & 0x40) != 0; }
+    /// Первый байт пакета как на проводе
+    [[nodiscard]] constexpr uint8_t first_byte() const noexcept { return first_; }
+    /// Тип пакета
+    [[nodiscard]] constexpr QuicPacketType type() const noexcept { return type_; }
+    /// Версия (0 для Short Header и Version Negotiation)
+    [[nodiscard]] constexpr uint32_t version() const noexcept { return version_; }
+    /// Destination Connection ID
+    [[nodiscard]] constexpr std::span<const uint8_t> dcid() const noexcept { return {data_ + dcid_offset_, dcid_len_}; }
+    /// Source Connection ID (пуст у Short Header)
+    [[nodiscard]] constexpr std::span<const uint8_t> scid() const noexcept { return {data_ + scid_offset_, scid_len_}; }
+
+    /**
+     * @brief Токен: у Initial — поле Token, у Retry — Retry Token (без Integrity Tag).
+     */
+    [[nodiscard]] constexpr std::span<const uint8_t> token() const noexcept { return {data_ + token_offset_, token_len_}; }
+
+    /**
+     * @brief Значение поля Length: номер пакета и защищённая полезная нагрузка.
+     */
+    [[nodiscard]] constexpr uint64_t length() const noexcept { return length_; }
+
+    /**
+     * @brief Смещение поля номера пакета от начала пакета (0 у Retry и Version Negotiation).
+     */
+    [[nodiscard]] constexpr size_t packet_number_offset() const noexcept { return pn_offset_; }
+
+    /**
+     * @brief Размер пакета внутри датаграммы (заголовок + Length либо до конца буфера).
+     */
+    [[nodiscard]] constexpr size_t packet_size() const noexcept { return size_; }
+
+    /**
+     * @brief Пакет целиком: packet_size() байт от первого байта заголовка.
+     */
+    [[nodiscard]] constexpr std::span<const uint8_t> packet() const noexcept { return {data_, size_}; }
+
+    /**
+     * @brief Номер пакета как на проводе: длина из младших битов первого байта, старший байт первым.
+     *
+     * Оба поля защищены Header Protection, поэтому для зашифрованных пакетов это
+     * не настоящий номер, а его защищённое представление.
+     */
+    [[nodiscard]] constexpr uint64_t wire_packet_number() const noexcept
+    {
+        if (pn_offset_ == 0)
+        {
+            return 0;
+        }
+        const size_t len = static_cast<size_t>(first_ & 0x03) + 1;
+        uint64_t pn = 0;
+        for (size_t i = 0; i < len && pn_offset_ + i < size_; ++i)
+        {
+            pn = (pn << 8) | data_[pn_offset_ + i];
+        }
+        return pn;
+    }
+
+    /**
+     * @brief Поддерживаемые версии из пакета Version Negotiation (по 4 байта, старший первым).
+     */
+    [[nodiscard]] constexpr std::span<const uint8_t> supported_versions() const noexcept
+    {
+        return type_ == QuicPacketType::VersionNegotiation ? std::span<const uint8_t>(data_ + token_offset_, size_ - token_offset_)
+                                                           : std::span<const uint8_t>{};
+    }
+
+private:
+    const uint8_t *data_ = nullptr;
+    size_t size_ = 0;
+    size_t token_offset_ = 0;
+    size_t token_len_ = 0;
+    size_t pn_offset_ = 0;
+    uint64_t length_ = 0;
+    uint32_t version_ = 0;
+    uint8_t first_ = 0;
+    uint8_t dcid_offset_ = 0;
+    uint8_t dcid_len_ = 0;
+    uint16_t scid_offset_ = 0; ///< До 1 + 4 + 1 + 255 + 1 у версий с длинными CID
+    uint8_t scid_len_ = 0;
+    QuicPacketType type_ = QuicPacketType::Unknown;
+
+    /// Тип Long Header по битам 4-5 с учётом версии
+    [[nodiscard]] static constexpr QuicPacketType long_type(uint32_t version, uint8_t first) noexcept
+    {
+        const uint8_t bits = (first >> 4) & 0x03;
+        if (version == QUIC_VERSION_1)
+        {
+            return static_cast<QuicPacketType>(bits);
+        }
+        if (version == QUIC_VERSION_2)
+        {
+            // v2: Retry = 0, Initial = 1, 0-RTT = 2, Handshake = 3
+            constexpr QuicPacketType v2[4] = {QuicPacketType::Retry, QuicPacketType::Initial,
+                                              QuicPacketType::ZeroRtt, QuicPacketType::Handshake};
+            return v2[bits];
+        }
+        return QuicPacketType::Unknown;
+    }
+
+    constexpr bool parse_short(std::span<const uint8_t> packet, size_t dcid_len) noexcept
+    {
+        if (dcid_len > MAX_CID_LENGTH || packet.size() < 1 + dcid_len + 1)
+        {
+            return false;
+        }
+        type_ = QuicPacketType::Short;
+        dcid_offset_ = 1;
+        dcid_len_ = static_cast<uint8_t>(dcid_len);
+        scid_offset_ = static_cast<uint16_t>(1 + dcid_len);
+        pn_offset_ = 1 + dcid_len;
+        size_ = packet.size();
+        return true;
+    }
+
+    constexpr bool parse_long(std::span<const uint8_t> packet) noexcept
+    {
+        // Инварианты (RFC 8999): первый байт, версия, DCID Len + DCID, SCID Len + SCID
+        if (packet.size() < 7)
+        {
+            return false;
+        }
+        version_ = (static_cast<uint32_t>(packet[1]) << 24) | (static_cast<uint32_t>(packet[2]) << 16) |
+                   (static_cast<uint32_t>(packet[3]) << 8) | packet[4];
+        size_t pos = 5;
+        // Предел 20 байт — правило v1/v2 (RFC 9000 §17.2); инварианты допускают до 255
+        const size_t max_cid_length = version_ == QUIC_VERSION_1 || version_ == QUIC_VERSION_2 ? MAX_CID_LENGTH : 255;
+        const size_t dcid_len = packet[pos++];
+        if (dcid_len > max_cid_length || packet.size() - pos < dcid_len + 1)
+        {
+            return false;
+        }
+        dcid_offset_ = static_cast<uint8_t>(pos);
+        dcid_len_ = static_cast<uint8_t>(dcid_len);
+        pos += dcid_len;
+        const size_t scid_len = packet[pos++];
+        if (scid_len > max_cid_length || packet.size() - pos < scid_len)
+        {
+            return false;
+        }
+        scid_offset_ = static_cast<uint16_t>(pos);
+        scid_len_ = static_cast<uint8_t>(scid_len);
+        pos += scid_len;
+        size_ = packet.size();
+
+        if (version_ == 0)
+        {
+            // Version Negotiation: далее список версий по 4 байта
+            type_ = QuicPacketType::VersionNegotiation;
+            token_offset_ = pos;
+            return (packet.size() - pos) % 4 == 0;
+        }
+
+        type_ = long_type(version_, first_);
+        switch (type_)
+        {
+        case QuicPacketType::Retry:
+            if (packet.size() - pos < RETRY_INTEGRITY_TAG_SIZE)
+            {
+                return false;
+            }
+            token_offset_ = pos;
+            token_len_ = packet.size() - pos - RETRY_INTEGRITY_TAG_SIZE;
+            return true;
+        case QuicPacketType::Initial:
+        {
+            uint64_t token_len = 0;
+            if (!quic_varint_decode(packet, pos, token_len) || token_len > packet.size() - pos)
+            {
+                return false;
+            }
+            token_offset_ = pos;
+            token_len_ = static_cast<size_t>(token_len);
+            pos += token_len_;
+            [[fallthrough]];
+        }
+        case QuicPacketType::ZeroRtt:
+        case QuicPacketType::Handshake:
+        {
+            uint64_t length = 0;
+            // Length покрывает номер пакета (минимум 1 байт) и полезную нагрузку
+            if (!quic_varint_decode(packet, pos, length) || length == 0 || length > packet.size() - pos)
+            {
+                return false;
+            }
+            length_ = length;
+            pn_offset_ = pos;
+            size_ = pos + static_cast<size_t>(length);
+            return true;
+        }
+        default:
+            // Неизвестная версия: дальше инвариантов формат не определён
+            return true;
+        }
+    }
+};
+
+/**
+ * @brief Перебор склеенных (coalesced) QUIC-пакетов одной датаграммы (RFC 9000 §12.2).
+ *
+ * Границы берутся из поля Length Initial, 0-RTT и Handshake; Short Header, Retry,
+ * Version Negotiation и пакеты неизвестных версий занимают датаграмму до конца.
+ * Данные не копируются: каждый QuicHeaderView указывает в исходный буфер.
+ * Перебор останавливается на первом неразборном хвосте — по RFC он отбрасывается,
+ * а пакеты до него остаются действительными (так же кончается и нулевое дополнение).
+ */
+class QuicPacketIterator {
+public:
+    /**
+     * @brief Конструктор.
+     * @param datagram Датаграмма.
+     * @param short_dcid_len Длина DCID Short Header пакета.
+     */
+    constexpr explicit QuicPacketIterator(std::span<const uint8_t> datagram, size_t short_dcid_len = 0) noexcept
+        : datagram_(datagram), short_dcid_len_(short_dcid_len)
+    {
+    }
+
+    /**
+     * @brief Разбирает следующий пакет.
+     * @param header Выход: заголовок пакета.
+     * @return false, если пакеты кончились или остаток не разбирается.
+     */
+    [[nodiscard]] constexpr bool next(QuicHeaderView &header) noexcept
+    {
+        if (offset_ >= datagram_.size())
+        {
+            return false;
+        }
+        const std::span<const uint8_t> rest = datagram_.subspan(offset_);
+        // Short Header без фиксированного бита после другого пакета — дополнение, а не пакет
+        if (!header.parse(rest, short_dcid_len_) || (offset_ != 0 && !header.is_long() && !header.fixed_bit()))
+        {
+            malformed_ = offset_ == 0 || rest[0] != 0;
+            offset_ = datagram_.size();
+            return false;
+        }
+        offset_ += header.packet_size();
+        ++count_;
+        return true;
+    }
+
+    /**
+     * @brief Смещение следующего пакета от начала датаграммы.
+     */
+    [[nodiscard]] constexpr size_t offset() const noexcept { return offset_; }
+
+    /**
+     * @brief Число разобранных пакетов.
+     */
+    [[nodiscard]] constexpr size_t count() const noexcept { return count_; }
+
+    /**
+     * @brief Перебор остановлен на неразборном хвосте (не нулевом дополнении).
+     */
+    [[nodiscard]] constexpr bool malformed() const noexcept { return malformed_; }
+
+private:
+    std::span<const uint8_t> datagram_;
+    size_t short_dcid_len_ = 0;
+    size_t offset_ = 0;
+    size_t count_ = 0;
+    bool malformed_ = false;
+};
@@ -0,0 +1,158 @@
+// include/http3/quic_initial.hpp
+/**
+ * @file quic_initial.hpp
+ * @brief Снятие защиты Initial-пакетов QUIC и извлечение SNI/ALPN из ClientHello.
+ *
+ * Ключи Initial выводятся из DCID первого Initial клиента и общеизвестной соли
+ * (RFC 9001 §5.2, RFC 9369 §3.3.1), поэтому прокси читает ClientHello, не завершая
+ * ни QUIC, ни TLS: снимает Header Protection (AES-128-ECB по образцу шифротекста),
+ * расшифровывает AES-128-GCM и собирает CRYPTO-фреймы в фиксированный буфер.
+ *
+ * Пакет в буфере приёма не изменяется: расшифровка идёт во внутренний буфер,
+ * а наружу пересылается исходная датаграмма.
+ *
+ * @author Telian Edward <telianedward@icloud.com>
+ * @assisted-by AI-Assistant
+ * @date 2025-11-18
+ * @version 1.0
+ * @license MIT
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+#include "quic_header.hpp"
+
+typedef struct evp_cipher_ctx_st EVP_CIPHER_CTX;
+typedef struct evp_pkey_ctx_st EVP_PKEY_CTX;
+
+/// Максимальный размер ClientHello, который собирается из CRYPTO-фреймов
+constexpr size_t MAX_CLIENT_HELLO_SIZE = 4096;
+
+/**
+ * @brief Ключи защиты Initial-пакетов клиента (AES-128-GCM).
+ */
+struct QuicInitialKeys {
+    uint8_t key[16];  ///< Ключ AEAD
+    uint8_t iv[12];   ///< IV AEAD (nonce = iv XOR номер пакета)
+    uint8_t hp[16];   ///< Ключ Header Protection
+};
+
+/**
+ * @brief Поля ClientHello, доступные для маршрутизации.
+ *
+ * Ссылаются на буфер сборки CRYPTO и действительны только во время вызова обработчика.
+ */
+struct QuicClientHelloInfo {
+    std::string_view server_name;   ///< SNI (host_name); пусто, если расширения нет
+    std::span<const uint8_t> alpn;  ///< ALPN в формате расширения: (длина 1 байт | протокол)*
+
+    /**
+     * @brief Проверяет, предлагает ли клиент протокол ALPN.
+     * @param protocol Имя протокола, например "h3".
+     */
+    [[nodiscard]] bool offers_alpn(std::string_view protocol) const noexcept;
+};
+
+/**
+ * @brief Разбирает сообщение TLS 1.3 ClientHello (с заголовком Handshake).
+ * @param message Сообщение целиком: тип (1), длина (3), тело.
+ * @param info Выход: SNI и ALPN.
+ * @return false, если сообщение не ClientHello или повреждено.
+ */
+[[nodiscard]] bool parse_client_hello(std::span<const uint8_t> message, QuicClientHelloInfo &info) noexcept;
+
+/**
+ * @brief Сборка начала CRYPTO-потока Initial из фреймов, пришедших в любом порядке.
+ *
+ * Принятые диапазоны хранятся отсортированными и слитыми; памяти не выделяет.
+ */
+class QuicCryptoAssembler {
+public:
+    static constexpr size_t MAX_RANGES = 8; ///< Несмежных диапазонов одновременно
+
+    /**
+     * @brief Сбрасывает собранные данные.
+     */
+    void reset() noexcept { range_count_ = 0; }
+
+    /**
+     * @brief Добавляет данные CRYPTO-фрейма.
+     * @param offset Смещение в CRYPTO-потоке.
+     * @param data Данные фрейма.
+     * @return false, если данные выходят за MAX_CLIENT_HELLO_SIZE или диапазонов слишком много.
+     */
+    [[nodiscard]] bool add(uint64_t offset, std::span<const uint8_t> data) noexcept;
+
+    /**
+     * @brief Возвращает ClientHello, если он собран целиком (иначе пустой отрезок).
+     */
+    [[nodiscard]] std::span<const uint8_t> client_hello() const noexcept;
+
+    /**
+     * @brief Проверяет, что начало потока не может быть ClientHello (другой тип или превышен размер).
+     */
+    [[nodiscard]] bool malformed() const noexcept;
+
+private:
+    struct Range {
+        uint16_t begin;
+        uint16_t end;
+    };
+
+    uint8_t data_[MAX_CLIENT_HELLO_SIZE];
+    Range ranges_[MAX_RANGES];
+    size_t range_count_ = 0;
+
+    /// Длина непрерывного начала потока
+    [[nodiscard]] size_t prefix() const noexcept { return range_count_ != 0 && ranges_[0].begin == 0 ? ranges_[0].end : 0; }
+};
+
+/**
+ * @brief Вывод ключей и снятие защиты Initial-пакетов клиента (один экземпляр на поток).
+ *
+ * Контексты OpenSSL создаются один раз; расшифровка идёт во внутренний буфер.
+ */
+class QuicInitialDecryptor {
+public:
+    QuicInitialDecryptor();
+    ~QuicInitialDecryptor();
+
+    QuicInitialDecryptor(const QuicInitialDecryptor &) = delete;
+    QuicInitialDecryptor &operator=(const QuicInitialDecryptor &) = delete;
+
+    /**
+     * @brief Проверяет, удалось ли создать контексты OpenSSL.
+     */
+    [[nodiscard]] bool ready() const noexcept { return aead_ctx_ != nullptr && hp_ctx_ != nullptr && hkdf_ctx_ != nullptr; }
+
+    /**
+     * @brief Выводит ключи Initial клиента.
+     * @param version Версия QUIC (v1 или v2).
+     * @param dcid DCID первого Initial клиента.
+     * @param keys Выход.
+     * @return false для неизвестной версии или при ошибке OpenSSL.
+     */
+    [[nodiscard]] bool derive_keys(uint32_t version, std::span<const uint8_t> dcid, QuicInitialKeys &keys) noexcept;
+
+    /**
+     * @brief Снимает защиту Initial-пакета и передаёт его CRYPTO-фреймы в сборку.
+     * @param initial Разобранный Initial (расшифровывается только этот пакет датаграммы).
+     * @param keys Ключи клиента.
+     * @param crypto Сборка CRYPTO-потока.
+     * @return false, если пакет не расшифровался, фреймы повреждены или ClientHello не помещается.
+     */
+    [[nodiscard]] bool open(const QuicHeaderView &initial, const QuicInitialKeys &keys, QuicCryptoAssembler &crypto) noexcept;
+
+private:
+    EVP_CIPHER_CTX *aead_ctx_ = nullptr; ///< AES-128-GCM
+    EVP_CIPHER_CTX *hp_ctx_ = nullptr;   ///< AES-128-ECB для маски Header Protection
+    EVP_PKEY_CTX *hkdf_ctx_ = nullptr;   ///< HKDF-SHA256
+    std::vector<uint8_t> plaintext_;     ///< Заголовок без защиты и расшифрованная полезная нагрузка
+
+    /// HKDF-Expand-Label (RFC 8446 §7.1) с пустым контекстом
+    [[nodiscard]] bool expand_label(std::span<const uint8_t> secret, std::string_view label,
+                                    uint8_t *out, size_t out_len) noexcept;
+};
@@ -0,0 +1,119 @@
+// include/http3/quic_lb.hpp
+/**
+ * @file quic_lb.hpp
+ * @brief Маршрутизируемые Connection ID в стиле QUIC-LB (draft-ietf-quic-load-balancers).
+ *
+ * Сервер кодирует в выбираемые им CID свой server ID, и балансировщик находит
+ * бэкенд по самому CID — без таблиц соединений, после перезапуска и при масштабировании.
+ *
+ * Формат CID:
+ *   первый байт: config ID (3 старших бита) | длина CID без первого байта или случайные биты (5)
+ *   далее: server ID | nonce — открыто (plaintext) или одним блоком AES-128-ECB,
+ *   если server ID и nonce вместе занимают ровно 16 байт (single-pass).
+ * Config ID 7 зарезервирован за немаршрутизируемыми CID.
+ *
+ * Библиотека не зависит от прокси (только OpenSSL::Crypto): бэкенд линкует её,
+ * чтобы выдавать CID, которые прокси умеет разбирать.
+ *
+ * @author Telian Edward <telianedward@icloud.com>
+ * @assisted-by AI-Assistant
+ * @date 2025-11-20
+ * @version 1.0
+ * @license MIT
+ */
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+typedef struct evp_cipher_ctx_st EVP_CIPHER_CTX;
+
+/// Config ID немаршрутизируемых CID
+constexpr uint8_t QUIC_LB_UNROUTABLE_CONFIG = 7;
+
+/**
+ * @brief Настройки кодирования CID (должны совпадать у прокси и бэкендов).
+ */
+struct QuicLbConfig {
+    uint8_t config_id = 0;         ///< Config ID (0..6)
+    uint8_t server_id_length = 2;  ///< Длина server ID (1..15 байт)
+    uint8_t nonce_length = 6;      ///< Длина nonce (4..18 байт; с server ID не больше 19)
+    bool encode_length = true;     ///< Записывать длину CID в младшие 5 бит первого байта
+    bool encrypted = false;        ///< Single-pass AES-128-ECB (server ID + nonce = 16 байт)
+    std::array<uint8_t, 16> key{}; ///< Ключ AES-128 (для encrypted)
+};
+
+/**
+ * @brief Кодирование и разбор CID QUIC-LB для одной конфигурации.
+ *
+ * Контекст AES создаётся один раз; кодирование и разбор не выделяют памяти.
+ * Экземпляр не потокобезопасен — по одному на поток.
+ */
+class QuicLbCodec {
+public:
+    /**
+     * @brief Конструктор.
+     * @param config Настройки; если они некорректны, ready() вернёт false.
+     */
+    explicit QuicLbCodec(const QuicLbConfig &config);
+    ~QuicLbCodec();
+
+    QuicLbCodec(const QuicLbCodec &) = delete;
+    QuicLbCodec &operator=(const QuicLbCodec &) = delete;
+
+    /**
+     * @brief Проверяет, корректны ли настройки и создан ли контекст шифрования.
+     */
+    [[nodiscard]] bool ready() const noexcept { return ready_; }
+
+    /**
+     * @brief Длина CID этой конфигурации.
+     */
+    [[nodiscard]] size_t cid_length() const noexcept { return 1 + config_.server_id_length + config_.nonce_length; }
+
+    /**
+     * @brief Собирает CID из server ID и nonce.
+     * @param server_id Server ID (server_id_length байт).
+     * @param nonce Nonce (nonce_length байт; у каждого CID сервера — свой).
+     * @param out Буфер не меньше cid_length().
+     * @return false при неверных длинах или ошибке шифрования.
+     */
+    [[nodiscard]] bool encode(std::span<const uint8_t> server_id, std::span<const uint8_t> nonce,
+                              std::span<uint8_t> out) noexcept;
+
+    /**
+     * @brief Собирает CID со случайным nonce (для выдачи сервером).
+     * @param server_id Server ID (server_id_length байт).
+     * @param out Буфер не меньше cid_length().
+     */
+    [[nodiscard]] bool generate(std::span<const uint8_t> server_id, std::span<uint8_t> out) noexcept;
+
+    /**
+     * @brief Извлекает server ID из CID.
+     * @param cid CID (для Short Header — байты после первого, не короче cid_length()).
+     * @param server_id Выход: server_id_length байт.
+     * @return false, если config ID или длина не совпадают с конфигурацией.
+     */
+    [[nodiscard]] bool decode(std::span<const uint8_t> cid, std::span<uint8_t> server_id) noexcept;
+
+    /**
+     * @brief Извлекает server ID как число (старший байт первым).
+     * @return Server ID или UINT64_MAX, если CID не этой конфигурации.
+     */
+    [[nodiscard]] uint64_t decode_index(std::span<const uint8_t> cid) noexcept;
+
+    /**
+     * @brief Кодирует число как server ID (старший байт первым).
+     * @param index Номер сервера.
+     * @param server_id Выход: server_id_length байт.
+     * @return false, если номер не помещается в server_id_length байт.
+     */
+    [[nodiscard]] bool server_id_of(uint64_t index, std::span<uint8_t> server_id) const noexcept;
+
+private:
+    QuicLbConfig config_;
+    EVP_CIPHER_CTX *encrypt_ctx_ = nullptr; ///< AES-128-ECB (single-pass)
+    EVP_CIPHER_CTX *decrypt_ctx_ = nullptr;
+    bool ready_ = false;
+};
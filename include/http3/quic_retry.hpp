@@ -0,0 +1,120 @@
+// include/http3/quic_retry.hpp
+/**
+ * @file quic_retry.hpp
+ * @brief Stateless Retry на границе: токены проверки адреса и Retry-пакеты QUIC.
+ *
+ * Прокси сам отвечает Retry на Initial без токена, не заводя состояния:
+ * всё нужное для проверки лежит в токене, защищённом AES-256-GCM.
+ *
+ * Формат токена:
+ *   0x52 | ODCID Len (1) | ODCID | nonce (12) | E(метка времени, 8) | тег (16)
+ * Associated data — открытая часть токена, IPv4-адрес клиента и DCID пакета, несущего
+ * токен (то есть SCID Retry): токен не переносится на другой адрес и другой CID.
+ * ODCID лежит открыто, чтобы бэкенд с тем же ключом мог заполнить транспортные параметры
+ * original_destination_connection_id и retry_source_connection_id (Retry offload).
+ *
+ * Retry Integrity Tag вычисляется по RFC 9001 §5.8 (v1) и RFC 9369 §3.3.3 (v2).
+ *
+ * @author Telian Edward <telianedward@icloud.com>
+ * @assisted-by AI-Assistant
+ * @date 2025-11-16
+ * @version 1.0
+ * @license MIT
+ */
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include "quic_header.hpp"
+
+typedef struct evp_cipher_ctx_st EVP_CIPHER_CTX;
+
+/// Размер ключа токенов (AES-256-GCM)
+constexpr size_t RETRY_TOKEN_KEY_SIZE = 32;
+/// Максимальный размер Retry-пакета, который строит QuicRetry
+constexpr size_t MAX_RETRY_PACKET_SIZE = 256;
+
+/**
+ * @brief Результат проверки токена Initial-пакета.
+ */
+enum class RetryTokenStatus {
+    Valid,    ///< Токен наш, адрес и CID совпадают, срок не истёк
+    Missing,  ///< Токена нет
+    Foreign,  ///< Чужой формат (например, NEW_TOKEN бэкенда) — адрес не подтверждён
+    Expired,  ///< Токен наш, но просрочен
+    Invalid   ///< Токен подделан или выдан другому адресу/CID
+};
+
+/**
+ * @brief Выпуск и проверка Retry-токенов одного рабочего потока.
+ *
+ * Контексты шифрования создаются один раз, поэтому выпуск и проверка не выделяют памяти.
+ */
+class QuicRetry {
+public:
+    static constexpr uint8_t TOKEN_FORMAT = 0x52;   ///< Первый байт наших токенов
+    static constexpr size_t NONCE_SIZE = 12;
+    static constexpr size_t TAG_SIZE = 16;
+    static constexpr size_t RETRY_CID_LENGTH = 8;   ///< Длина SCID Retry-пакета
+
+    /**
+     * @brief Конструктор.
+     * @param key Ключ токенов (RETRY_TOKEN_KEY_SIZE байт, общий для потоков и бэкенда).
+     * @param lifetime Срок действия токена.
+     */
+    QuicRetry(std::span<const uint8_t> key, std::chrono::seconds lifetime);
+    ~QuicRetry();
+
+    QuicRetry(const QuicRetry &) = delete;
+    QuicRetry &operator=(const QuicRetry &) = delete;
+
+    /**
+     * @brief Заполняет ключ токенов криптографически стойкими случайными байтами.
+     * @param key Буфер RETRY_TOKEN_KEY_SIZE байт.
+     * @return false при ошибке генератора.
+     */
+    [[nodiscard]] static bool generate_key(std::span<uint8_t> key) noexcept;
+
+    /**
+     * @brief Проверяет, удалось ли создать контексты шифрования.
+     */
+    [[nodiscard]] bool ready() const noexcept { return seal_ctx_ != nullptr && open_ctx_ != nullptr && tag_ctx_ != nullptr; }
+
+    /**
+     * @brief Строит Retry-пакет в ответ на Initial.
+     * @param initial Разобранный Initial клиента (DCID станет ODCID, SCID — DCID ответа).
+     * @param client_addr IPv4-адрес клиента (сетевой порядок байт).
+     * @param out Буфер не меньше MAX_RETRY_PACKET_SIZE.
+     * @return Размер пакета или 0 при ошибке.
+     */
+    [[nodiscard]] size_t build_retry(const QuicHeaderView &initial, uint32_t client_addr, std::span<uint8_t> out) noexcept;
+
+    /**
+     * @brief Проверяет токен Initial-пакета.
+     * @param initial Разобранный Initial клиента.
+     * @param client_addr IPv4-адрес клиента (сетевой порядок байт).
+     */
+    [[nodiscard]] RetryTokenStatus validate(const QuicHeaderView &initial, uint32_t client_addr) noexcept;
+
+    /**
+     * @brief Вычисляет Retry Integrity Tag.
+     * @param version Версия QUIC (v1 или v2).
+     * @param odcid DCID исходного Initial клиента.
+     * @param retry Retry-пакет без тега.
+     * @param tag Выход: TAG_SIZE байт.
+     * @return false для неизвестной версии или при ошибке шифрования.
+     */
+    [[nodiscard]] bool integrity_tag(uint32_t version, std::span<const uint8_t> odcid,
+                                     std::span<const uint8_t> retry, uint8_t *tag) noexcept;
+
+private:
+    std::chrono::seconds lifetime_;
+    EVP_CIPHER_CTX *seal_ctx_ = nullptr;  ///< AES-256-GCM: шифрование токенов
+    EVP_CIPHER_CTX *open_ctx_ = nullptr;  ///< AES-256-GCM: проверка токенов
+    EVP_CIPHER_CTX *tag_ctx_ = nullptr;   ///< AES-128-GCM Retry Integrity Tag
+
+    /// Собирает associated data токена: открытая часть + адрес + DCID пакета с токеном
+    static size_t token_aad(std::span<const uint8_t> odcid, uint32_t client_addr,
+                            std::span<const uint8_t> token_dcid, uint8_t *out) noexcept;
+};
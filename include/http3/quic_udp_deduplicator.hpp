@@ -1,9 +1,15 @@
 /**
  * @file quic_udp_deduplicator.hpp
- * @brief Краткое описание назначения заголовочного файла.
+ * @brief Дедупликация QUIC-пакетов по отпечатку их байтов.
  *
- * Более подробное описание того, какие классы, функции, структуры объявляет файл.
- * Может содержать информацию о зависимости от других модулей или ограничениях использования.
+ * Номер пакета в Long Header защищён Header Protection, а снять её прокси не может
+ * (ключи 0-RTT и Handshake ему недоступны), поэтому окно номеров здесь неприменимо.
+ * QUIC никогда не повторяет номер пакета: повторная передача — новый пакет с новыми
+ * байтами. Значит, повторный пакет — только побайтовая копия из сети, и её достаточно
+ * узнать по отпечатку защищённого пакета.
+ *
+ * Отпечатки хранятся в записи сессии, поэтому проверка занимает O(1), не выделяет
+ * память и освобождается вместе с сессией.
  *
  * @author Telian Edward <telianedward@icloud.com>
  * @assisted-by AI-Assistant
@@ -12,56 +18,22 @@
  * @license MIT
  */
 // include/quic_udp_deduplicator.hpp
-// include/quic_udp_deduplicator.hpp
 
 #pragma once
-#include <unordered_map>
-#include <vector>
+#include <cstddef>
 #include <cstdint>
-#include <string>
-#include "client_key.hpp"
+#include <span>
 
 /**
- * @brief Класс для дедупликации QUIC-пакетов.
+ * @brief Отпечатки последних Long Header пакетов одного соединения.
  *
- * Хранит информацию о первом Initial-пакете для каждого клиента.
- * Позволяет определить, является ли пакет повторным.
+ * Помнит HISTORY последних отпечатков (кольцо). Повторным считается только пакет,
+ * совпадающий с одним из них; давно увиденная копия пропускается — бэкенд отбросит
+ * её сам, а потерять настоящий пакет рукопожатия хуже.
  */
 class Deduplicator {
 public:
-    /**
-     * @brief Структура для хранения информации о первом Initial-пакете.
-     */
-    struct PacketInfo {
-        std::vector<uint8_t> token; ///< Токен из Retry-пакета
-        std::vector<uint8_t> scid;  ///< SCID из первого Initial-пакета
-        uint64_t packet_number;     ///< Номер пакета
-        // Можно добавить другие поля, если нужно
-    };
-
-    /**
-     * @brief Структура для ключа дедупликации.
-     */
-    struct PacketKey {
-        ClientKey client_key;       ///< Ключ клиента (IP + порт)
-        std::vector<uint8_t> scid;  ///< SCID
-        std::vector<uint8_t> dcid;  ///< DCID
-        uint64_t packet_number;     ///< Номер пакета
-    };
-
-    /**
-     * @brief Хеш-функция для PacketKey.
-     */
-    struct PacketKeyHash {
-        size_t operator()(const PacketKey &key) const noexcept;
-    };
-
-    /**
-     * @brief Оператор сравнения для PacketKey.
-     */
-    struct PacketKeyEqual {
-        bool operator()(const PacketKey &a, const PacketKey &b) const noexcept;
-    };
+    static constexpr size_t HISTORY = 16; ///< Запоминаемых пакетов на соединение
 
     /**
      * @brief Конструктор.
@@ -69,28 +41,13 @@ public:
     Deduplicator() = default;
 
     /**
-     * @brief Добавляет информацию о первом Initial-пакете.
-     * @param key Ключ клиента.
-     * @param info Информация о пакете.
-     */
-    void add_packet(const ClientKey &key, const PacketInfo &info);
-
-    /**
-     * @brief Проверяет, является ли пакет повторным.
-     * @param key Ключ клиента.
-     * @param scid SCID из пакета.
-     * @param dcid DCID из пакета.
-     * @param packet_number Номер пакета.
-     * @return true, если пакет повторный, false — иначе.
-     */
-    [[nodiscard]] bool is_duplicate(const ClientKey &key, const std::vector<uint8_t> &scid, const std::vector<uint8_t> &dcid, uint64_t packet_number) const;
-
-    /**
-     * @brief Удаляет информацию о соединении.
-     * @param key Ключ клиента.
+     * @brief Проверяет пакет и запоминает его отпечаток.
+     * @param packet Пакет целиком, как на проводе (заголовок и защищённая нагрузка).
+     * @return true, если точно такой же пакет уже был среди последних HISTORY, false — если увиден впервые.
      */
-    void remove_connection(const ClientKey &key);
+    [[nodiscard]] bool check_and_record(std::span<const uint8_t> packet) noexcept;
 
 private:
-    std::unordered_map<PacketKey, bool, PacketKeyHash, PacketKeyEqual> seen_packets_;
-};
\ No newline at end of file
+    uint64_t fingerprints_[HISTORY]{}; ///< Отпечатки (0 — пусто)
+    uint8_t next_ = 0;                 ///< Позиция следующей записи в кольце
+};
@@ -4,7 +4,22 @@
  * @brief Заголовочный файл для QUIC-UDP прокси.
  *
  * Обеспечивает прозрачное перенаправление QUIC-пакетов от клиента к серверу в России.
- * Использует асинхронный I/O (select) для масштабируемости.
+ * Цикл событий — edge-triggered epoll с пакетным приёмом/отправкой (recvmmsg/sendmmsg)
+ * либо io_uring (multishot recvmsg + зарегистрированные буферы); выбирается в настройках.
+ * Может работать в нескольких потоках: у каждого свой SO_REUSEPORT-сокет, сокет к бэкенду
+ * и таблицы сессий, а пакеты распределяются между потоками по байту DCID.
+ * С UDP GRO/GSO пачка датаграмм одного потока проходит границу ядра одним буфером;
+ * при пересылке границы и размеры сегментов сохраняются.
+ * Со stateless Retry прокси сам проверяет адрес клиента, и через туннель идут только
+ * Initial с действительным токеном.
+ * В режиме flow NAT пакеты не разбираются: на каждый адрес:порт клиента открывается
+ * свой подключённый сокет к бэкенду, и ответы сопоставляются клиенту по дескриптору.
+ * На неподдерживаемые версии прокси сам отвечает Version Negotiation, а Initial
+ * меньше 1200 байт и пакеты с невозможными длинами отбрасывает до туннеля.
+ * Сессия ищется по Connection ID, а адрес:порт клиента — изменяемый атрибут пути:
+ * после смены NAT-привязки или миграции ответы идут на новый адрес.
+ * С проверкой бэкендов недоступные бэкенды исключаются из таблицы Maglev, и новые
+ * соединения уходят на остальные.
  *
  * @author Telian Edward <telianedward@icloud.com>
  * @assisted-by AI-Assistant
@@ -26,33 +41,261 @@
 #include <arpa/inet.h>
 #include <csignal>
 #include <cerrno>
-#include <sys/select.h>
+#include <sys/epoll.h>
 #include <thread>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <span>
 #include "../logger/logger.h"
+#include "../health/backend_health.hpp"
 #include "client_key.hpp"
+#include "connection_id.hpp"
+#include "quic_header.hpp"
+#include "quic_retry.hpp"
+#include "quic_initial.hpp"
+#include "quic_lb.hpp"
+#include "prefix_rate_limiter.hpp"
+#include "cid_table.hpp"
+#include "maglev_table.hpp"
+#include "timer_wheel.hpp"
 #include "quic_udp_deduplicator.hpp"
+#include "udp_batch.hpp"
+#include "uring_reactor.hpp"
 
 // === Константы ===
-constexpr size_t MAX_PACKET_SIZE = 1500; // Максимальный размер UDP-пакета
-
-// === Хэш-функции и равенство для std::vector<uint8_t> ===
-struct VectorHash {
-    size_t operator()(const std::vector<uint8_t> &v) const noexcept {
-        size_t result = 0;
-        for (uint8_t b : v) {
-            result ^= static_cast<size_t>(b);
-            result *= 2654435761U; // FNV prime
-        }
-        return result;
-    }
+constexpr size_t MAX_PACKET_SIZE = 65535; // Максимальный размер UDP-датаграммы или GRO-супербуфера
+constexpr size_t DEFAULT_UDP_BATCH_SIZE = 32; // Датаграмм за один recvmmsg/sendmmsg
+constexpr std::chrono::milliseconds SESSION_TIMER_TICK{100}; // Тик колеса таймеров сессий
+constexpr size_t MAX_SERVER_CIDS_PER_SESSION = 4; // CID сервера, запоминаемых на одну сессию
+constexpr int MAX_EPOLL_EVENTS = 64; // Событий за один epoll_wait
+constexpr uint32_t AMPLIFICATION_FACTOR = 3; // Предел ответа неподтверждённому адресу (RFC 9000 §8)
+constexpr size_t MAX_HELD_DATAGRAMS = 4; // Датаграмм клиента, задерживаемых до сборки ClientHello
+constexpr size_t HELD_DATAGRAM_BYTES = 6144; // Их суммарный размер
+constexpr uint32_t NO_PENDING_HELLO = UINT32_MAX; // Сессия не ждёт ClientHello
+constexpr size_t MIN_INITIAL_DATAGRAM_SIZE = 1200; // Минимальная датаграмма с Initial клиента (RFC 9000 §14.1)
+constexpr uint64_t MIN_PROTECTED_LENGTH = 20; // Length защищённого пакета: 4 байта до образца HP + 16 байт образца
+
+/**
+ * @brief Тип цикла событий QUIC-UDP прокси.
+ */
+enum class QuicReactorKind {
+    Epoll,   ///< Edge-triggered epoll + recvmmsg/sendmmsg
+    IoUring  ///< io_uring: multishot recvmsg, кольцо буферов, sendmsg через SQ
 };
 
-struct VectorEqual {
-    bool operator()(const std::vector<uint8_t> &a, const std::vector<uint8_t> &b) const noexcept {
-        if (a.size() != b.size())
-            return false;
-        return std::equal(a.begin(), a.end(), b.begin());
-    }
+/**
+ * @brief Способ сопоставления ответов бэкенда клиентам.
+ */
+enum class QuicForwardingMode {
+    Cid,     ///< Разбор заголовков QUIC: сессии по Connection ID, один сокет к бэкенду
+    FlowNat  ///< Свой подключённый сокет к бэкенду на каждый адрес:порт клиента, без разбора пакетов
+};
+
+/**
+ * @brief Адрес дополнительного бэкенда.
+ */
+struct QuicBackendEndpoint {
+    std::string ip;      ///< IPv4-адрес
+    int port = 0;        ///< UDP-порт
+    bool hashed = true;  ///< Участвует в распределении Maglev (false — только через route_client_hello)
+};
+
+/**
+ * @brief Настройки QUIC-UDP прокси.
+ */
+struct QuicUdpProxyOptions {
+    size_t batch_size = DEFAULT_UDP_BATCH_SIZE;     ///< Датаграмм за один recvmmsg/sendmmsg
+    std::chrono::seconds stats_interval{10};        ///< Период вывода статистики (0 — не выводить)
+    QuicReactorKind reactor = QuicReactorKind::Epoll; ///< Цикл событий
+    unsigned uring_entries = 256;                   ///< Размер SQ для io_uring
+    unsigned uring_buffers = 256;                   ///< Буферов приёма в кольце io_uring (по MAX_PACKET_SIZE)
+    unsigned workers = 1;                           ///< Рабочих потоков (свой SO_REUSEPORT-сокет у каждого)
+    bool cid_steering = true;                       ///< Выбирать поток по DCID (SO_ATTACH_REUSEPORT_CBPF)
+    /**
+     * @brief Номер байта DCID, по которому выбирается поток (DCID[k] % workers).
+     *
+     * Чтобы Handshake и 1-RTT пакеты попадали в тот же поток, что и первый Initial,
+     * бэкенд должен копировать этот байт исходного DCID клиента в выбираемые им CID.
+     */
+    uint8_t steering_cid_byte = 0;
+    bool udp_gso = true;                            ///< UDP GRO на приёме и GSO (UDP_SEGMENT) на отправке
+    std::chrono::seconds session_idle_timeout{30};  ///< Сессия без пакетов дольше этого срока удаляется
+    size_t session_memory_budget = 64 * 1024 * 1024; ///< Бюджет памяти таблиц сессий на поток (байт)
+    QuicForwardingMode forwarding = QuicForwardingMode::Cid; ///< Режим пересылки
+    size_t max_flows = 16384;                       ///< Предел потоков flow NAT на поток (по сокету на каждый)
+    /**
+     * @brief Отвечать Retry на Initial без токена и пропускать к бэкенду только подтверждённые адреса (режим Cid).
+     *
+     * Бэкенд должен принимать токены прокси (общий retry_token_key): из токена он берёт
+     * ODCID для транспортных параметров original_destination_connection_id и
+     * retry_source_connection_id.
+     */
+    bool stateless_retry = false;
+    std::chrono::seconds retry_token_lifetime{10};  ///< Срок действия Retry-токена
+    std::vector<uint8_t> retry_token_key;           ///< Ключ токенов (32 байта); пустой — случайный на процесс
+    uint32_t admission_rate = 0;                    ///< Новых соединений в секунду с префикса /24 на поток (0 — без лимита)
+    uint32_t admission_burst = 32;                  ///< Допустимый всплеск новых соединений с префикса
+    size_t admission_buckets = 16384;               ///< Корзин в каждой строке таблицы лимитов (память постоянна)
+    /**
+     * @brief Дополнительные бэкенды (индексы 1..N; 0 — основной backend_ip).
+     *
+     * Новые соединения распределяются между основным и бэкендами с hashed = true
+     * по таблице Maglev: в режиме Cid — по SCID клиента, в режиме flow NAT — по адресу:порту.
+     */
+    std::vector<QuicBackendEndpoint> backends;
+    uint32_t maglev_table_size = MaglevTable::DEFAULT_SIZE; ///< Слотов таблицы Maglev (простое число)
+    /**
+     * @brief Выбор бэкенда по SNI и ALPN первого ClientHello клиента (режим Cid).
+     *
+     * Возвращает 0 для основного бэкенда или i для backends[i - 1];
+     * значение вне диапазона оставляет бэкенд, выбранный Maglev.
+     * Вызывается один раз на соединение из всех рабочих потоков — должен быть потокобезопасным.
+     * Не должна бросать исключений. Пустая функция выключает маршрутизацию: Initial-пакеты не расшифровываются.
+     */
+    std::function<size_t(const QuicClientHelloInfo &)> route_client_hello;
+    size_t max_pending_client_hellos = 256;         ///< Соединений на поток, одновременно ждущих ClientHello
+    /**
+     * @brief Направлять пакеты клиента по server ID из CID QUIC-LB (режим Cid).
+     *
+     * Server ID бэкенда — его индекс (0 — основной, i — backends[i - 1]), старший байт первым.
+     * Short Header с таким DCID уходит на бэкенд без поиска в таблицах сессий,
+     * в том числе по CID, выданным сервером позже в NEW_CONNECTION_ID.
+     */
+    bool quic_lb = false;
+    QuicLbConfig quic_lb_config;                    ///< Настройки QUIC-LB (общие с бэкендами)
+    /**
+     * @brief Проверять бэкенды пробами Version Negotiation и не выбирать недоступные.
+     *
+     * Недоступный бэкенд исключается из таблицы Maglev и не принимается от route_client_hello;
+     * уже закреплённые за ним соединения не переносятся — их состояние есть только на нём.
+     * Если недоступны все, распределение идёт по всем бэкендам с hashed = true.
+     */
+    bool health_check = false;
+    /**
+     * @brief Смен адреса клиента на сессию за path_change_window (режим Cid).
+     *
+     * Пакет с известным CID с нового адреса переключает на него ответы сервера;
+     * сверх лимита пакет пересылается, но ответы идут по прежнему адресу.
+     * Ограничивает перехват пути повтором чужих пакетов с подменённого адреса.
+     */
+    uint8_t max_path_changes = 4;
+    /**
+     * @brief Версии QUIC бэкенда (режим Cid).
+     *
+     * На Long Header другой версии прокси сам отвечает Version Negotiation из заранее
+     * собранного списка (с зарезервированной версией 0x?a?a?a?a, RFC 9000 §6.3); пакет в туннель не идёт.
+     */
+    std::vector<uint32_t> supported_versions{QUIC_VERSION_1, QUIC_VERSION_2};
+    bool version_negotiation = true;                ///< Отвечать на неподдерживаемые версии (false — пересылать)
+    std::chrono::seconds path_change_window{10};    ///< Окно лимита смен адреса
+    HealthCheckOptions health_check_options;        ///< Период проб, гистерезис, веса EWMA
+};
+
+/**
+ * @brief Счётчики stateless Retry.
+ */
+struct QuicRetryStats {
+    uint64_t sent = 0;       ///< Отправлено Retry
+    uint64_t validated = 0;  ///< Initial с действительным токеном
+    uint64_t expired = 0;    ///< Initial с просроченным токеном (ответ — новый Retry)
+    uint64_t invalid = 0;    ///< Отброшено: поддельный токен или пакет без подтверждённого адреса
+};
+
+/**
+ * @brief Счётчики пакетов клиента, отсеянных до туннеля.
+ */
+struct QuicEdgeStats {
+    uint64_t version_negotiation = 0; ///< Отправлено Version Negotiation
+    uint64_t unsupported_small = 0;   ///< Неподдерживаемая версия в датаграмме меньше 1200 байт (без ответа)
+    uint64_t small_initial = 0;       ///< Initial в датаграмме меньше 1200 байт
+    uint64_t malformed = 0;           ///< Long Header не разбирается: обрезан, CID длиннее 20, Token или Length за концом
+    uint64_t bad_length = 0;          ///< Length меньше минимального защищённого пакета
+    uint64_t client_negotiation = 0;  ///< Version Negotiation от клиента
+};
+
+/**
+ * @brief Счётчики маршрутизации по ClientHello.
+ */
+struct QuicRoutingStats {
+    uint64_t routed = 0;    ///< Соединений, направленных обработчиком по ClientHello
+    uint64_t fallback = 0;  ///< Оставлено на бэкенде Maglev по SCID: ClientHello не расшифрован или не разобран
+    uint64_t overflow = 0;  ///< Оставлено на бэкенде Maglev по SCID: нет свободных записей или места для датаграмм
+    uint64_t held = 0;      ///< Датаграмм, задержанных до сборки ClientHello
+    uint64_t cid_routed = 0; ///< Short Header, направленных по server ID из CID (QUIC-LB)
+};
+
+/**
+ * @brief Счётчики таблиц сессий.
+ *
+ * В режиме flow NAT сессией считается поток клиента (адрес:порт) со своим сокетом.
+ */
+struct QuicSessionStats {
+    size_t active = 0;        ///< Живых сессий
+    uint64_t created = 0;     ///< Создано сессий
+    uint64_t expired = 0;     ///< Удалено по таймауту простоя
+    uint64_t evicted = 0;     ///< Вытеснено при превышении бюджета памяти
+    uint64_t rejected = 0;    ///< Не созданы: достигнут max_flows или не открылся сокет (flow NAT)
+    uint64_t admission_dropped = 0; ///< Новые соединения, отброшенные лимитом по префиксу
+    uint64_t amplification_dropped = 0;       ///< Пакеты сервера, превысившие лимит 3x до подтверждения адреса
+    uint64_t amplification_dropped_bytes = 0; ///< Их байты
+    uint64_t migrated = 0;        ///< Смен адреса клиента (NAT rebinding, миграция)
+    uint64_t migration_limited = 0; ///< Смен адреса, отклонённых лимитом на сессию
+    size_t memory_bytes = 0;  ///< Оценка памяти, занятой сессиями
+};
+
+/**
+ * @brief Запись сессии клиента.
+ *
+ * Хранится в векторе sessions_; таблицы CID ссылаются на неё по индексу.
+ */
+struct QuicSession {
+    ClientKey key;       ///< SCID клиента и текущий адрес пути (меняется при миграции)
+    Deduplicator dedup;  ///< Отпечатки недавних Long Header пакетов клиента
+    ConnectionId client_cid; ///< CID клиента (ключ в client_cids_)
+    ConnectionId server_cids[MAX_SERVER_CIDS_PER_SESSION]; ///< CID сервера (ключи в server_cids_)
+    uint32_t pending_hello = NO_PENDING_HELLO; ///< Запись pending_hellos_, пока ClientHello не собран
+    uint32_t bytes_received = 0; ///< Байт от клиента до подтверждения адреса (с насыщением)
+    uint32_t bytes_sent = 0;     ///< Байт клиенту до подтверждения адреса
+    uint16_t backend = 0;        ///< Индекс бэкенда в backends_ (Maglev по SCID или route_client_hello)
+    uint8_t server_cid_count = 0; ///< Заполнено server_cids
+    uint8_t path_changes = 0;    ///< Смен адреса в текущем окне
+    uint64_t path_window_start = 0; ///< Тик начала окна лимита смен адреса
+    bool routed = false;         ///< Бэкенд выбран (без маршрутизации по ClientHello — сразу)
+    bool address_validated = false; ///< Адрес подтверждён: лимит 3x больше не действует
+    bool active = false;     ///< Запись занята
+    bool referenced = false; ///< Бит CLOCK: был трафик с прошлого прохода стрелки
+    uint64_t last_active = 0; ///< Тик последнего пакета
+};
+
+/**
+ * @brief Соединение, ждущее полного ClientHello для выбора бэкенда.
+ *
+ * Пока ClientHello не собран, датаграммы клиента копируются сюда и уходят
+ * на выбранный бэкенд вместе с последней.
+ */
+struct PendingClientHello {
+    QuicInitialKeys keys{};       ///< Ключи Initial клиента
+    ConnectionId keys_dcid;       ///< DCID, из которого выведены keys
+    QuicCryptoAssembler crypto;   ///< Сборка CRYPTO-потока
+    uint8_t held[HELD_DATAGRAM_BYTES]; ///< Задержанные датаграммы подряд
+    uint16_t held_sizes[MAX_HELD_DATAGRAMS]; ///< Их размеры
+    uint8_t held_count = 0;       ///< Задержано датаграмм
+    size_t held_bytes = 0;        ///< Занято в held
+};
+
+/**
+ * @brief Поток клиента в режиме flow NAT.
+ *
+ * Хранится в векторе flows_; по дескриптору сокета индекс находится через flow_by_fd_.
+ */
+struct NatFlow {
+    sockaddr_in client{};     ///< Адрес клиента
+    int fd = -1;              ///< Сокет, подключённый к бэкенду
+    uint16_t backend = 0;     ///< Индекс бэкенда в backends_
+    bool active = false;      ///< Запись занята
+    uint64_t last_active = 0; ///< Тик последнего пакета
 };
 
 /**
@@ -67,8 +310,10 @@ public:
      * @param listen_port Порт, на котором слушает прокси (обычно 443).
      * @param backend_ip IP-адрес сервера в России.
      * @param backend_port Порт сервера в России.
+     * @param options Дополнительные настройки (размер пакета recvmmsg/sendmmsg и т.д.).
      */
-    QuicUdpProxy(int listen_port, const std::string& backend_ip, int backend_port);
+    QuicUdpProxy(int listen_port, const std::string& backend_ip, int backend_port,
+                 const QuicUdpProxyOptions& options = {});
 
     /**
      * @brief Запускает QUIC-UDP прокси.
@@ -81,19 +326,87 @@ public:
      */
     void stop();
 
+    /**
+     * @brief Возвращает счётчики сессий этого потока.
+     *
+     * Вызывать из потока, выполняющего цикл событий (или после остановки);
+     * каждый поток также выводит свои счётчики в периодической статистике.
+     */
+    [[nodiscard]] QuicSessionStats session_stats() const noexcept;
+
+    /**
+     * @brief Возвращает счётчики stateless Retry этого потока.
+     */
+    [[nodiscard]] QuicRetryStats retry_stats() const noexcept { return retry_stats_; }
+
+    /**
+     * @brief Возвращает счётчики маршрутизации по ClientHello этого потока.
+     */
+    [[nodiscard]] QuicRoutingStats routing_stats() const noexcept { return routing_stats_; }
+
+    /**
+     * @brief Возвращает счётчики пакетов, отсеянных до туннеля, этого потока.
+     */
+    [[nodiscard]] QuicEdgeStats edge_stats() const noexcept { return edge_stats_; }
+
 private:
     int udp_fd_;              ///< Сокет для прослушивания входящих пакетов от клиентов
     int wg_fd_;               ///< Сокет для отправки пакетов на сервер в России
     int listen_port_;         ///< Порт, на котором слушает прокси
     int backend_port_;        ///< Порт сервера в России
     std::string backend_ip_;  ///< IP сервера в России
-    volatile sig_atomic_t running_{true}; ///< Флаг работы прокси
+    QuicUdpProxyOptions options_; ///< Настройки прокси
+    std::atomic<bool> running_{true}; ///< Флаг работы прокси (атомарный — stop() из другого потока)
+    unsigned worker_index_ = 0;   ///< Номер потока (0 — основной)
+    std::vector<std::unique_ptr<QuicUdpProxy>> workers_; ///< Дополнительные потоки (только у основного)
+    sockaddr_in backend_addr_{}; ///< Адрес сервера в России (заполняется в run())
+
+    // Пакетный ввод-вывод: буферы приёма и очереди отправки
+    UdpRecvBatch client_rx_;   ///< Приём от клиентов (udp_fd_)
+    UdpRecvBatch backend_rx_;  ///< Приём от сервера в России (wg_fd_)
+    UdpSendBatch client_tx_;   ///< Отправка клиентам через udp_fd_
+    UdpSendBatch backend_tx_;  ///< Отправка в Россию через wg_fd_
+    UdpBatchStats client_stats_;  ///< Счётчики udp_fd_
+    UdpBatchStats backend_stats_; ///< Счётчики wg_fd_
+    std::unique_ptr<UringReactor> uring_; ///< Реактор io_uring (nullptr в режиме epoll)
+
+    std::vector<QuicSession> sessions_; ///< Сессии; индекс в этом векторе хранят таблицы CID
+    CidTable client_cids_;  ///< CID клиента -> индекс в sessions_ (поиск клиента по DCID пакетов от сервера)
+    CidTable server_cids_;  ///< CID, выбранный сервером -> индекс в sessions_ (Short Header от клиента)
+    uint32_t client_cid_lengths_ = 0; ///< Битовая маска длин CID в client_cids_
+    uint32_t server_cid_lengths_ = 0; ///< Битовая маска длин CID в server_cids_
+    std::vector<uint32_t> free_sessions_; ///< Свободные записи sessions_
+    TimerWheel session_timers_;   ///< Таймеры простоя сессий (идентификатор — индекс в sessions_)
+    uint64_t now_tick_ = 0;       ///< Текущий тик (обновляется раз за итерацию цикла)
+    uint32_t clock_hand_ = 0;     ///< Стрелка CLOCK для вытеснения
+    QuicSessionStats session_stats_; ///< Счётчики сессий потока
+
+    std::unique_ptr<QuicRetry> retry_; ///< Выпуск и проверка Retry-токенов (nullptr, если Retry выключен)
+    QuicRetryStats retry_stats_;       ///< Счётчики Retry
+    std::unique_ptr<PrefixRateLimiter> admission_; ///< Лимит новых соединений по префиксу (nullptr — выключен)
 
-    // Map: ClientKey -> ClientKey (для хранения токена)
-    std::unordered_map<ClientKey, ClientKey, ClientKeyHash, ClientKeyEqual> session_map_;
-    // Reverse map: DCID -> ClientKey (для поиска клиента по DCID)
-    std::unordered_map<std::vector<uint8_t>, ClientKey, VectorHash, VectorEqual> reverse_map_;
-    Deduplicator deduplicator_; // Экземпляр дедупликатора
+    // Маршрутизация по ClientHello
+    std::vector<sockaddr_in> backends_;   ///< Адреса бэкендов: [0] — основной, далее options_.backends
+    MaglevTable maglev_;                  ///< Выбор бэкенда нового соединения по хэшу CID или адреса
+    std::unique_ptr<QuicLbCodec> quic_lb_; ///< Разбор CID QUIC-LB (nullptr — выключен)
+    std::unique_ptr<QuicInitialDecryptor> initial_decryptor_; ///< nullptr, если маршрутизация выключена
+    std::vector<PendingClientHello> pending_hellos_; ///< Записи соединений, ждущих ClientHello
+    std::vector<uint32_t> free_pending_hellos_;      ///< Свободные записи pending_hellos_
+    QuicRoutingStats routing_stats_;      ///< Счётчики маршрутизации
+    std::vector<uint8_t> vn_versions_;    ///< Список версий Version Negotiation (готовые байты)
+    QuicEdgeStats edge_stats_;            ///< Счётчики отсеянных пакетов
+    std::vector<std::string> backend_names_; ///< Имена «ip:port» бэкендов для таблицы Maglev
+    std::vector<bool> backend_hashed_;    ///< Участвуют в распределении Maglev
+    std::shared_ptr<BackendHealthChecker> health_; ///< Проверка бэкендов (общая для потоков; nullptr — выключена)
+    uint64_t health_generation_ = 0;      ///< Поколение состояний, по которому построена таблица Maglev
+
+    // Режим flow NAT
+    int epoll_fd_ = -1;                   ///< epoll потока (сокеты потоков регистрируются на лету)
+    std::vector<NatFlow> flows_;          ///< Потоки клиентов
+    CidTable flow_by_client_;             ///< Адрес и порт клиента (6 байт) -> индекс в flows_
+    std::vector<uint32_t> flow_by_fd_;    ///< Дескриптор сокета -> индекс в flows_ (плотный массив)
+    std::vector<uint32_t> free_flows_;    ///< Свободные записи flows_
+    TimerWheel flow_timers_;              ///< Таймеры простоя потоков (идентификатор — индекс в flows_)
 
     /**
      * @brief Устанавливает неблокирующий режим сокета.
@@ -123,12 +436,314 @@ private:
      */
     void print_hex(const uint8_t *data, size_t len, const std::string &label) noexcept;
 
+    /// Индексы сокетов, зарегистрированных в io_uring
+    static constexpr int URING_CLIENT_SOCKET = 0;
+    static constexpr int URING_BACKEND_SOCKET = 1;
+
+    /**
+     * @brief Создаёт и привязывает сокет клиентов (SO_REUSEPORT) и сокет к бэкенду.
+     * @return true при успехе.
+     */
+    [[nodiscard]] bool open_sockets() noexcept;
+
+    /**
+     * @brief Закрывает сокеты потока.
+     */
+    void close_sockets() noexcept;
+
+    /**
+     * @brief Подключает к reuseport-группе cBPF-программу выбора потока по DCID.
+     * @param worker_count Число сокетов в группе.
+     * @return true при успехе.
+     */
+    [[nodiscard]] bool attach_cid_steering(unsigned worker_count) noexcept;
+
+    /**
+     * @brief Выполняет цикл событий потока до остановки и закрывает его сокеты.
+     * @return true при штатной остановке.
+     */
+    [[nodiscard]] bool serve() noexcept;
+
+    /**
+     * @brief Цикл событий на edge-triggered epoll.
+     * @return true при штатной остановке, false при ошибке.
+     */
+    [[nodiscard]] bool run_epoll_loop() noexcept;
+
+    /**
+     * @brief Цикл событий на io_uring.
+     * @return true при штатной остановке, false если io_uring недоступен или сломался.
+     */
+    [[nodiscard]] bool run_uring_loop() noexcept;
+
+    /**
+     * @brief Выводит статистику, если с прошлого вывода прошло stats_interval.
+     * @param last Время прошлого вывода (обновляется).
+     */
+    void maybe_log_stats(std::chrono::steady_clock::time_point &last) const noexcept;
+
+    /**
+     * @brief Строит таблицу Maglev из доступных бэкендов с hashed = true.
+     */
+    void rebuild_backend_table() noexcept;
+
+    /**
+     * @brief Перестраивает таблицу Maglev, если проверка бэкендов сменила их состояние.
+     */
+    void refresh_backend_health() noexcept;
+
+    /**
+     * @brief Вычитывает из сокета все готовые датаграммы пачками по batch_size.
+     * @param fd Сокет (udp_fd_ или wg_fd_).
+     * @param from_client true для сокета клиентов, false для сокета бэкенда.
+     */
+    void drain_socket(int fd, bool from_client) noexcept;
+
+    /**
+     * @brief Разбирает принятый буфер на датаграммы (GRO-сегменты) и обрабатывает каждую.
+     * @param data Начало буфера.
+     * @param len Длина буфера.
+     * @param segment_size Размер сегмента (равен len, если буфер не склеен GRO).
+     * @param addr Адрес отправителя.
+     * @param addr_len Размер структуры адреса.
+     * @param from_client true для буфера с сокета клиентов.
+     */
+    void dispatch_datagrams(uint8_t *data, size_t len, size_t segment_size,
+                            const sockaddr_in &addr, socklen_t addr_len, bool from_client) noexcept;
+
+    /**
+     * @brief Включает UDP GRO на сокете и GSO на соответствующей очереди отправки.
+     * @param fd Сокет.
+     * @param tx Очередь отправки через этот сокет.
+     */
+    void enable_segmentation(int fd, UdpSendBatch &tx) noexcept;
+
+    /**
+     * @brief Ставит датаграмму в очередь отправки клиенту.
+     *
+     * Если очередь заполнена, она предварительно сбрасывается.
+     */
+    void queue_to_client(const uint8_t *data, size_t len, const sockaddr_in &dest) noexcept;
+
+    /**
+     * @brief Ставит датаграмму в очередь отправки в Россию.
+     *
+     * Если очередь заполнена, она предварительно сбрасывается.
+     */
+    void queue_to_backend(const uint8_t *data, size_t len, const sockaddr_in &dest) noexcept;
+
+    /**
+     * @brief Сбрасывает обе очереди отправки (sendmmsg или SQE io_uring).
+     */
+    void flush_send_queues() noexcept;
+
+    /**
+     * @brief Сбрасывает одну очередь отправки.
+     * @param batch Очередь.
+     * @param fd Сокет для sendmmsg.
+     * @param uring_socket Индекс сокета в io_uring.
+     * @param stats Счётчики.
+     */
+    void flush_queue(UdpSendBatch &batch, int fd, int uring_socket, UdpBatchStats &stats) noexcept;
+
+    /**
+     * @brief Выводит статистику пакетов на системный вызов.
+     */
+    void log_io_stats() const noexcept;
+
     /**
      * @brief Обработчик сигналов завершения.
      * @param sig Номер сигнала.
      */
     static void signal_handler(int sig);
 
+    /**
+     * @brief Возвращает текущий тик колеса таймеров.
+     */
+    [[nodiscard]] static uint64_t current_tick() noexcept;
+
+    /**
+     * @brief Создаёт сессию для нового SCID клиента (при нехватке бюджета вытесняет холодные).
+     * @param key Ключ клиента.
+     * @param scid SCID клиента.
+     * @return Индекс сессии в sessions_.
+     */
+    [[nodiscard]] uint32_t create_session(const ClientKey &key, const ConnectionId &scid);
+
+    /**
+     * @brief Отмечает активность сессии (продлевает таймаут и выставляет бит CLOCK).
+     */
+    void touch_session(uint32_t index) noexcept {
+        QuicSession &session = sessions_[index];
+        session.last_active = now_tick_;
+        session.referenced = true;
+    }
+
+    /**
+     * @brief Переключает путь сессии на новый адрес клиента, если пакет пришёл с другого.
+     *
+     * Адрес и порт меняются вместе, до постановки в очередь следующего ответа;
+     * число смен ограничено max_path_changes за path_change_window.
+     * Новый адрес ничего не доказал: лимит 3x для него считается заново.
+     * @param session Сессия, найденная по CID.
+     * @param client_addr Адрес, с которого пришёл пакет.
+     * @return true, если адрес сменился.
+     */
+    bool update_client_path(QuicSession &session, const sockaddr_in &client_addr) noexcept;
+
+    /**
+     * @brief Учитывает пакет сервера в лимите антиамплификации (RFC 9000 §8).
+     *
+     * Пока адрес клиента не подтверждён, клиенту уходит не больше
+     * AMPLIFICATION_FACTOR байт на каждый принятый от него байт.
+     * @return false, если пакет превышает лимит и должен быть отброшен.
+     */
+    [[nodiscard]] bool charge_amplification_budget(QuicSession &session, size_t n) noexcept;
+
+    /**
+     * @brief Учитывает байты клиента в лимите антиамплификации, пока адрес не подтверждён.
+     */
+    void credit_amplification_budget(QuicSession &session, size_t n) noexcept;
+
+    /**
+     * @brief Выбирает бэкенд сессии по ClientHello из Initial-пакетов клиента.
+     *
+     * Расшифровывает Initial, собирает CRYPTO-фреймы и, когда ClientHello собран,
+     * вызывает options_.route_client_hello. До этого датаграммы задерживаются.
+     * @param index Индекс сессии.
+     * @param header Первый Initial датаграммы (или её первый пакет, если Initial нет).
+     * @param packet Датаграмма целиком.
+     * @return true, если бэкенд выбран и датаграмму нужно переслать; false — она задержана.
+     */
+    [[nodiscard]] bool route_client_hello(uint32_t index, const QuicHeaderView &header,
+                                          std::span<const uint8_t> packet) noexcept;
+
+    /**
+     * @brief Закрепляет бэкенд за сессией и отправляет задержанные датаграммы.
+     * @param index Индекс сессии.
+     * @param backend Индекс в backends_ (вне диапазона — остаётся выбор Maglev).
+     */
+    void pin_session(uint32_t index, size_t backend) noexcept;
+
+    /**
+     * @brief Запоминает CID, выбранный сервером для сессии.
+     * @return true, если CID новый и добавлен в server_cids_.
+     */
+    bool add_server_cid(uint32_t index, const uint8_t *cid, size_t len);
+
+    /**
+     * @brief Удаляет сессию и все её CID из таблиц.
+     */
+    void remove_session(uint32_t index) noexcept;
+
+    /**
+     * @brief Продвигает колесо таймеров и удаляет простаивающие сессии.
+     */
+    void expire_sessions() noexcept;
+
+    /**
+     * @brief Вытесняет одну холодную сессию (алгоритм CLOCK).
+     * @return false, если вытеснять нечего.
+     */
+    bool evict_session() noexcept;
+
+    /**
+     * @brief Оценивает память, занятую сессией вместе с записями в таблицах CID.
+     */
+    [[nodiscard]] static size_t session_footprint(const QuicSession &session) noexcept;
+
+    /**
+     * @brief Пересылает датаграммы клиента в его сокет flow NAT (создаёт поток при первом пакете).
+     * @param data Начало буфера.
+     * @param len Длина буфера.
+     * @param segment_size Размер GRO-сегмента.
+     * @param client_addr Адрес клиента.
+     */
+    void forward_client_flow(const uint8_t *data, size_t len, size_t segment_size,
+                             const sockaddr_in &client_addr) noexcept;
+
+    /**
+     * @brief Вычитывает ответы бэкенда из сокета потока и ставит их в очередь клиенту.
+     * @param fd Сокет потока.
+     */
+    void drain_flow_socket(int fd) noexcept;
+
+    /**
+     * @brief Открывает подключённый к бэкенду сокет для нового клиента.
+     * @return Индекс потока или CidTable::NOT_FOUND при ошибке или достижении max_flows.
+     */
+    [[nodiscard]] uint32_t create_flow(const sockaddr_in &client_addr) noexcept;
+
+    /**
+     * @brief Закрывает сокет потока и удаляет его из таблиц.
+     */
+    void remove_flow(uint32_t index) noexcept;
+
+    /**
+     * @brief Удаляет простаивающие потоки flow NAT.
+     */
+    void expire_flows() noexcept;
+
+    /**
+     * @brief Решает, допустить ли новое соединение с адреса клиента (лимит по префиксу /24).
+     *
+     * Отказ только считается — без логов, чтобы во время всплеска не тратить на него время.
+     */
+    [[nodiscard]] bool admit_new_connection(const sockaddr_in &client_addr) noexcept;
+
+    /**
+     * @brief Проверяет адрес клиента перед пересылкой Long Header пакета (stateless Retry).
+     *
+     * Пакеты известных сессий проходят сразу. Initial без токена или с просроченным/чужим
+     * токеном получает Retry, записанный поверх самого Initial в буфере приёма;
+     * остальные пакеты без подтверждённого адреса отбрасываются.
+     *
+     * @param buf Буфер датаграммы (перезаписывается Retry-пакетом).
+     * @param n Размер датаграммы.
+     * @param header Разобранный заголовок.
+     * @param client_addr Адрес клиента.
+     * @return true, если пакет можно пересылать дальше.
+     */
+    [[nodiscard]] bool validate_client_address(uint8_t *buf, size_t n, const QuicHeaderView &header,
+                                               const sockaddr_in &client_addr) noexcept;
+
+    /**
+     * @brief Отсеивает Long Header клиента до допуска и поиска сессии.
+     *
+     * Отвечает Version Negotiation на неподдерживаемую версию (ответ пишется поверх датаграммы)
+     * и отбрасывает неразборные пакеты, Initial меньше 1200 байт и невозможные Length.
+     * @param buf Датаграмма (может быть перезаписана ответом).
+     * @param n Размер датаграммы.
+     * @param header Заголовок (действителен, только если parsed).
+     * @param parsed Результат разбора заголовка.
+     * @param client_addr Адрес клиента.
+     * @return true, если пакет идёт дальше.
+     */
+    [[nodiscard]] bool filter_client_long_header(uint8_t *buf, size_t n, const QuicHeaderView &header, bool parsed,
+                                                 const sockaddr_in &client_addr) noexcept;
+
+    /**
+     * @brief Пересылает Short Header (1-RTT) пакет клиента в Россию.
+     *
+     * DCID ищется в server_cids_ по каждой известной длине серверных CID
+     * (неизвестный — разбирается как CID QUIC-LB); пакет дальше не разбирается и не копируется.
+     *
+     * @param buf Данные пакета.
+     * @param n Размер пакета.
+     * @param client_addr Адрес клиента (при смене — миграция пути сессии).
+     */
+    void forward_client_short_header(const uint8_t *buf, size_t n, const sockaddr_in &client_addr) noexcept;
+
+    /**
+     * @brief Пересылает Short Header (1-RTT) пакет сервера клиенту.
+     *
+     * DCID ищется в client_cids_ по каждой известной длине CID клиентов.
+     *
+     * @param buf Данные пакета.
+     * @param n Размер пакета.
+     */
+    void forward_backend_short_header(const uint8_t *buf, size_t n) noexcept;
+
     /**
      * @brief Обрабатывает пакет от клиента.
      * @param buf Буфер с данными пакета.
@@ -0,0 +1,98 @@
+// include/http3/timer_wheel.hpp
+/**
+ * @file timer_wheel.hpp
+ * @brief Иерархическое колесо таймеров для сроков жизни сессий.
+ *
+ * Таймеры идентифицируются индексами (например, индексом сессии в слабе) и хранятся
+ * в интрузивных двусвязных списках по слотам: постановка, перепостановка и отмена — O(1).
+ * Четыре уровня по 64 слота покрывают 64^4 тиков; таймеры верхних уровней
+ * переносятся на нижние по мере приближения срока (как в классическом timer wheel ядра Linux).
+ *
+ * @author Telian Edward <telianedward@icloud.com>
+ * @assisted-by AI-Assistant
+ * @date 2025-11-14
+ * @version 1.0
+ * @license MIT
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/**
+ * @brief Иерархическое колесо таймеров над индексами uint32_t.
+ */
+class TimerWheel {
+public:
+    static constexpr uint32_t NONE = UINT32_MAX; ///< Отсутствующий элемент списка
+    static constexpr unsigned LEVELS = 4;        ///< Уровней колеса
+    static constexpr unsigned SLOT_BITS = 6;     ///< log2 слотов на уровне
+    static constexpr unsigned SLOTS = 1U << SLOT_BITS;
+    static constexpr uint64_t MAX_DELAY = (uint64_t{1} << (SLOT_BITS * LEVELS)) - 1; ///< Максимальная задержка в тиках
+
+    /**
+     * @brief Конструктор.
+     * @param start_tick Тик, с которого начинается отсчёт.
+     */
+    explicit TimerWheel(uint64_t start_tick = 0);
+
+    /**
+     * @brief Ставит (или переставляет) таймер.
+     * @param id Идентификатор таймера.
+     * @param deadline_tick Тик срабатывания (в прошлом — сработает на следующем тике;
+     *        дальше MAX_DELAY — ограничивается MAX_DELAY).
+     */
+    void schedule(uint32_t id, uint64_t deadline_tick);
+
+    /**
+     * @brief Отменяет таймер, если он стоит.
+     * @param id Идентификатор таймера.
+     */
+    void cancel(uint32_t id) noexcept;
+
+    /**
+     * @brief Проверяет, стоит ли таймер.
+     */
+    [[nodiscard]] bool scheduled(uint32_t id) const noexcept { return id < nodes_.size() && nodes_[id].slot != NONE; }
+
+    /**
+     * @brief Продвигает колесо до now_tick включительно и вызывает on_expire для сработавших таймеров.
+     *
+     * Сработавший таймер снимается до вызова обработчика, поэтому обработчик
+     * может поставить его снова.
+     *
+     * @param now_tick Текущий тик.
+     * @param on_expire Обработчик сработавшего таймера.
+     * @return Число сработавших таймеров.
+     */
+    size_t advance(uint64_t now_tick, const std::function<void(uint32_t)> &on_expire);
+
+    /**
+     * @brief Возвращает следующий необработанный тик.
+     */
+    [[nodiscard]] uint64_t next_tick() const noexcept { return next_tick_; }
+
+    /**
+     * @brief Возвращает число поставленных таймеров.
+     */
+    [[nodiscard]] size_t size() const noexcept { return size_; }
+
+private:
+    /// Узел интрузивного списка слота
+    struct Node {
+        uint32_t prev = NONE;
+        uint32_t next = NONE;
+        uint32_t slot = NONE;   ///< Индекс слота (уровень * SLOTS + номер) или NONE
+        uint64_t deadline = 0;  ///< Тик срабатывания
+    };
+
+    uint64_t next_tick_;               ///< Следующий тик для обработки
+    size_t size_ = 0;                  ///< Поставленных таймеров
+    std::vector<uint32_t> heads_;      ///< Головы списков слотов (LEVELS * SLOTS)
+    std::vector<Node> nodes_;          ///< Узлы по идентификаторам
+
+    void link(uint32_t id) noexcept;
+    void unlink(uint32_t id) noexcept;
+    void cascade(unsigned level) noexcept;
+};
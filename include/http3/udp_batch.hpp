@@ -0,0 +1,278 @@
+// include/http3/udp_batch.hpp
+/**
+ * @file udp_batch.hpp
+ * @brief Пакетный ввод-вывод UDP через recvmmsg/sendmmsg.
+ *
+ * Объявляет буферы для приёма нескольких датаграмм за один системный вызов
+ * и очередь отправки, которая сбрасывается одним sendmmsg.
+ * Пересылаемые пакеты не копируются: очередь отправки ссылается прямо на буферы приёма.
+ *
+ * Поддерживаются UDP GRO (приём пачки датаграмм одного потока одним «супербуфером»)
+ * и UDP GSO (отправка подряд идущих датаграмм одного размера одному получателю
+ * одним сообщением с UDP_SEGMENT). Границы и размеры сегментов сохраняются.
+ *
+ * @author Telian Edward <telianedward@icloud.com>
+ * @assisted-by AI-Assistant
+ * @date 2025-11-10
+ * @version 1.0
+ * @license MIT
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+/// Максимум сегментов в одном GSO-сообщении (UDP_MAX_SEGMENTS в ядре)
+constexpr size_t UDP_GSO_MAX_SEGMENTS = 64;
+/// Максимальная суммарная полезная нагрузка GSO-сообщения
+constexpr size_t UDP_GSO_MAX_BYTES = 65000;
+/// Размер управляющего буфера под один cmsg UDP_GRO / UDP_SEGMENT
+constexpr size_t UDP_SEGMENT_CMSG_SPACE = CMSG_SPACE(sizeof(int));
+
+/**
+ * @brief Включает UDP GRO на сокете.
+ * @param fd UDP-сокет.
+ * @return true, если ядро поддерживает UDP_GRO.
+ */
+[[nodiscard]] bool enable_udp_gro(int fd) noexcept;
+
+/**
+ * @brief Проверяет, поддерживает ли ядро UDP GSO (UDP_SEGMENT) на сокете.
+ * @param fd UDP-сокет.
+ * @return true, если UDP_SEGMENT доступен.
+ */
+[[nodiscard]] bool udp_gso_supported(int fd) noexcept;
+
+/**
+ * @brief Извлекает размер GRO-сегмента из управляющих данных принятого сообщения.
+ * @param msg Заголовок сообщения после recvmsg.
+ * @return Размер сегмента или 0, если сообщение не склеено GRO.
+ */
+[[nodiscard]] size_t udp_gro_segment_size(const msghdr &msg) noexcept;
+
+/**
+ * @brief Счётчики пакетного ввода-вывода.
+ *
+ * Позволяют оценить, сколько датаграмм приходится на один системный вызов.
+ */
+struct UdpBatchStats {
+    uint64_t rx_packets = 0;  ///< Принято датаграмм (GRO-сегменты считаются по отдельности)
+    uint64_t rx_syscalls = 0; ///< Вызовов recvmmsg
+    uint64_t rx_gro = 0;      ///< Принято GRO-супербуферов (больше одного сегмента)
+    uint64_t tx_packets = 0;  ///< Отправлено датаграмм (GSO-сегменты считаются по отдельности)
+    uint64_t tx_syscalls = 0; ///< Вызовов sendmmsg
+    uint64_t tx_gso = 0;      ///< Отправлено GSO-сообщений (больше одного сегмента)
+
+    /**
+     * @brief Среднее число принятых датаграмм на один recvmmsg.
+     * @return Отношение rx_packets / rx_syscalls (0, если вызовов не было).
+     */
+    [[nodiscard]] double rx_packets_per_syscall() const noexcept;
+
+    /**
+     * @brief Среднее число отправленных датаграмм на один sendmmsg.
+     * @return Отношение tx_packets / tx_syscalls (0, если вызовов не было).
+     */
+    [[nodiscard]] double tx_packets_per_syscall() const noexcept;
+};
+
+/**
+ * @brief Отправляет буфер из датаграмм одинакового размера в подключённый UDP-сокет.
+ *
+ * С GSO — одним sendmsg с UDP_SEGMENT на каждые UDP_GSO_MAX_SEGMENTS сегментов
+ * (не больше UDP_GSO_MAX_BYTES), без него или при отказе ядра — по одной датаграмме.
+ * Последний сегмент может быть короче. Переполнение буфера сокета — потеря остатка.
+ *
+ * @param fd Подключённый UDP-сокет.
+ * @param data Начало буфера.
+ * @param len Длина буфера.
+ * @param segment_size Размер сегмента (0 или len — одна датаграмма).
+ * @param gso Разрешить склейку через UDP_SEGMENT.
+ * @param stats Счётчики отправки.
+ * @return Число отправленных датаграмм.
+ */
+size_t udp_send_segments(int fd, const uint8_t *data, size_t len, size_t segment_size, bool gso,
+                         UdpBatchStats &stats) noexcept;
+
+/**
+ * @brief Набор буферов для приёма до batch_size датаграмм одним recvmmsg.
+ *
+ * Данные остаются валидными до следующего вызова receive().
+ * Если на сокете включён UDP_GRO, буфер может содержать несколько датаграмм
+ * по segment_size() байт (последняя может быть короче).
+ */
+class UdpRecvBatch {
+public:
+    /**
+     * @brief Конструктор.
+     * @param batch_size Максимальное число датаграмм за один вызов.
+     * @param buffer_size Размер буфера под одну датаграмму.
+     */
+    UdpRecvBatch(size_t batch_size, size_t buffer_size);
+
+    UdpRecvBatch(const UdpRecvBatch &) = delete;
+    UdpRecvBatch &operator=(const UdpRecvBatch &) = delete;
+
+    /**
+     * @brief Принимает до batch_size датаграмм из сокета.
+     * @param fd Неблокирующий UDP-сокет.
+     * @param stats Счётчики для обновления.
+     * @return Число принятых буферов (с GRO буфер может содержать несколько датаграмм),
+     *         0 если данных нет, -1 при ошибке (errno сохранён).
+     */
+    [[nodiscard]] int receive(int fd, UdpBatchStats &stats) noexcept;
+
+    /**
+     * @brief Возвращает указатель на данные i-й датаграммы.
+     */
+    [[nodiscard]] uint8_t *data(size_t i) noexcept { return buffers_.data() + i * buffer_size_; }
+
+    /**
+     * @brief Возвращает длину i-й датаграммы.
+     */
+    [[nodiscard]] size_t length(size_t i) const noexcept { return msgs_[i].msg_len; }
+
+    /**
+     * @brief Проверяет, была ли i-я датаграмма обрезана (не поместилась в буфер).
+     */
+    [[nodiscard]] bool truncated(size_t i) const noexcept { return (msgs_[i].msg_hdr.msg_flags & MSG_TRUNC) != 0; }
+
+    /**
+     * @brief Возвращает адрес отправителя i-й датаграммы.
+     */
+    [[nodiscard]] const sockaddr_in &addr(size_t i) const noexcept { return addrs_[i]; }
+
+    /**
+     * @brief Возвращает размер структуры адреса отправителя i-й датаграммы.
+     */
+    [[nodiscard]] socklen_t addr_len(size_t i) const noexcept { return msgs_[i].msg_hdr.msg_namelen; }
+
+    /**
+     * @brief Возвращает размер сегмента i-го буфера.
+     * @return Размер GRO-сегмента либо длину буфера, если GRO его не склеивал.
+     */
+    [[nodiscard]] size_t segment_size(size_t i) const noexcept { return segment_sizes_[i]; }
+
+    /**
+     * @brief Возвращает максимальное число датаграмм за один вызов.
+     */
+    [[nodiscard]] size_t capacity() const noexcept { return batch_size_; }
+
+private:
+    /// Управляющий буфер под cmsg UDP_GRO (выровнен как cmsghdr)
+    struct alignas(cmsghdr) Control {
+        uint8_t data[UDP_SEGMENT_CMSG_SPACE];
+    };
+
+    size_t batch_size_;               ///< Максимальное число датаграмм за вызов
+    size_t buffer_size_;              ///< Размер буфера одной датаграммы
+    std::vector<uint8_t> buffers_;    ///< Непрерывная область под все буферы
+    std::vector<sockaddr_in> addrs_;  ///< Адреса отправителей
+    std::vector<iovec> iovs_;         ///< iovec на каждый буфер
+    std::vector<Control> controls_;   ///< Управляющие данные (размер GRO-сегмента)
+    std::vector<size_t> segment_sizes_; ///< Размер сегмента каждого буфера
+    std::vector<mmsghdr> msgs_;       ///< Заголовки для recvmmsg
+};
+
+/**
+ * @brief Очередь датаграмм, отправляемых одним sendmmsg.
+ *
+ * Хранит только указатели на данные: буферы должны оставаться валидными до flush().
+ * При включённом GSO датаграмма, лежащая в памяти сразу за предыдущей, адресованная
+ * тому же получателю и не длиннее первого сегмента, дописывается к предыдущему
+ * сообщению как ещё один сегмент UDP_SEGMENT.
+ */
+class UdpSendBatch {
+public:
+    /**
+     * @brief Конструктор.
+     * @param batch_size Максимальное число датаграмм в очереди.
+     */
+    explicit UdpSendBatch(size_t batch_size);
+
+    UdpSendBatch(const UdpSendBatch &) = delete;
+    UdpSendBatch &operator=(const UdpSendBatch &) = delete;
+
+    /**
+     * @brief Включает или выключает склейку датаграмм в GSO-сообщения.
+     * @param enabled true — склеивать (сокет должен поддерживать UDP_SEGMENT).
+     */
+    void set_gso(bool enabled) noexcept { gso_ = enabled; }
+
+    /**
+     * @brief Проверяет, включена ли склейка GSO.
+     */
+    [[nodiscard]] bool gso() const noexcept { return gso_; }
+
+    /**
+     * @brief Добавляет датаграмму в очередь.
+     * @param data Указатель на данные (не копируются).
+     * @param len Длина данных.
+     * @param dest Адрес получателя.
+     * @return false, если очередь заполнена.
+     */
+    [[nodiscard]] bool push(const uint8_t *data, size_t len, const sockaddr_in &dest) noexcept;
+
+    /**
+     * @brief Отправляет все датаграммы из очереди и очищает её.
+     * @param fd Неблокирующий UDP-сокет.
+     * @param stats Счётчики для обновления.
+     * @return Число отправленных датаграмм.
+     */
+    size_t flush(int fd, UdpBatchStats &stats) noexcept;
+
+    /**
+     * @brief Возвращает заголовок i-й датаграммы в очереди (для отправки через io_uring).
+     */
+    [[nodiscard]] const msghdr &message(size_t i) const noexcept { return msgs_[i].msg_hdr; }
+
+    /**
+     * @brief Возвращает число датаграмм (сегментов) в i-м сообщении очереди.
+     */
+    [[nodiscard]] size_t segments(size_t i) const noexcept { return entries_[i].segments; }
+
+    /**
+     * @brief Очищает очередь без отправки.
+     */
+    void clear() noexcept { count_ = 0; }
+
+    /**
+     * @brief Возвращает число датаграмм в очереди.
+     */
+    [[nodiscard]] size_t size() const noexcept { return count_; }
+
+    /**
+     * @brief Проверяет, заполнена ли очередь.
+     */
+    [[nodiscard]] bool full() const noexcept { return count_ == batch_size_; }
+
+private:
+    /// Сегментация сообщения и его управляющий буфер под cmsg UDP_SEGMENT
+    struct alignas(cmsghdr) Entry {
+        uint8_t control[UDP_SEGMENT_CMSG_SPACE];
+        size_t segment_size;  ///< Размер сегмента (длина первой датаграммы)
+        size_t segments;      ///< Число датаграмм в сообщении
+    };
+
+    size_t batch_size_;              ///< Ёмкость очереди
+    size_t count_ = 0;               ///< Текущее число сообщений
+    bool gso_ = false;               ///< Склеивать датаграммы через UDP_SEGMENT
+    std::vector<sockaddr_in> addrs_; ///< Адреса получателей
+    std::vector<iovec> iovs_;        ///< iovec на каждое сообщение
+    std::vector<Entry> entries_;     ///< Сегментация сообщений
+    std::vector<mmsghdr> msgs_;      ///< Заголовки для sendmmsg
+
+    /**
+     * @brief Пытается дописать датаграмму к последнему сообщению как GSO-сегмент.
+     * @return true, если датаграмма дописана.
+     */
+    [[nodiscard]] bool try_append_segment(const uint8_t *data, size_t len, const sockaddr_in &dest) noexcept;
+
+    /**
+     * @brief Отправляет сегменты i-го сообщения по одной датаграмме (ядро отклонило GSO).
+     * @return Число отправленных датаграмм.
+     */
+    size_t send_unsegmented(int fd, size_t i, UdpBatchStats &stats) noexcept;
+};
@@ -0,0 +1,172 @@
+// include/http3/uring_reactor.hpp
+/**
+ * @file uring_reactor.hpp
+ * @brief Реактор на io_uring для UDP-сокетов QUIC-прокси.
+ *
+ * Работает напрямую через системные вызовы io_uring_setup/io_uring_enter/io_uring_register
+ * (без liburing). Приём — multishot recvmsg с буферами из зарегистрированного кольца
+ * (IORING_REGISTER_PBUF_RING), отправка — SENDMSG через то же кольцо.
+ * Сокеты регистрируются как fixed files. За одну итерацию цикла выполняется
+ * один io_uring_enter, который одновременно отправляет накопленные SQE и ждёт новые CQE.
+ *
+ * @author Telian Edward <telianedward@icloud.com>
+ * @assisted-by AI-Assistant
+ * @date 2025-11-11
+ * @version 1.0
+ * @license MIT
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <functional>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/io_uring.h>
+
+/**
+ * @brief Принятая через io_uring датаграмма.
+ *
+ * Данные лежат в буфере из кольца и валидны до recycle_buffers().
+ */
+struct UringDatagram {
+    int socket_index;       ///< Индекс сокета в списке, переданном в init()
+    uint8_t *data;          ///< Начало полезной нагрузки
+    size_t len;             ///< Длина полезной нагрузки
+    const sockaddr_in *addr; ///< Адрес отправителя
+    socklen_t addr_len;     ///< Длина адреса отправителя
+    bool truncated;         ///< true, если датаграмма не поместилась в буфер
+    size_t segment_size;    ///< Размер GRO-сегмента (равен len, если буфер не склеен)
+};
+
+/**
+ * @brief Реактор на io_uring: multishot recvmsg + sendmsg через одно кольцо.
+ */
+class UringReactor {
+public:
+    /**
+     * @brief Конструктор.
+     * @param entries Размер очереди отправки (SQ), округляется ядром до степени двойки.
+     * @param buffer_count Число буферов приёма в кольце (степень двойки, не более 32768).
+     * @param payload_size Максимальный размер полезной нагрузки датаграммы (или GRO-буфера).
+     * @param control_size Место под управляющие данные recvmsg (cmsg UDP_GRO), 0 — не принимать.
+     */
+    UringReactor(unsigned entries, unsigned buffer_count, size_t payload_size, size_t control_size = 0);
+
+    /**
+     * @brief Деструктор — освобождает кольцо и буферы.
+     */
+    ~UringReactor();
+
+    UringReactor(const UringReactor &) = delete;
+    UringReactor &operator=(const UringReactor &) = delete;
+
+    /**
+     * @brief Создаёт кольцо, регистрирует сокеты и буферы, запускает multishot-приём.
+     * @param fds Сокеты, с которых нужно принимать датаграммы.
+     * @return true при успехе; false, если ядро не поддерживает нужные возможности (errno сохранён).
+     */
+    [[nodiscard]] bool init(const std::vector<int> &fds) noexcept;
+
+    /**
+     * @brief Ставит sendmsg в очередь отправки (без системного вызова).
+     *
+     * Заголовок и адрес копируются, данные — нет: они должны жить до завершения этой отправки.
+     * Если данные лежат в буфере приёма кольца, буфер не вернётся в кольцо, пока не придёт
+     * CQE этой отправки.
+     *
+     * @param socket_index Индекс сокета в списке init().
+     * @param msg Сообщение для отправки (один iovec, не более одного cmsg UDP_SEGMENT).
+     * @return false, если нет свободного слота отправки.
+     */
+    [[nodiscard]] bool queue_send(int socket_index, const msghdr &msg) noexcept;
+
+    /**
+     * @brief Отправляет накопленные SQE и обрабатывает завершения.
+     *
+     * Выполняет один io_uring_enter: отправка + ожидание хотя бы одного CQE (или таймаута).
+     *
+     * @param timeout_ms Максимальное время ожидания.
+     * @param on_datagram Обработчик принятых датаграмм.
+     * @return Число обработанных CQE или -1 при ошибке.
+     */
+    int run_once(int timeout_ms, const std::function<void(const UringDatagram &)> &on_datagram) noexcept;
+
+    /**
+     * @brief Возвращает в кольцо буферы приёма текущей итерации.
+     *
+     * Вызывается после того, как отправки, ссылающиеся на эти буферы, поставлены в очередь.
+     * Буфер, на который ссылается незавершённая отправка, возвращается по её CQE.
+     */
+    void recycle_buffers() noexcept;
+
+    /**
+     * @brief Число отправок, ещё не получивших CQE.
+     */
+    [[nodiscard]] unsigned sends_in_flight() const noexcept { return sends_in_flight_; }
+
+    /**
+     * @brief Число вызовов io_uring_enter.
+     */
+    [[nodiscard]] uint64_t enter_calls() const noexcept { return enter_calls_; }
+
+private:
+    /// Слот отправки: копия заголовка, адреса и cmsg, живущая до завершения SENDMSG
+    struct SendSlot {
+        msghdr msg;
+        iovec iov;
+        sockaddr_in addr;
+        alignas(cmsghdr) uint8_t control[CMSG_SPACE(sizeof(int))];
+        int32_t buffer = -1; ///< Буфер приёма, из которого отправляются данные (-1 — чужая память)
+    };
+
+    unsigned entries_;        ///< Запрошенный размер SQ
+    unsigned buffer_count_;   ///< Число буферов приёма
+    size_t payload_size_;     ///< Максимальная полезная нагрузка
+    size_t control_size_;     ///< Место под cmsg в буфере приёма
+    size_t buffer_size_;      ///< Размер буфера (заголовок recvmsg_out + адрес + cmsg + данные)
+
+    int ring_fd_ = -1;        ///< Дескриптор io_uring
+    void *sq_ring_ = nullptr; ///< Отображение SQ-кольца
+    void *cq_ring_ = nullptr; ///< Отображение CQ-кольца (может совпадать с sq_ring_)
+    size_t sq_ring_size_ = 0;
+    size_t cq_ring_size_ = 0;
+    io_uring_sqe *sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+
+    unsigned *sq_head_ = nullptr;
+    unsigned *sq_tail_ = nullptr;
+    unsigned *sq_mask_ = nullptr;
+    unsigned *sq_array_ = nullptr;
+    unsigned sq_entries_ = 0;
+    unsigned sq_pending_ = 0;   ///< SQE, ещё не переданные ядру
+
+    unsigned *cq_head_ = nullptr;
+    unsigned *cq_tail_ = nullptr;
+    unsigned *cq_mask_ = nullptr;
+    io_uring_cqe *cqes_ = nullptr;
+
+    io_uring_buf_ring *buf_ring_ = nullptr; ///< Кольцо буферов приёма
+    size_t buf_ring_size_ = 0;
+    uint16_t buf_tail_ = 0;                 ///< Локальная копия хвоста кольца буферов
+    uint8_t *buffers_ = nullptr;            ///< Память буферов приёма
+    std::vector<uint16_t> used_buffers_;    ///< Буферы текущей итерации
+    std::vector<uint16_t> buffer_sends_;    ///< Незавершённых отправок из каждого буфера
+    std::vector<uint8_t> buffer_held_;      ///< Буфер отпущен recycle_buffers(), но ещё читается отправкой
+    std::vector<uint16_t> released_buffers_; ///< Буферы, освобождённые завершением отправок
+
+    std::vector<int> fds_;                  ///< Зарегистрированные сокеты
+    std::vector<bool> rearm_pending_;       ///< Приём остановлен из-за нехватки буферов
+    std::vector<SendSlot> send_slots_;      ///< Слоты отправки
+    std::vector<uint32_t> free_slots_;      ///< Свободные слоты
+    unsigned sends_in_flight_ = 0;          ///< Незавершённые SENDMSG
+    uint64_t enter_calls_ = 0;              ///< Счётчик io_uring_enter
+
+    msghdr recv_template_{};                ///< Шаблон msghdr для multishot recvmsg
+
+    [[nodiscard]] io_uring_sqe *get_sqe() noexcept;
+    void arm_recv(int socket_index) noexcept;
+    void return_buffers(std::vector<uint16_t> &bids) noexcept;
+    [[nodiscard]] int enter(unsigned to_submit, unsigned min_complete, int timeout_ms) noexcept;
+    void release() noexcept;
+};
@@ -49,6 +49,8 @@ int main() {
         // QuicUdpProxy quic_proxy(http3_port, backend_ip, backend_http3_port);
         // TcpProxy tcp_proxy(http2_port, backend_ip, backend_http2_port);
       Http1Server http1_server(http1_port, backend_ip, backend_http1_port); // 👈 Передаём backend_ip и backend_http1_port
+      http1_server.enable_health_check(); // Быстрый отказ, пока туннель до РФ недоступен
+      http1_server.enable_reactors();     // Реактор на каждое ядро: TLS handshake упирался в одно ядро
     //   Http2Server http2_server(http2_port, backend_ip, backend_http1_port); // 👈 Передаём backend_ip и backend_http1_port
 
 
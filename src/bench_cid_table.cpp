@@ -0,0 +1,162 @@
+// src/bench_cid_table.cpp
+/**
+ * @file bench_cid_table.cpp
+ * @brief Микробенчмарк поиска сессии по Connection ID.
+ *
+ * Сравнивает три варианта таблицы CID → индекс сессии на 10k, 100k и 1M сессий:
+ *  - std::unordered_map<std::vector<uint8_t>, ...> с побайтовым VectorHash
+ *    (прежний reverse_map_: на каждый поиск — временный std::vector в куче);
+ *  - std::unordered_map<ConnectionId, ...> (CID по значению, FNV-1a);
+ *  - CidTable (открытая адресация, ключи внутри слотов, поиск по std::span).
+ *
+ * Ключи поиска берутся прямо из «буфера пакетов», как в горячем пути прокси.
+ * Сборка: g++ -std=c++23 -O2 -Iinclude src/bench_cid_table.cpp src/http3/cid_table.cpp -o bench_cid_table
+ *
+ * @author Telian Edward <telianedward@icloud.com>
+ * @assisted-by AI-Assistant
+ * @date 2025-11-13
+ * @version 1.0
+ * @license MIT
+ */
+#include "http3/cid_table.hpp"
+#include "http3/connection_id.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+
+constexpr size_t CID_LEN = 8;             ///< Длина CID (как у большинства серверов)
+constexpr size_t LOOKUPS = 4'000'000;     ///< Поисков на один замер
+
+/// Прежняя хэш-функция reverse_map_
+struct VectorHash {
+    size_t operator()(const std::vector<uint8_t> &v) const noexcept {
+        size_t result = 0;
+        for (uint8_t b : v) {
+            result ^= static_cast<size_t>(b);
+            result *= 2654435761U;
+        }
+        return result;
+    }
+};
+
+struct VectorEqual {
+    bool operator()(const std::vector<uint8_t> &a, const std::vector<uint8_t> &b) const noexcept {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+    }
+};
+
+/// Буфер, имитирующий заголовки принятых пакетов: CID подряд, по CID_LEN байт
+struct PacketBuffer {
+    std::vector<uint8_t> bytes;
+    size_t count = 0;
+
+    [[nodiscard]] const uint8_t *cid(size_t i) const noexcept { return bytes.data() + i * CID_LEN; }
+};
+
+PacketBuffer random_cids(size_t count, std::mt19937_64 &rng)
+{
+    PacketBuffer buf;
+    buf.count = count;
+    buf.bytes.resize(count * CID_LEN);
+    for (size_t i = 0; i < buf.bytes.size(); i += sizeof(uint64_t)) {
+        uint64_t word = rng();
+        std::memcpy(buf.bytes.data() + i, &word, sizeof(word));
+    }
+    return buf;
+}
+
+/// Порядок поиска: случайные индексы сессий (без закономерностей для кэша)
+std::vector<uint32_t> lookup_order(size_t sessions, std::mt19937_64 &rng)
+{
+    std::vector<uint32_t> order(LOOKUPS);
+    std::uniform_int_distribution<uint32_t> dist(0, static_cast<uint32_t>(sessions - 1));
+    for (auto &i : order) {
+        i = dist(rng);
+    }
+    return order;
+}
+
+template <typename Lookup>
+double measure_ns(const PacketBuffer &keys, const std::vector<uint32_t> &order, Lookup &&lookup, uint64_t &checksum)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i : order) {
+        checksum += lookup(keys.cid(i));
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) /
+           static_cast<double>(order.size());
+}
+
+void run(size_t sessions)
+{
+    std::mt19937_64 rng(sessions);
+    const PacketBuffer known = random_cids(sessions, rng);
+    const PacketBuffer unknown = random_cids(sessions, rng);
+    const std::vector<uint32_t> order = lookup_order(sessions, rng);
+    uint64_t checksum = 0;
+
+    // --- Прежний reverse_map_ ---
+    std::unordered_map<std::vector<uint8_t>, uint32_t, VectorHash, VectorEqual> vector_map;
+    vector_map.reserve(sessions);
+    for (size_t i = 0; i < sessions; ++i) {
+        vector_map.emplace(std::vector<uint8_t>(known.cid(i), known.cid(i) + CID_LEN), static_cast<uint32_t>(i));
+    }
+    auto vector_lookup = [&](const uint8_t *cid) -> uint64_t {
+        auto it = vector_map.find(std::vector<uint8_t>(cid, cid + CID_LEN));
+        return it == vector_map.end() ? 0 : it->second;
+    };
+    const double vector_hit = measure_ns(known, order, vector_lookup, checksum);
+    const double vector_miss = measure_ns(unknown, order, vector_lookup, checksum);
+    vector_map = {};
+
+    // --- unordered_map с ConnectionId ---
+    std::unordered_map<ConnectionId, uint32_t, ConnectionIdHash> cid_map;
+    cid_map.reserve(sessions);
+    for (size_t i = 0; i < sessions; ++i) {
+        cid_map.emplace(ConnectionId(known.cid(i), CID_LEN), static_cast<uint32_t>(i));
+    }
+    auto cid_map_lookup = [&](const uint8_t *cid) -> uint64_t {
+        auto it = cid_map.find(ConnectionId(cid, CID_LEN));
+        return it == cid_map.end() ? 0 : it->second;
+    };
+    const double cid_map_hit = measure_ns(known, order, cid_map_lookup, checksum);
+    const double cid_map_miss = measure_ns(unknown, order, cid_map_lookup, checksum);
+    cid_map = {};
+
+    // --- CidTable ---
+    CidTable table(sessions);
+    for (size_t i = 0; i < sessions; ++i) {
+        table.insert({known.cid(i), CID_LEN}, static_cast<uint32_t>(i));
+    }
+    auto table_lookup = [&](const uint8_t *cid) -> uint64_t {
+        uint32_t index = table.find({cid, CID_LEN});
+        return index == CidTable::NOT_FOUND ? 0 : index;
+    };
+    const double table_hit = measure_ns(known, order, table_lookup, checksum);
+    const double table_miss = measure_ns(unknown, order, table_lookup, checksum);
+
+    std::printf("%9zu | %8.1f / %8.1f | %8.1f / %8.1f | %8.1f / %8.1f  (checksum %llu)\n",
+                sessions, vector_hit, vector_miss, cid_map_hit, cid_map_miss, table_hit, table_miss,
+                static_cast<unsigned long long>(checksum));
+}
+
+} // namespace
+
+int main()
+{
+    std::printf("Поиск по CID длиной %zu байт, %zu поисков на замер, нс/поиск (попадание / промах)\n",
+                CID_LEN, LOOKUPS);
+    std::printf(" сессий   | unordered_map<vector> | unordered_map<CID>  | CidTable\n");
+    for (size_t sessions : {10'000UL, 100'000UL, 1'000'000UL}) {
+        run(sessions);
+    }
+    return 0;
+}
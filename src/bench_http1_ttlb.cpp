@@ -0,0 +1,182 @@
+// src/bench_http1_ttlb.cpp
+/**
+ * @file bench_http1_ttlb.cpp
+ * @brief Бенчмарк времени до последнего байта (TTLB) ответа через Http1Server.
+ *
+ * На loopback запускаются бэкенд (HTTP/1.1 без TLS, ответ заданного размера и
+ * Connection: close) и Http1Server с одним реактором. Клиент по TLS отправляет
+ * GET и читает ответ до закрытия соединения; измеряется время от отправки запроса
+ * до последнего байта. Для каждого размера — медиана и худший из нескольких замеров
+ * и пропускная способность по медиане. Запрос, не завершённый за 10 с, считается
+ * зависшим (так вёл себя прокси, который читал бэкенд только по событиям клиента).
+ *
+ * Нужны сертификат и ключ в /opt/quic-proxy/ (как у самого сервера).
+ * Лог сервера подавляется, чтобы мерить пересылку, а не вывод в терминал.
+ *
+ * Сборка: g++ -std=c++23 -O2 -Iinclude src/bench_http1_ttlb.cpp src/http1/server.cpp \
+ *         src/health/backend_health.cpp -lfmt -lssl -lcrypto -pthread -o bench_http1_ttlb
+ *
+ * @author Telian Edward <telianedward@icloud.com>
+ * @assisted-by AI-Assistant
+ * @date 2025-11-20
+ * @version 1.0
+ * @license MIT
+ */
+#include "http1/server.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+constexpr int PROXY_PORT = 18443;    ///< Порт Http1Server
+constexpr int BACKEND_PORT = 18587;  ///< Порт бэкенда
+constexpr int RUNS = 5;              ///< Замеров на размер
+constexpr int FETCH_TIMEOUT_S = 10;  ///< Срок одного запроса
+
+size_t response_size = 0; ///< Размер тела текущего замера (бэкенд читает между запросами)
+
+/// Бэкенд: на каждый запрос — ответ из response_size байт, затем закрытие
+void run_backend(int listen_fd)
+{
+    std::vector<char> body;
+    for (;;)
+    {
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0)
+        {
+            continue;
+        }
+        char buf[4096];
+        std::string request;
+        ssize_t n = 0;
+        while (request.find("\r\n\r\n") == std::string::npos && (n = recv(fd, buf, sizeof(buf), 0)) > 0)
+        {
+            request.append(buf, static_cast<size_t>(n));
+        }
+        const std::string header = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(response_size) +
+                                   "\r\nConnection: close\r\n\r\n";
+        body.assign(response_size, 'x');
+        (void)send(fd, header.data(), header.size(), MSG_NOSIGNAL);
+        for (size_t off = 0; off < body.size();)
+        {
+            ssize_t sent = send(fd, body.data() + off, body.size() - off, MSG_NOSIGNAL);
+            if (sent <= 0)
+            {
+                break;
+            }
+            off += static_cast<size_t>(sent);
+        }
+        ::close(fd);
+    }
+}
+
+/// Один запрос через прокси: TTLB в мс или -1, если ответ не получен целиком
+double fetch(SSL_CTX *ctx, size_t expected)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(PROXY_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    timeval timeout{.tv_sec = FETCH_TIMEOUT_S, .tv_usec = 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0)
+    {
+        ::close(fd);
+        return -1.0;
+    }
+    SSL *ssl = SSL_new(ctx);
+    SSL_set_fd(ssl, fd);
+    double ms = -1.0;
+    if (SSL_connect(ssl) == 1)
+    {
+        const char request[] = "GET / HTTP/1.1\r\nHost: bench\r\n\r\n";
+        auto start = std::chrono::steady_clock::now();
+        if (SSL_write(ssl, request, sizeof(request) - 1) > 0)
+        {
+            static char buf[1 << 16];
+            size_t total = 0;
+            int n = 0;
+            while ((n = SSL_read(ssl, buf, sizeof(buf))) > 0)
+            {
+                total += static_cast<size_t>(n);
+            }
+            if (total >= expected)
+            {
+                ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            }
+        }
+    }
+    SSL_free(ssl);
+    ::close(fd);
+    return ms;
+}
+
+} // namespace
+
+int main()
+{
+    signal(SIGPIPE, SIG_IGN);
+
+    int backend_fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    int opt = 1;
+    setsockopt(backend_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    sockaddr_in backend_addr{};
+    backend_addr.sin_family = AF_INET;
+    backend_addr.sin_port = htons(BACKEND_PORT);
+    backend_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(backend_fd, reinterpret_cast<sockaddr *>(&backend_addr), sizeof(backend_addr)) < 0 ||
+        listen(backend_fd, SOMAXCONN) < 0)
+    {
+        std::perror("backend");
+        return 1;
+    }
+    std::thread(run_backend, backend_fd).detach();
+
+    // Лог сервера — в /dev/null, результаты — в stdout
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDERR_FILENO);
+
+    static Http1Server server(PROXY_PORT, "127.0.0.1", BACKEND_PORT);
+    server.enable_reactors(1, false);
+    std::thread([]() { (void)server.run(); }).detach();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
+    std::printf("TTLB ответа через Http1Server (loopback, TLS, %d замеров)\n", RUNS);
+    std::printf("  размер | медиана, мс | худший, мс | МБ/с по медиане | зависло\n");
+    for (size_t mb : {1, 4, 16, 64})
+    {
+        response_size = mb << 20;
+        std::vector<double> samples;
+        int stalled = 0;
+        for (int i = 0; i < RUNS; ++i)
+        {
+            double ms = fetch(ctx, response_size);
+            if (ms < 0)
+            {
+                ++stalled;
+                continue;
+            }
+            samples.push_back(ms);
+        }
+        if (samples.empty())
+        {
+            std::printf(" %4zu МБ |           — |          — |               — | %d\n", mb, stalled);
+            continue;
+        }
+        std::sort(samples.begin(), samples.end());
+        const double median = samples[samples.size() / 2];
+        std::printf(" %4zu МБ | %11.1f | %10.1f | %15.1f | %d\n", mb, median, samples.back(),
+                    static_cast<double>(mb) * 1000.0 / median, stalled);
+    }
+    SSL_CTX_free(ctx);
+    std::fflush(stdout);
+    _exit(0);
+}
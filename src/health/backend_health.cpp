@@ -0,0 +1,375 @@
+// src/health/backend_health.cpp
+/**
+ * @file backend_health.cpp
+ * @brief Реализация активной проверки бэкендов.
+ *
+ * @author Telian Edward <telianedward@icloud.com>
+ * @assisted-by AI-Assistant
+ * @date 2025-11-20
+ * @version 1.0
+ * @license MIT
+ */
+#include "../../include/health/backend_health.hpp"
+#include "../../include/logger/logger.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <random>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+
+constexpr size_t PROBE_CID_LENGTH = 8;
+
+bool set_nonblocking(int fd) noexcept
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+void put_u64(uint8_t *out, uint64_t value) noexcept
+{
+    for (int i = 7; i >= 0; --i)
+    {
+        out[i] = static_cast<uint8_t>(value);
+        value >>= 8;
+    }
+}
+
+uint64_t get_u64(const uint8_t *in) noexcept
+{
+    uint64_t value = 0;
+    for (int i = 0; i < 8; ++i)
+    {
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+} // namespace
+
+BackendHealthChecker::BackendHealthChecker(std::vector<HealthTarget> targets, const HealthCheckOptions &options)
+    : targets_(std::move(targets)),
+      options_(options),
+      states_(std::make_unique<SharedState[]>(targets_.size())),
+      probes_(targets_.size())
+{
+    std::random_device rd;
+    probe_tag_ = (static_cast<uint64_t>(rd()) << 32) | rd();
+}
+
+BackendHealthChecker::~BackendHealthChecker()
+{
+    stop();
+}
+
+bool BackendHealthChecker::start()
+{
+    if (running_.load() || thread_.joinable())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < targets_.size(); ++i)
+    {
+        ProbeState &probe = probes_[i];
+        probe.addr.sin_family = AF_INET;
+        probe.addr.sin_port = htons(static_cast<uint16_t>(targets_[i].port));
+        if (inet_pton(AF_INET, targets_[i].ip.c_str(), &probe.addr.sin_addr) <= 0)
+        {
+            LOG_ERROR("[ERROR] Некорректный IP проверяемого бэкенда: {}", targets_[i].ip);
+            stop();
+            return false;
+        }
+        if (targets_[i].kind != HealthProbeKind::Udp)
+        {
+            continue;
+        }
+        // Подключённый сокет: ICMP port unreachable возвращается как ECONNREFUSED
+        probe.fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, IPPROTO_UDP);
+        if (probe.fd < 0 || !set_nonblocking(probe.fd) ||
+            connect(probe.fd, reinterpret_cast<const sockaddr *>(&probe.addr), sizeof(probe.addr)) < 0)
+        {
+            LOG_ERROR("[ERROR] Не удалось открыть сокет проверки {}:{}: {}", targets_[i].ip, targets_[i].port,
+                      strerror(errno));
+            stop();
+            return false;
+        }
+    }
+    running_.store(true);
+    thread_ = std::thread([this]() { run(); });
+    LOG_INFO("[INFO] Проверка бэкендов запущена: {} шт., период {} мс, fall={}, rise={}", targets_.size(),
+             options_.interval.count(), options_.fall, options_.rise);
+    return true;
+}
+
+void BackendHealthChecker::stop() noexcept
+{
+    running_.store(false);
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+    for (ProbeState &probe : probes_)
+    {
+        close_probe(probe);
+    }
+}
+
+BackendHealthSnapshot BackendHealthChecker::snapshot(size_t index) const noexcept
+{
+    BackendHealthSnapshot out;
+    if (index >= targets_.size())
+    {
+        out.up = false;
+        return out;
+    }
+    const SharedState &s = states_[index];
+    out.up = s.up.load(std::memory_order_relaxed);
+    out.rtt_us = s.rtt_us.load(std::memory_order_relaxed);
+    out.rtt_last_us = s.rtt_last_us.load(std::memory_order_relaxed);
+    out.loss = static_cast<double>(s.loss_ppm.load(std::memory_order_relaxed)) / 1e6;
+    out.probes = s.probes.load(std::memory_order_relaxed);
+    out.failures = s.failures.load(std::memory_order_relaxed);
+    out.transitions = s.transitions.load(std::memory_order_relaxed);
+    return out;
+}
+
+void BackendHealthChecker::log_stats() const noexcept
+{
+    for (size_t i = 0; i < targets_.size(); ++i)
+    {
+        const BackendHealthSnapshot s = snapshot(i);
+        LOG_INFO("[STATS] health {}:{}: {}, RTT {:.2f} мс (последний {:.2f}), потери {:.1f}%, проб {}, неудач {}, "
+                 "переключений {}",
+                 targets_[i].ip, targets_[i].port, s.up ? "доступен" : "НЕДОСТУПЕН", s.rtt_us / 1000.0,
+                 s.rtt_last_us / 1000.0, s.loss * 100.0, s.probes, s.failures, s.transitions);
+    }
+}
+
+void BackendHealthChecker::run() noexcept
+{
+    auto next_probe = std::chrono::steady_clock::now();
+    auto last_stats = next_probe;
+    std::vector<pollfd> fds;
+    std::vector<size_t> owners;
+    while (running_.load())
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= next_probe)
+        {
+            // Проба без ответа к моменту следующей считается потерянной
+            for (size_t i = 0; i < probes_.size(); ++i)
+            {
+                if (probes_[i].outstanding)
+                {
+                    if (targets_[i].kind == HealthProbeKind::Tcp)
+                    {
+                        close_probe(probes_[i]);
+                    }
+                    record_result(i, false);
+                }
+                send_probe(i);
+            }
+            next_probe += options_.interval;
+            if (next_probe <= now)
+            {
+                next_probe = now + options_.interval;
+            }
+        }
+
+        fds.clear();
+        owners.clear();
+        for (size_t i = 0; i < probes_.size(); ++i)
+        {
+            const ProbeState &probe = probes_[i];
+            if (probe.fd < 0)
+            {
+                continue;
+            }
+            const bool tcp = targets_[i].kind == HealthProbeKind::Tcp;
+            fds.push_back({probe.fd, static_cast<short>(tcp ? POLLOUT : POLLIN), 0});
+            owners.push_back(i);
+        }
+        const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(next_probe - now).count();
+        int ready = poll(fds.data(), fds.size(), static_cast<int>(std::max<int64_t>(wait, 0) + 1));
+        if (ready < 0 && errno != EINTR)
+        {
+            LOG_ERROR("[ERROR] poll проверки бэкендов: {}", strerror(errno));
+        }
+        for (size_t k = 0; ready > 0 && k < fds.size(); ++k)
+        {
+            if (fds[k].revents != 0)
+            {
+                handle_probe_event(owners[k], fds[k].revents);
+            }
+        }
+
+        if (options_.stats_interval.count() > 0 &&
+            std::chrono::steady_clock::now() - last_stats >= options_.stats_interval)
+        {
+            log_stats();
+            last_stats = std::chrono::steady_clock::now();
+        }
+    }
+}
+
+void BackendHealthChecker::send_probe(size_t index) noexcept
+{
+    ProbeState &probe = probes_[index];
+    ++probe.seq;
+    probe.sent_at = std::chrono::steady_clock::now();
+    states_[index].probes.fetch_add(1, std::memory_order_relaxed);
+
+    if (targets_[index].kind == HealthProbeKind::Udp)
+    {
+        // Long Header: версия 0x?a?a?a?a, DCID — метка процесса, SCID — номер пробы
+        uint8_t packet[HEALTH_PROBE_SIZE]{};
+        packet[0] = 0xC0;
+        packet[1] = static_cast<uint8_t>(HEALTH_PROBE_VERSION >> 24);
+        packet[2] = static_cast<uint8_t>(HEALTH_PROBE_VERSION >> 16);
+        packet[3] = static_cast<uint8_t>(HEALTH_PROBE_VERSION >> 8);
+        packet[4] = static_cast<uint8_t>(HEALTH_PROBE_VERSION);
+        packet[5] = PROBE_CID_LENGTH;
+        put_u64(&packet[6], probe_tag_);
+        packet[6 + PROBE_CID_LENGTH] = PROBE_CID_LENGTH;
+        put_u64(&packet[7 + PROBE_CID_LENGTH], probe_tag_ ^ probe.seq);
+        if (send(probe.fd, packet, sizeof(packet), 0) < 0)
+        {
+            // Отказ на отправке (нет маршрута, ранее пришедший ICMP) — неудача без ожидания
+            record_result(index, false);
+            return;
+        }
+        probe.outstanding = true;
+        return;
+    }
+
+    probe.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+    if (probe.fd < 0)
+    {
+        LOG_ERROR("[ERROR] socket для TCP-пробы: {}", strerror(errno));
+        record_result(index, false);
+        return;
+    }
+    if (connect(probe.fd, reinterpret_cast<const sockaddr *>(&probe.addr), sizeof(probe.addr)) == 0)
+    {
+        close_probe(probe);
+        record_result(index, true);
+        return;
+    }
+    if (errno != EINPROGRESS)
+    {
+        close_probe(probe);
+        record_result(index, false);
+        return;
+    }
+    probe.outstanding = true;
+}
+
+void BackendHealthChecker::handle_probe_event(size_t index, short revents) noexcept
+{
+    ProbeState &probe = probes_[index];
+    if (targets_[index].kind == HealthProbeKind::Tcp)
+    {
+        int error = 0;
+        socklen_t len = sizeof(error);
+        if (getsockopt(probe.fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0)
+        {
+            error = errno;
+        }
+        close_probe(probe);
+        record_result(index, error == 0 && (revents & (POLLERR | POLLHUP)) == 0);
+        return;
+    }
+
+    // Вычитываем всё: поздние ответы на прошлые пробы отбрасываются по номеру
+    uint8_t buf[HEALTH_PROBE_SIZE];
+    while (true)
+    {
+        ssize_t n = recv(probe.fd, buf, sizeof(buf), 0);
+        if (n < 0)
+        {
+            if (errno == ECONNREFUSED)
+            {
+                if (probe.outstanding)
+                {
+                    record_result(index, false);
+                }
+                continue;
+            }
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return;
+        }
+        // Version Negotiation: версия 0, DCID — SCID нашей пробы
+        const bool negotiation = n >= 7 + static_cast<ssize_t>(PROBE_CID_LENGTH) && (buf[0] & 0x80) != 0 &&
+                                 buf[1] == 0 && buf[2] == 0 && buf[3] == 0 && buf[4] == 0 &&
+                                 buf[5] == PROBE_CID_LENGTH;
+        if (negotiation && probe.outstanding && get_u64(&buf[6]) == (probe_tag_ ^ probe.seq))
+        {
+            record_result(index, true);
+        }
+    }
+}
+
+void BackendHealthChecker::record_result(size_t index, bool ok) noexcept
+{
+    ProbeState &probe = probes_[index];
+    SharedState &state = states_[index];
+    probe.outstanding = false;
+
+    probe.loss += options_.loss_alpha * ((ok ? 0.0 : 1.0) - probe.loss);
+    state.loss_ppm.store(static_cast<uint32_t>(probe.loss * 1e6), std::memory_order_relaxed);
+    if (ok)
+    {
+        const double sample = static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                                      std::chrono::steady_clock::now() - probe.sent_at)
+                                                      .count());
+        probe.rtt_us = probe.rtt_us == 0.0 ? sample : probe.rtt_us + options_.rtt_alpha * (sample - probe.rtt_us);
+        state.rtt_us.store(static_cast<uint32_t>(probe.rtt_us), std::memory_order_relaxed);
+        state.rtt_last_us.store(static_cast<uint32_t>(sample), std::memory_order_relaxed);
+        ++probe.successes;
+        probe.fails = 0;
+    }
+    else
+    {
+        state.failures.fetch_add(1, std::memory_order_relaxed);
+        ++probe.fails;
+        probe.successes = 0;
+    }
+
+    const bool up = state.up.load(std::memory_order_relaxed);
+    if (up && probe.fails >= std::max(1U, options_.fall))
+    {
+        state.up.store(false, std::memory_order_relaxed);
+        LOG_WARN("[WARN] Бэкенд {}:{} недоступен: {} проб подряд без ответа, потери {:.1f}%", targets_[index].ip,
+                 targets_[index].port, probe.fails, probe.loss * 100.0);
+    }
+    else if (!up && probe.successes >= std::max(1U, options_.rise))
+    {
+        state.up.store(true, std::memory_order_relaxed);
+        LOG_INFO("[INFO] Бэкенд {}:{} снова доступен, RTT {:.2f} мс", targets_[index].ip, targets_[index].port,
+                 probe.rtt_us / 1000.0);
+    }
+    else
+    {
+        return;
+    }
+    state.transitions.fetch_add(1, std::memory_order_relaxed);
+    generation_.fetch_add(1, std::memory_order_release);
+}
+
+void BackendHealthChecker::close_probe(ProbeState &probe) noexcept
+{
+    if (probe.fd >= 0)
+    {
+        ::close(probe.fd);
+        probe.fd = -1;
+    }
+}
@@ -17,6 +17,10 @@
 #include <algorithm>
 #include <sstream>
 #include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <bit>
+#include <climits>
 
 // === Реализация методов класса Http1Server ===
 
@@ -26,6 +30,7 @@ Http1Server::Http1Server(int port, const std::string &backend_ip, int backend_po
       ssl_ctx_(nullptr), // 👈 Затем ssl_ctx_
       epoll_fd_(-1)
 {
+    backends_.push_back({backend_ip_, backend_port_});
 
     // Инициализация OpenSSL 3.0+
     if (OPENSSL_init_ssl(OPENSSL_INIT_LOAD_CONFIG, nullptr) != 1)
@@ -89,6 +94,28 @@ Http1Server::Http1Server(int port, const std::string &backend_ip, int backend_po
     LOG_INFO("[INFO] [server.cpp:113] ✅ SSL-контекст успешно создан и настроен");
 }
 
+Http1Server::Http1Server(const Http1Server &primary, unsigned index)
+    : listen_fd_(-1), port_(primary.port_), backend_ip_(primary.backend_ip_), backend_port_(primary.backend_port_),
+      running_(true),
+      ssl_ctx_(primary.ssl_ctx_),
+      epoll_fd_(-1),
+      backends_(primary.backends_),
+      health_check_(primary.health_check_),
+      health_options_(primary.health_options_),
+      health_(primary.health_),
+      reactors_(1),
+      pin_cpu_(primary.pin_cpu_),
+      reactor_index_(index),
+      client_marks_(primary.client_marks_),
+      backend_marks_(primary.backend_marks_)
+{
+    // SSL_CTX потокобезопасен после настройки; каждый реактор держит свою ссылку
+    if (ssl_ctx_ != nullptr)
+    {
+        SSL_CTX_up_ref(ssl_ctx_);
+    }
+}
+
 Http1Server::~Http1Server()
 {
     // Закрываем epoll
@@ -130,6 +157,87 @@ Http1Server::~Http1Server()
 }
 
 bool Http1Server::run()
+{
+    // Проверка бэкендов TCP-подключениями: новые клиенты сразу уходят на доступный бэкенд
+    if (health_check_)
+    {
+        std::vector<HealthTarget> targets;
+        for (const BackendEndpoint &backend : backends_)
+        {
+            targets.push_back({backend.ip, backend.port, HealthProbeKind::Tcp});
+        }
+        health_ = std::make_shared<BackendHealthChecker>(std::move(targets), health_options_);
+        if (!health_->start())
+        {
+            LOG_ERROR("[ERROR] [server.cpp:209] Проверка бэкендов не запущена — используется основной бэкенд");
+            health_.reset();
+        }
+    }
+
+    // Режим «поток на ядро»: по реактору со своим сокетом SO_REUSEPORT и epoll.
+    // По умолчанию — по числу ядер, разрешённых процессу (taskset, cgroup), как и в pin_to_cpu()
+    unsigned reactor_count = reactors_;
+    if (reactor_count == 0)
+    {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        reactor_count = sched_getaffinity(0, sizeof(allowed), &allowed) == 0
+                            ? static_cast<unsigned>(CPU_COUNT(&allowed))
+                            : std::thread::hardware_concurrency();
+        reactor_count = std::max(1U, reactor_count);
+    }
+    workers_.clear();
+    for (unsigned i = 1; i < reactor_count; ++i)
+    {
+        workers_.push_back(std::unique_ptr<Http1Server>(new Http1Server(*this, i)));
+    }
+
+    // Все сокеты открываются до запуска потоков: ошибка bind() видна сразу
+    bool opened = open_listener();
+    for (size_t i = 0; opened && i < workers_.size(); ++i)
+    {
+        opened = workers_[i]->open_listener();
+    }
+    if (!opened)
+    {
+        workers_.clear();
+        health_.reset();
+        return false;
+    }
+
+    LOG_INFO("[INFO] [server.cpp:209] HTTP/1.1 сервер запущен на порту {} с использованием epoll, реакторов: {}{}",
+             port_, reactor_count, pin_cpu_ ? " (закреплены за ядрами)" : "");
+
+    std::vector<std::thread> threads;
+    threads.reserve(workers_.size());
+    for (auto &worker : workers_)
+    {
+        Http1Server *w = worker.get();
+        threads.emplace_back([w]()
+        {
+            if (!w->serve())
+            {
+                LOG_ERROR("[ERROR] [server.cpp:209] Реактор HTTP/1.1 #{} завершился с ошибкой", w->reactor_index_);
+            }
+        });
+    }
+
+    bool result = serve();
+
+    for (auto &worker : workers_)
+    {
+        worker->stop();
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    workers_.clear();
+    health_.reset();
+    return result;
+}
+
+bool Http1Server::open_listener() noexcept
 {
     // Создаем сокет для прослушивания
     listen_fd_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
@@ -145,12 +253,14 @@ bool Http1Server::run()
     {
         LOG_ERROR("[ERROR] [server.cpp:163] setsockopt SO_REUSEADDR failed: {}", strerror(errno));
         ::close(listen_fd_);
+        listen_fd_ = -1;
         return false;
     }
     if (setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0)
     {
         LOG_ERROR("[ERROR] [server.cpp:168] setsockopt SO_REUSEPORT failed: {}", strerror(errno));
         ::close(listen_fd_);
+        listen_fd_ = -1;
         return false;
     }
 
@@ -159,6 +269,7 @@ bool Http1Server::run()
     {
         LOG_ERROR("[ERROR] [server.cpp:175] Не удалось установить неблокирующий режим для сокета прослушивания");
         ::close(listen_fd_);
+        listen_fd_ = -1;
         return false;
     }
 
@@ -171,6 +282,7 @@ bool Http1Server::run()
     {
         LOG_ERROR("[ERROR] [server.cpp:185] Не удалось привязать сокет к порту {}: {}", port_, strerror(errno));
         ::close(listen_fd_);
+        listen_fd_ = -1;
         return false;
     }
 
@@ -179,6 +291,7 @@ bool Http1Server::run()
     {
         LOG_ERROR("[ERROR] [server.cpp:191] Не удалось начать прослушивание: {}", strerror(errno));
         ::close(listen_fd_);
+        listen_fd_ = -1;
         return false;
     }
 
@@ -188,6 +301,7 @@ bool Http1Server::run()
     {
         LOG_ERROR("[ERROR] [server.cpp:198] Не удалось создать epoll: {}", strerror(errno));
         ::close(listen_fd_);
+        listen_fd_ = -1;
         return false;
     }
 
@@ -197,10 +311,22 @@ bool Http1Server::run()
         LOG_ERROR("[ERROR] [server.cpp:204] Не удалось добавить listen_fd в epoll");
         ::close(listen_fd_);
         ::close(epoll_fd_);
+        listen_fd_ = -1;
+        epoll_fd_ = -1;
         return false;
     }
 
-    LOG_INFO("[INFO] [server.cpp:209] HTTP/1.1 сервер запущен на порту {} с использованием epoll", port_);
+    return true;
+}
+
+bool Http1Server::serve() noexcept
+{
+    if (pin_cpu_)
+    {
+        pin_to_cpu();
+    }
+    last_stats_ = std::chrono::steady_clock::now();
+    io_buffer_ = std::make_unique_for_overwrite<char[]>(HTTP1_IO_BUFFER_SIZE);
 
     // Главный цикл
     while (running_.load())
@@ -235,6 +361,19 @@ bool Http1Server::run()
             }
         }
 
+        // Возобновлённые клиенты, у которых расшифрованные данные остались в SSL: сокет пуст,
+        // epoll о них не сообщит — дочитываем сами
+        for (size_t i = 0; i < resume_reads_.size(); ++i)
+        {
+            const int fd = resume_reads_[i];
+            const FdSlot *slot = fd_slot(fd);
+            if (slot != nullptr && !slot->backend && !slot->read_paused && !slot->detached)
+            {
+                handle_io_events(fd, EPOLLIN);
+            }
+        }
+        resume_reads_.clear();
+
         // Проверка таймаутов
         time_t now = time(nullptr);
         for (auto it = timeouts_.begin(); it != timeouts_.end();)
@@ -242,9 +381,8 @@ bool Http1Server::run()
             if (now - it->second > 60)
             { // Таймаут 60 секунд
                 int client_fd = it->first;
-                ::close(client_fd);
-                connections_.erase(client_fd);
-                timeouts_.erase(it++);
+                ++it;
+                close_connection(client_fd);
                 LOG_INFO("[INFO] [server.cpp:244] TCP-соединение закрыто по таймауту: клиент {}", client_fd);
             }
             else
@@ -252,14 +390,59 @@ bool Http1Server::run()
                 ++it;
             }
         }
+        expire_backend_connects();
+
+        auto stats_now = std::chrono::steady_clock::now();
+        if (stats_now - last_stats_ >= HTTP1_STATS_INTERVAL)
+        {
+            last_stats_ = stats_now;
+            log_stats();
+        }
     }
 
     return true;
 }
 
+void Http1Server::pin_to_cpu() const noexcept
+{
+    // i-й реактор — на i-е ядро из разрешённых процессу (с учётом taskset и cgroup)
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0)
+    {
+        LOG_WARN("[WARN] [server.cpp:209] Не удалось получить список ядер: {}", strerror(errno));
+        return;
+    }
+    int target = static_cast<int>(reactor_index_ % static_cast<unsigned>(CPU_COUNT(&allowed)));
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (!CPU_ISSET(cpu, &allowed) || target-- != 0)
+        {
+            continue;
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (rc != 0)
+        {
+            LOG_WARN("[WARN] [server.cpp:209] Реактор #{} не закреплён за ядром {}: {}", reactor_index_, cpu, strerror(rc));
+        }
+        else
+        {
+            LOG_DEBUG("[DEBUG] [server.cpp:209] Реактор #{} закреплён за ядром {}", reactor_index_, cpu);
+        }
+        return;
+    }
+}
+
 void Http1Server::stop()
 {
     running_.store(false);
+    for (auto &worker : workers_)
+    {
+        worker->stop();
+    }
 }
 
 bool Http1Server::set_nonblocking(int fd) noexcept
@@ -272,8 +455,18 @@ bool Http1Server::set_nonblocking(int fd) noexcept
     return fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
 }
 
-int Http1Server::connect_to_backend() noexcept
+int Http1Server::connect_to_backend(bool &connected) noexcept
 {
+    connected = false;
+    // Недоступные по проверке бэкенды пропускаем сразу, не ожидая таймаута подключения
+    const int index = select_backend();
+    if (index < 0)
+    {
+        LOG_ERROR("[ERROR] [server.cpp:267] ❌ Все бэкенды недоступны по результатам проверки");
+        return -1;
+    }
+    const BackendEndpoint &target = backends_[static_cast<size_t>(index)];
+
     int backend_fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
     if (backend_fd < 0)
     {
@@ -292,10 +485,10 @@ int Http1Server::connect_to_backend() noexcept
     // Устанавливаем адрес сервера
     struct sockaddr_in backend_addr{};
     backend_addr.sin_family = AF_INET;
-    backend_addr.sin_port = htons(backend_port_);
-    if (inet_pton(AF_INET, backend_ip_.c_str(), &backend_addr.sin_addr) <= 0)
+    backend_addr.sin_port = htons(static_cast<uint16_t>(target.port));
+    if (inet_pton(AF_INET, target.ip.c_str(), &backend_addr.sin_addr) <= 0)
     {
-        LOG_ERROR("[ERROR] [server.cpp:282] Не удалось преобразовать IP-адрес сервера: {}", backend_ip_);
+        LOG_ERROR("[ERROR] [server.cpp:282] Не удалось преобразовать IP-адрес сервера: {}", target.ip);
         ::close(backend_fd);
         return -1;
     }
@@ -309,43 +502,350 @@ int Http1Server::connect_to_backend() noexcept
             ::close(backend_fd);
             return -1;
         }
-        LOG_DEBUG("[DEBUG] [server.cpp:294] ⏳ Подключение к бэкенду {}:{} в процессе...", backend_ip_, backend_port_);
+        // Завершение ждём в epoll (EPOLLOUT), не блокируя остальных клиентов реактора
+        LOG_DEBUG("[DEBUG] [server.cpp:294] ⏳ Подключение к бэкенду {}:{} в процессе...", target.ip, target.port);
+    }
+    else
+    {
+        connected = true;
+        LOG_INFO("[INFO] [server.cpp:322] ✅ Подключение к бэкенду {}:{} успешно установлено (мгновенно)", target.ip, target.port);
+    }
+    return backend_fd;
+}
+
+void Http1Server::handle_backend_connect(int backend_fd) noexcept
+{
+    const FdSlot *slot = fd_slot(backend_fd);
+    if (slot == nullptr || !slot->backend)
+    {
+        return;
+    }
+    int client_fd = slot->client_fd;
+    auto it = connections_.find(client_fd);
+    if (it == connections_.end() || it->second.backend_connected)
+    {
+        return;
+    }
+    ConnectionInfo &info = it->second;
 
-        // Ждём завершения подключения
-        fd_set write_fds;
-        FD_ZERO(&write_fds);
-        FD_SET(backend_fd, &write_fds);
-        timeval timeout{.tv_sec = 5, .tv_usec = 0}; // Таймаут 5 секунд
-        int activity = select(backend_fd + 1, nullptr, &write_fds, nullptr, &timeout);
-        if (activity <= 0)
+    // Результат неблокирующего connect() — в SO_ERROR
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if (getsockopt(backend_fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0)
+    {
+        error = errno;
+    }
+    if (error != 0)
+    {
+        ++connect_stats_.failed;
+        LOG_ERROR("[ERROR] [server.cpp:315] ❌ Ошибка подключения к бэкенду (fd={}): {}. Закрываем соединение с клиентом {}", backend_fd, strerror(error), client_fd);
+        close_connection(client_fd);
+        return;
+    }
+
+    // CONNECTED: сокет бэкенда остаётся в epoll — ждём ответ (EPOLLIN), EPOLLOUT взводит очередь
+    struct epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = backend_fd;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, backend_fd, &ev) == -1)
+    {
+        LOG_ERROR("[ERROR] [server.cpp:859] ❌ Не удалось изменить события fd={} в epoll: {}", backend_fd, strerror(errno));
+        close_connection(client_fd);
+        return;
+    }
+    fd_slots_[static_cast<size_t>(backend_fd)].want_write = false;
+    info.backend_connected = true;
+    --connecting_;
+    ++connect_stats_.connected;
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - info.connect_started);
+    const size_t bucket = std::min<size_t>(std::bit_width(static_cast<uint64_t>(elapsed.count())), Http1ConnectStats::BUCKETS - 1);
+    ++connect_stats_.latency[bucket];
+    LOG_INFO("[INFO] [server.cpp:319] ✅ Подключение к бэкенду установлено за {} мс (fd={}, клиент {})", elapsed.count(), backend_fd, client_fd);
+
+    // Отправляем то, что клиент успел прислать, пока шло подключение
+    if (!flush_pending(backend_fd) || (info.client_eof && pending_sends_[backend_fd].empty()))
+    {
+        close_connection(client_fd);
+    }
+}
+bool Http1Server::flush_pending(int fd) noexcept
+{
+    auto queue_it = pending_sends_.find(fd);
+    if (queue_it == pending_sends_.end())
+    {
+        return true;
+    }
+    SSL *target_ssl = get_ssl_for_fd(fd);
+    auto &pending_queue = queue_it->second;
+    while (!pending_queue.empty())
+    {
+        auto &pending = pending_queue.front();
+        const ssize_t bytes_sent = write_some(fd, target_ssl, pending.data.get() + pending.sent, pending.len - pending.sent);
+        if (bytes_sent < 0)
         {
-            LOG_ERROR("[ERROR] [server.cpp:302] ❌ Таймаут подключения к бэкенду {}:{} (errno={})", backend_ip_, backend_port_, errno);
-            ::close(backend_fd);
-            return -1;
+            return false;
+        }
+        pending.sent += static_cast<size_t>(bytes_sent);
+        if (bytes_sent > 0)
+        {
+            refresh_timeout(fd);
+        }
+        if (FdSlot *slot = fd_slot(fd); slot != nullptr)
+        {
+            slot->queued -= static_cast<size_t>(bytes_sent);
+            (slot->backend ? queue_stats_.to_backends : queue_stats_.to_clients) -= static_cast<uint64_t>(bytes_sent);
+        }
+        LOG_DEBUG("[DEBUG] [server.cpp:510] 📈 Отправлено {} байт на fd={}, всего {}/{}", bytes_sent, fd, pending.sent, pending.len);
+        if (pending.sent < pending.len)
+        {
+            LOG_DEBUG("[DEBUG] [server.cpp:500] ⏸️ Буфер отправки fd={} заполнен, в очереди {} блок(ов)", fd, pending_queue.size());
+            break; // Оставляем в очереди до EPOLLOUT
         }
+        pending_queue.pop(); // Успешно отправили всю порцию
+    }
+    update_epoll_interest(fd);
 
-        // Проверяем, успешно ли подключились
-        int error = 0;
-        socklen_t len = sizeof(error);
-        if (getsockopt(backend_fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0)
+    // 🟢 ОЧЕРЕДЬ НЕ ВЫШЕ НИЖНЕЙ ОТМЕТКИ — ВОЗОБНОВЛЯЕМ ЧТЕНИЕ ДРУГОЙ СТОРОНЫ
+    const FdSlot *slot = fd_slot(fd);
+    if (slot != nullptr && slot->queued <= (slot->backend ? backend_marks_ : client_marks_).low)
+    {
+        int source_fd = slot->client_fd;
+        if (slot->backend == false)
         {
-            LOG_ERROR("[ERROR] [server.cpp:310] ❌ Не удалось получить статус подключения: {}", strerror(errno));
-            ::close(backend_fd);
-            return -1;
+            auto it = connections_.find(slot->client_fd);
+            source_fd = it != connections_.end() ? it->second.backend_fd : -1;
         }
-        if (error != 0)
+        const FdSlot *source = fd_slot(source_fd);
+        if (source != nullptr && source->read_paused)
         {
-            LOG_ERROR("[ERROR] [server.cpp:315] ❌ Ошибка подключения к бэкенду {}:{}: {}", backend_ip_, backend_port_, strerror(error));
-            ::close(backend_fd);
-            return -1;
+            set_read_paused(source_fd, false);
         }
-        LOG_INFO("[INFO] [server.cpp:319] ✅ Подключение к бэкенду {}:{} успешно установлено", backend_ip_, backend_port_);
     }
-    else
+    return true;
+}
+
+void Http1Server::update_epoll_interest(int fd, bool force) noexcept
+{
+    FdSlot *slot = fd_slot(fd);
+    if (slot == nullptr || slot->detached)
     {
-        LOG_INFO("[INFO] [server.cpp:322] ✅ Подключение к бэкенду {}:{} успешно установлено (мгновенно)", backend_ip_, backend_port_);
+        return;
     }
-    return backend_fd;
+    auto queue_it = pending_sends_.find(fd);
+    const bool want_write = slot->handshake_write || (queue_it != pending_sends_.end() && !queue_it->second.empty());
+    if (want_write == slot->want_write && !force)
+    {
+        return;
+    }
+    // EPOLLOUT взведён, только пока есть что досылать (или handshake ждёт записи);
+    // EPOLL_CTL_MOD сразу сообщает уже готовый сокет
+    struct epoll_event ev{};
+    ev.events = EPOLLET | (slot->read_paused ? 0U : EPOLLIN) | (want_write ? EPOLLOUT : 0U);
+    ev.data.fd = fd;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev) == -1)
+    {
+        LOG_ERROR("[ERROR] [server.cpp:859] ❌ Не удалось изменить события fd={} в epoll: {}", fd, strerror(errno));
+        return;
+    }
+    slot->want_write = want_write;
+}
+
+void Http1Server::refresh_timeout(int fd) noexcept
+{
+    // Медленный, но живой клиент не должен закрываться по таймауту: любая передача в любую сторону — активность
+    const FdSlot *slot = fd_slot(fd);
+    if (slot == nullptr)
+    {
+        return;
+    }
+    auto it = timeouts_.find(slot->client_fd);
+    if (it != timeouts_.end())
+    {
+        it->second = time(nullptr);
+    }
+}
+
+void Http1Server::await_handshake(int fd, int ssl_error) noexcept
+{
+    FdSlot *slot = fd_slot(fd);
+    if (slot == nullptr)
+    {
+        return;
+    }
+    // SSL_accept повторяется на любом событии клиента — на EPOLLOUT тоже
+    slot->handshake_write = ssl_error == SSL_ERROR_WANT_WRITE;
+    update_epoll_interest(fd);
+}
+
+void Http1Server::set_read_paused(int fd, bool paused) noexcept
+{
+    FdSlot *slot = fd_slot(fd);
+    if (slot == nullptr || slot->read_paused == paused)
+    {
+        return;
+    }
+    slot->read_paused = paused;
+    ++(paused ? queue_stats_.paused : queue_stats_.resumed);
+    LOG_DEBUG("[DEBUG] [server.cpp:610] {} Чтение fd={} {}", paused ? "⏸️" : "▶️", fd, paused ? "остановлено: очередь получателя выше верхней отметки" : "возобновлено");
+    update_epoll_interest(fd, true);
+    if (!paused && !slot->backend)
+    {
+        // Расшифрованные записи в SSL не видны epoll — после возобновления дочитываем их в serve()
+        auto it = connections_.find(fd);
+        if (it != connections_.end() && it->second.ssl != nullptr && SSL_has_pending(it->second.ssl))
+        {
+            resume_reads_.push_back(fd);
+        }
+    }
+}
+
+void Http1Server::drop_queue(int fd) noexcept
+{
+    if (const FdSlot *slot = fd_slot(fd); slot != nullptr)
+    {
+        (slot->backend ? queue_stats_.to_backends : queue_stats_.to_clients) -= slot->queued;
+    }
+    set_fd_slot(fd, {});
+    pending_sends_.erase(fd);
+}
+
+Http1Server::FdSlot *Http1Server::fd_slot(int fd) noexcept
+{
+    if (fd < 0 || static_cast<size_t>(fd) >= fd_slots_.size() || fd_slots_[static_cast<size_t>(fd)].client_fd < 0)
+    {
+        return nullptr;
+    }
+    return &fd_slots_[static_cast<size_t>(fd)];
+}
+
+void Http1Server::set_fd_slot(int fd, const FdSlot &slot) noexcept
+{
+    if (fd < 0)
+    {
+        return;
+    }
+    if (static_cast<size_t>(fd) >= fd_slots_.size())
+    {
+        fd_slots_.resize(static_cast<size_t>(fd) + 1);
+    }
+    fd_slots_[static_cast<size_t>(fd)] = slot;
+}
+
+void Http1Server::close_connection(int client_fd) noexcept
+{
+    auto it = connections_.find(client_fd);
+    if (it != connections_.end())
+    {
+        const ConnectionInfo &info = it->second;
+        if (info.ssl != nullptr)
+        {
+            SSL_free(info.ssl);
+        }
+        if (info.backend_fd >= 0)
+        {
+            if (!info.backend_connected)
+            {
+                --connecting_;
+            }
+            drop_queue(info.backend_fd);
+            ::close(info.backend_fd); // close() сам удаляет сокет из epoll
+        }
+        connections_.erase(it);
+    }
+    drop_queue(client_fd);
+    chunked_complete_.erase(client_fd);
+    timeouts_.erase(client_fd);
+    ssl_connections_.erase(client_fd);
+    ::close(client_fd);
+}
+
+void Http1Server::expire_backend_connects() noexcept
+{
+    if (connecting_ == 0)
+    {
+        return;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    std::vector<int> expired;
+    for (const auto &[client_fd, info] : connections_)
+    {
+        if (!info.backend_connected && now - info.connect_started >= HTTP1_BACKEND_CONNECT_TIMEOUT)
+        {
+            expired.push_back(client_fd);
+        }
+    }
+    for (int client_fd : expired)
+    {
+        ++connect_stats_.timed_out;
+        LOG_ERROR("[ERROR] [server.cpp:302] ❌ Таймаут подключения к бэкенду. Закрываем соединение с клиентом {}", client_fd);
+        close_connection(client_fd);
+    }
+}
+
+void Http1Server::log_stats() const noexcept
+{
+    const Http1ConnectStats &stats = connect_stats_;
+    if (stats.started == 0)
+    {
+        return;
+    }
+    std::string histogram;
+    for (size_t i = 0; i < Http1ConnectStats::BUCKETS; ++i)
+    {
+        if (stats.latency[i] == 0)
+        {
+            continue;
+        }
+        const bool last = i + 1 == Http1ConnectStats::BUCKETS;
+        histogram += " " + std::string(last ? "≥" : "<") + std::to_string(last ? 1U << (i - 1) : 1U << i) + ":" +
+                     std::to_string(stats.latency[i]);
+    }
+    LOG_INFO("[STATS] #{} Бэкенд: начато {}, подключено {}, отказ {}, таймаут {}, в процессе {}, байт до подключения {}; connect(), мс:{}",
+             reactor_index_, stats.started, stats.connected, stats.failed, stats.timed_out, connecting_,
+             stats.early_bytes, histogram.empty() ? " —" : histogram);
+    LOG_INFO("[STATS] #{} Очереди отправки: к клиентам {} байт, к бэкендам {} байт, пик {} байт; чтение остановлено {} раз, возобновлено {}",
+             reactor_index_, queue_stats_.to_clients, queue_stats_.to_backends, queue_stats_.peak, queue_stats_.paused,
+             queue_stats_.resumed);
+}
+
+int Http1Server::select_backend() const noexcept
+{
+    if (!health_)
+    {
+        return 0;
+    }
+    // Основной бэкенд предпочтительнее резервных, пока доступен
+    for (size_t i = 0; i < backends_.size(); ++i)
+    {
+        if (health_->is_up(i))
+        {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+void Http1Server::add_backup_backend(const std::string &ip, int port)
+{
+    backends_.push_back({ip, port});
+}
+
+void Http1Server::enable_health_check(const HealthCheckOptions &options)
+{
+    health_check_ = true;
+    health_options_ = options;
+}
+
+void Http1Server::set_queue_watermarks(const Http1QueueWatermarks &to_client, const Http1QueueWatermarks &to_backend)
+{
+    client_marks_ = to_client;
+    backend_marks_ = to_backend;
+}
+
+void Http1Server::enable_reactors(unsigned count, bool pin_cpu)
+{
+    reactors_ = count;
+    pin_cpu_ = pin_cpu;
 }
 
 void Http1Server::handle_new_connection() noexcept
@@ -379,14 +879,23 @@ void Http1Server::handle_new_connection() noexcept
 
     // 🟢 ОБЪЯВЛЯЕМ backend_fd ВНАЧАЛЕ МЕТОДА
     int backend_fd = -1;
-    // Подключаемся к серверу в России
-    backend_fd = connect_to_backend();
+    // Подключаемся к серверу в России — параллельно с TLS handshake клиента
+    bool backend_connected = false;
+    const auto connect_started = std::chrono::steady_clock::now();
+    ++connect_stats_.started;
+    backend_fd = connect_to_backend(backend_connected);
     if (backend_fd == -1)
     {
+        ++connect_stats_.failed;
         LOG_ERROR("[ERROR] [server.cpp:357] ❌ Не удалось подключиться к серверу в России. Закрываем соединение с клиентом.");
         ::close(client_fd);
         return;
     }
+    if (backend_connected)
+    {
+        ++connect_stats_.connected;
+        ++connect_stats_.latency[0];
+    }
 
     // 🟢 СОЗДАНИЕ SSL-ОБЪЕКТА ДЛЯ TLS-ШИФРОВАНИЯ
     SSL *ssl = SSL_new(ssl_ctx_);
@@ -394,6 +903,7 @@ void Http1Server::handle_new_connection() noexcept
     {
         LOG_ERROR("[ERROR] [server.cpp:364] ❌ Не удалось создать SSL-объект для клиента");
         ::close(client_fd);
+        ::close(backend_fd);
         return;
     }
 
@@ -408,6 +918,8 @@ void Http1Server::handle_new_connection() noexcept
     info.backend_fd = backend_fd;
     info.ssl = ssl;
     info.handshake_done = false; // 👈 Пока не завершён
+    info.backend_connected = backend_connected;
+    info.connect_started = connect_started;
     connections_[client_fd] = info;
 
     // 🟢 ИНИЦИАЛИЗИРУЕМ chunked_complete_ ДЛЯ НОВОГО СОЕДИНЕНИЯ
@@ -416,14 +928,27 @@ void Http1Server::handle_new_connection() noexcept
     // 🟢 УСТАНАВЛИВАЕМ ТАЙМАУТ
     timeouts_[client_fd] = time(nullptr);
 
-    // 🟢 РЕГИСТРИРУЕМ client_fd В epoll
-    if (!add_epoll_event(client_fd, EPOLLIN))
+    if (!backend_connected)
+    {
+        ++connecting_;
+    }
+
+    // 🟢 ОБА СОКЕТА — В ТАБЛИЦУ fd → СОЕДИНЕНИЕ И В epoll
+    // Бэкенд: EPOLLOUT, пока идёт connect() (CONNECTING), затем EPOLLIN — ответ идёт клиенту сразу.
+    // Оба edge-triggered: событие — только новые данные, поэтому forward_data читает до EAGAIN
+    set_fd_slot(client_fd, {client_fd, false, false});
+    set_fd_slot(backend_fd, {client_fd, true, !backend_connected});
+    if (!add_epoll_event(client_fd, EPOLLIN | EPOLLET))
     {
         LOG_ERROR("[ERROR] [server.cpp:387] ❌ Не удалось добавить client_fd в epoll");
-        SSL_free(ssl);
-        connections_.erase(client_fd);
-        timeouts_.erase(client_fd);
-        ::close(client_fd);
+        close_connection(client_fd);
+        return;
+    }
+    if (!add_epoll_event(backend_fd, (backend_connected ? EPOLLIN : EPOLLOUT) | EPOLLET))
+    {
+        LOG_ERROR("[ERROR] [server.cpp:387] ❌ Не удалось добавить backend_fd в epoll");
+        ++connect_stats_.failed;
+        close_connection(client_fd);
         return;
     }
 
@@ -435,15 +960,13 @@ void Http1Server::handle_new_connection() noexcept
         if (ssl_error == SSL_ERROR_WANT_READ || ssl_error == SSL_ERROR_WANT_WRITE)
         {
             LOG_DEBUG("[DEBUG] [server.cpp:397] ⏸️ TLS handshake требует повторной попытки (SSL_ERROR_WANT_READ/WRITE). Соединение оставлено в connections_ для дальнейшей обработки.");
+            await_handshake(client_fd, ssl_error);
             return; // Ждём следующего цикла epoll
         }
         else
         {
             LOG_ERROR("[ERROR] [server.cpp:401] ❌ TLS handshake не удался: {}", ERR_error_string(ERR_get_error(), nullptr));
-            SSL_free(ssl);
-            connections_.erase(client_fd);
-            timeouts_.erase(client_fd);
-            ::close(client_fd);
+            close_connection(client_fd);
             return;
         }
     }
@@ -451,13 +974,20 @@ void Http1Server::handle_new_connection() noexcept
     // 🟢 HANDSHAKE УСПЕШНО ЗАВЕРШЁН
     LOG_INFO("[INFO] [server.cpp:409] ✅ TLS handshake успешно завершён для клиента: {}:{} (fd={})", client_ip_str, client_port_num, client_fd);
     // Обновляем информацию — помечаем handshake как завершённый
-    info.handshake_done = true;
-    connections_[client_fd] = info;
+    connections_[client_fd].handshake_done = true;
     LOG_INFO("[INFO] [server.cpp:414] ✅ TLS-соединение успешно установлено для клиента: {}:{} (fd={})", client_ip_str, client_port_num, client_fd);
 }
 
 void Http1Server::handle_io_events(int fd, uint32_t events_mask) noexcept
 {
+    // 🟣 СОКЕТ БЭКЕНДА — СВОЙ ОБРАБОТЧИК (ответ идёт клиенту сразу, без ожидания событий клиента)
+    const FdSlot *slot = fd_slot(fd);
+    if (slot != nullptr && slot->backend)
+    {
+        handle_backend_events(fd, slot->client_fd, events_mask);
+        return;
+    }
+
     auto it = connections_.find(fd);
     if (it == connections_.end())
     {
@@ -487,18 +1017,24 @@ void Http1Server::handle_io_events(int fd, uint32_t events_mask) noexcept
                 int bytes_read = SSL_read(info.ssl, client_hello, sizeof(client_hello));
                 if (bytes_read > 0)
                 {
-                    // 🟣 ЛОГИРОВАНИЕ ClientHello
-                    LOG_INFO("[INFO] [server.cpp:445] 📋 ClientHello от клиента {}:\n{}", client_fd, std::string(client_hello, bytes_read).substr(0, 512));
+                    // 🟣 Данные приложения сразу за handshake — в очередь бэкенду, а не в лог
+                    LOG_INFO("[INFO] [server.cpp:445] 📋 Первые {} байт от клиента {} поставлены в очередь бэкенду", bytes_read, client_fd);
+                    (void)send_or_queue(info.backend_fd, client_hello, static_cast<size_t>(bytes_read), true);
+                    if (!info.backend_connected)
+                    {
+                        connect_stats_.early_bytes += static_cast<uint64_t>(bytes_read);
+                    }
+                    else if (!flush_pending(info.backend_fd))
+                    {
+                        close_connection(client_fd);
+                        return;
+                    }
+                    // SSL_read завершил handshake — остаток данных дочитываем ниже (нового события не будет)
                 }
                 else if (bytes_read == 0)
                 {
                     LOG_WARN("[WARN] [server.cpp:449] ⚠️ Клиент {} закрыл соединение во время handshake", client_fd);
-                    ssl_connections_.erase(client_fd);
-                    ::close(client_fd);
-                    if (!remove_epoll_event(client_fd))
-                    {
-                        LOG_ERROR("[ERROR] [server.cpp:XXX] ❌ Не удалось удалить fd={} из epoll", client_fd);
-                    }
+                    close_connection(client_fd);
                     return;
                 }
                 else
@@ -507,29 +1043,18 @@ void Http1Server::handle_io_events(int fd, uint32_t events_mask) noexcept
                     if (ssl_error_after_read != SSL_ERROR_WANT_READ && ssl_error_after_read != SSL_ERROR_WANT_WRITE)
                     {
                         LOG_ERROR("[ERROR] [server.cpp:456] ❌ Ошибка чтения ClientHello: {}", ERR_error_string(ERR_get_error(), nullptr));
-                        ssl_connections_.erase(client_fd);
-                        connections_.erase(client_fd);
-                        ::close(client_fd);
-                        if (!remove_epoll_event(client_fd))
-                        {
-                            LOG_ERROR("[ERROR] [server.cpp:435] ❌ Не удалось удалить fd={} из epoll", client_fd);
-                        }
+                        close_connection(client_fd);
                         return;
                     }
+                    LOG_DEBUG("[DEBUG] [server.cpp:462] ⏸️ TLS handshake требует повторной попытки (SSL_ERROR_WANT_READ/WRITE)");
+                    await_handshake(client_fd, ssl_error_after_read);
+                    return; // Ждём следующего цикла
                 }
-                LOG_DEBUG("[DEBUG] [server.cpp:462] ⏸️ TLS handshake требует повторной попытки (SSL_ERROR_WANT_READ/WRITE)");
-                return; // Ждём следующего цикла
             }
             else
             {
                 LOG_ERROR("[ERROR] [server.cpp:467] ❌ TLS handshake не удался: {}", ERR_error_string(ERR_get_error(), nullptr));
-                ssl_connections_.erase(client_fd);
-                connections_.erase(client_fd);
-                ::close(client_fd);
-                if (!remove_epoll_event(client_fd))
-                {
-                    LOG_ERROR("[ERROR] [server.cpp:435] ❌ Не удалось удалить fd={} из epoll", client_fd);
-                }
+                close_connection(client_fd);
                 return;
             }
         }
@@ -537,58 +1062,53 @@ void Http1Server::handle_io_events(int fd, uint32_t events_mask) noexcept
         LOG_INFO("[INFO] [server.cpp:475] ✅ TLS handshake успешно завершён для клиента: {} (fd={})", client_fd, client_fd);
         // Обновляем информацию — помечаем handshake как завершённый
         info.handshake_done = true;
+        await_handshake(client_fd, 0);
+
+        // 🟢 ОТПРАВЛЯЕМ ОТВЕТ БЭКЕНДА, ПРИШЕДШИЙ ДО ЗАВЕРШЕНИЯ HANDSHAKE, И ДОЧИТЫВАЕМ ЗАПРОС,
+        //    ПРИШЕДШИЙ ВМЕСТЕ С ПОСЛЕДНИМ СООБЩЕНИЕМ HANDSHAKE (edge-triggered: повтора события не будет)
+        events_mask |= EPOLLOUT | EPOLLIN;
+    }
+
+    // 🟢 СОКЕТ КЛИЕНТА СНОВА ПРИНИМАЕТ ДАННЫЕ — ДОСЫЛАЕМ ОЧЕРЕДЬ
+    if (events_mask & EPOLLOUT)
+    {
+        if (!flush_pending(client_fd))
+        {
+            close_connection(client_fd);
+            return;
+        }
+        if (info.backend_eof && pending_sends_[client_fd].empty())
+        {
+            LOG_INFO("[INFO] [server.cpp:620] ✅ Очередь клиенту {} отправлена после закрытия бэкенда", client_fd);
+            finish_connection(client_fd);
+            return;
+        }
     }
 
     // 🟢 ПЕРЕДАЧА ДАННЫХ ОТ КЛИЕНТА К СЕРВЕРУ
-    if (events_mask & EPOLLIN)
+    if (events_mask & (EPOLLIN | EPOLLHUP | EPOLLERR))
     {
         LOG_INFO("[INFO] [server.cpp:484] 📥 Получены данные от клиента {} (fd={})", client_fd, client_fd);
         LOG_DEBUG("[DEBUG] [server.cpp:485] 🔄 Начало обработки данных через forward_data: from_fd={}, to_fd={}", client_fd, info.backend_fd);
 
-        // 🟢 СНАЧАЛА ПРОВЕРЯЕМ НЕЗАВЕРШЁННЫЕ ОТПРАВКИ ДЛЯ БЭКЕНДА
-        if (!pending_sends_.empty() && pending_sends_.find(info.backend_fd) != pending_sends_.end() && !pending_sends_[info.backend_fd].empty())
+        // 🟢 ЧИТАЕМ НОВЫЕ ДАННЫЕ ОТ КЛИЕНТА (пока бэкенд подключается — только копим;
+        //    очередь к бэкенду досылается по его EPOLLOUT)
+        bool keep_alive = forward_data(client_fd, info.backend_fd, info.ssl, !info.backend_connected); // 👈 Передаём ssl
+          if (!keep_alive)
         {
-            auto &pending_queue = pending_sends_[info.backend_fd];
-            while (!pending_queue.empty())
+            // 🟡 Запрос вместе с закрытием прочитан за одно событие, а бэкенду ещё не ушёл —
+            //    закрываем после досылки (EPOLLOUT бэкенда), иначе запрос потерялся бы
+            if (!info.backend_connected || !pending_sends_[info.backend_fd].empty())
             {
-                auto &pending = pending_queue.front();
-                if (pending.fd != info.backend_fd)
-                {
-                    pending_queue.pop();
-                    continue;
-                }
-                ssize_t bytes_sent = send(pending.fd, pending.data.get() + pending.sent, pending.len - pending.sent, MSG_NOSIGNAL);
-                if (bytes_sent <= 0)
-                {
-                    if (errno == EAGAIN || errno == EWOULDBLOCK)
-                    {
-                        LOG_WARN("[WARN] [server.cpp:500] ⏸️ Буфер отправки на бэкенд заполнен");
-                        break; // Оставляем в очереди
-                    }
-                    else
-                    {
-                        LOG_ERROR("[ERROR] [server.cpp:504] ❌ send() ошибка при отправке на бэкенд: {}", strerror(errno));
-                        pending_queue.pop();
-                        break;
-                    }
-                }
-                pending.sent += bytes_sent;
-                LOG_DEBUG("[DEBUG] [server.cpp:510] 📈 Отправлено {} байт на бэкенд, всего {}/{}", bytes_sent, pending.sent, pending.len);
-                if (pending.sent >= pending.len)
-                {
-                    pending_queue.pop(); // Успешно отправили всю порцию
-                }
-                else
+                LOG_DEBUG("[DEBUG] [server.cpp:590] ⏸️ Клиент {} закрыл соединение, бэкенду {} ещё не отправлено {} блок(ов)", client_fd, info.backend_fd, pending_sends_[info.backend_fd].size());
+                info.client_eof = true;
+                fd_slots_[static_cast<size_t>(client_fd)].detached = true;
+                if (!remove_epoll_event(client_fd))
                 {
-                    break; // Остались неотправленные данные
+                    close_connection(client_fd);
                 }
+                return;
             }
-        }
-
-        // 🟢 ТЕПЕРЬ ЧИТАЕМ НОВЫЕ ДАННЫЕ ОТ КЛИЕНТА
-        bool keep_alive = forward_data(client_fd, info.backend_fd, info.ssl); // 👈 Передаём ssl
-          if (!keep_alive)
-        {
             // 🟢 Если клиент уже закрыл соединение — не вызываем SSL_shutdown()
             if (SSL_is_init_finished(info.ssl))
             {
@@ -624,74 +1144,65 @@ void Http1Server::handle_io_events(int fd, uint32_t events_mask) noexcept
             {
                 LOG_DEBUG("[DEBUG] [server.cpp:552] ⏸️ SSL не готов к shutdown - пропускаем");
             }
-            // 🟢 Закрываем сокеты
-            ::close(client_fd);
-            ::close(info.backend_fd);
-            connections_.erase(client_fd);
-            timeouts_.erase(client_fd);
-            // 🟢 Освобождаем SSL-объект
-            if (is_ssl && info.ssl)
-            {
-                SSL_free(info.ssl);
-                ssl_connections_.erase(client_fd); // 👈 ДОБАВЛЕНО: удаляем из карты
-            }
-            if (!remove_epoll_event(client_fd))
-            {
-                LOG_ERROR("[ERROR] [server.cpp:435] ❌ Не удалось удалить fd={} из epoll", client_fd);
-            }
-             return;
+            // 🟢 Закрываем сокеты и освобождаем SSL-объект
+            close_connection(client_fd);
+            return;
         }
     }
+}
+
+void Http1Server::handle_backend_events(int backend_fd, int client_fd, uint32_t events_mask) noexcept
+{
+    auto it = connections_.find(client_fd);
+    if (it == connections_.end())
+    {
+        LOG_WARN("[WARN] [server.cpp:423] ⚠️ Сокет бэкенда fd={} без соединения клиента {}", backend_fd, client_fd);
+        return;
+    }
+    ConnectionInfo &info = it->second;
+
+    // 🟡 CONNECTING: EPOLLOUT/EPOLLERR — результат connect()
+    if (!info.backend_connected)
+    {
+        handle_backend_connect(backend_fd);
+        return;
+    }
+
+    // 🟢 СОКЕТ БЭКЕНДА СНОВА ПРИНИМАЕТ ДАННЫЕ — ДОСЫЛАЕМ ЗАПРОС КЛИЕНТА
+    if ((events_mask & EPOLLOUT) && !flush_pending(backend_fd))
+    {
+        close_connection(client_fd);
+        return;
+    }
+    if (info.client_eof && pending_sends_[backend_fd].empty())
+    {
+        LOG_INFO("[INFO] [server.cpp:620] ✅ Запрос клиента {} отправлен бэкенду после закрытия клиентом", client_fd);
+        close_connection(client_fd);
+        return;
+    }
 
     // 🟢 ПЕРЕДАЧА ДАННЫХ ОТ БЭКЕНДА К КЛИЕНТУ
-    if (events_mask & EPOLLIN)
+    if (events_mask & (EPOLLIN | EPOLLHUP | EPOLLERR))
     {
         LOG_INFO("[INFO] [server.cpp:573] 📤 Получены данные от сервера {}", info.backend_fd);
-        // 🔴 ПРОВЕРКА: ЗАВЕРШЁН ЛИ HANDSHAKE?
-        if (info.ssl != nullptr && !info.handshake_done)
-        {
-            LOG_WARN("[WARN] [server.cpp:577] ❗ Нельзя отправлять данные клиенту, пока handshake не завершён. Пропускаем.");
-            return; // Пропускаем эту итерацию, ждём завершения handshake
-        }
-        // 🟢 Передаём данные
-        bool keep_alive = forward_data(info.backend_fd, client_fd, nullptr); // 👈 Передаём nullptr, так как данные от бэкенда не шифруются
+        // 🟢 Передаём данные; до завершения handshake клиенту только копим
+        bool keep_alive = forward_data(info.backend_fd, client_fd, nullptr, !info.handshake_done); // 👈 Передаём nullptr, так как данные от бэкенда не шифруются
         if (!keep_alive)
         {
-            // 🟢 Если клиент уже закрыл соединение — не вызываем SSL_shutdown()
-            if (is_ssl && info.ssl)
+            // 🟢 Ответ клиенту ещё в очереди — закрываем после её отправки (EPOLLOUT клиента)
+            if (!info.handshake_done || !pending_sends_[client_fd].empty())
             {
-                // 🟢 Проверяем, был ли уже вызван SSL_shutdown()
-                int shutdown_state = SSL_get_shutdown(info.ssl);
-                if (shutdown_state & SSL_RECEIVED_SHUTDOWN)
-                {
-                    LOG_DEBUG("[DEBUG] [server.cpp:590] 🟡 Клиент уже закрыл соединение. SSL_shutdown() не требуется.");
-                }
-                else
+                LOG_DEBUG("[DEBUG] [server.cpp:590] ⏸️ Бэкенд {} закрыл соединение, клиенту {} ещё не отправлено {} блок(ов)", info.backend_fd, client_fd, pending_sends_[client_fd].size());
+                info.backend_eof = true;
+                fd_slots_[static_cast<size_t>(info.backend_fd)].detached = true;
+                if (!remove_epoll_event(info.backend_fd))
                 {
-                    LOG_DEBUG("[DEBUG] [server.cpp:593] 🔄 Вызов SSL_shutdown() для клиента {}", client_fd);
-                    int shutdown_result = SSL_shutdown(info.ssl);
-                    if (shutdown_result < 0)
-                    {
-                        LOG_WARN("[WARN] [server.cpp:597] ⚠️ SSL_shutdown() вернул ошибку: {}", ERR_error_string(ERR_get_error(), nullptr));
-                    }
-                    else
-                    {
-                        LOG_INFO("[INFO] [server.cpp:600] ✅ SSL_shutdown() успешно завершён для клиента {}", client_fd);
-                    }
+                    close_connection(client_fd);
                 }
+                return;
             }
-            // 🟢 Закрываем сокеты
-            ::close(client_fd);
-            ::close(info.backend_fd);
-            connections_.erase(client_fd);
-            timeouts_.erase(client_fd);
-            if (is_ssl && info.ssl) {
-               ssl_connections_.erase(client_fd);// 👈 Освобождаем SSL-объект
-            }
-            if (!remove_epoll_event(client_fd)) {
-                LOG_ERROR("[ERROR] [server.cpp:435] ❌ Не удалось удалить fd={} из epoll", client_fd);
-            }
-             return; // 👈 ДОБАВЛЕНО: выходим из метода
+            finish_connection(client_fd);
+            return; // 👈 ДОБАВЛЕНО: выходим из метода
         }
         else
         {
@@ -702,19 +1213,8 @@ void Http1Server::handle_io_events(int fd, uint32_t events_mask) noexcept
                 {
                     // 🟢 Чанки завершены — можно закрыть соединение
                     LOG_INFO("[INFO] [server.cpp:620] ✅ Все чанки отправлены. Закрываем соединение для клиента {}", client_fd);
-                    ::close(client_fd);
-                    ::close(info.backend_fd);
-                    connections_.erase(client_fd);
-                    timeouts_.erase(client_fd);
-                    if (is_ssl && info.ssl)
-                    {
-                        ssl_connections_.erase(client_fd); // 👈 Освобождаем SSL-объект
-                    }
-                    if (!remove_epoll_event(client_fd))
-                    {
-                        LOG_ERROR("[ERROR] [server.cpp:XXX] ❌ Не удалось удалить fd={} из epoll", client_fd);
-                    }
-                     return; // 👈 ДОБАВЛЕНО: выходим из метода
+                    close_connection(client_fd);
+                    return; // 👈 ДОБАВЛЕНО: выходим из метода
                 }
                 else
                 {
@@ -732,268 +1232,241 @@ void Http1Server::handle_io_events(int fd, uint32_t events_mask) noexcept
     }
 }
 
-SSL *Http1Server::get_ssl_for_fd(int fd) noexcept
+void Http1Server::finish_connection(int client_fd) noexcept
 {
-    for (const auto &conn : connections_)
+    auto it = connections_.find(client_fd);
+    if (it == connections_.end())
     {
-        if (conn.first == fd)
+        close_connection(client_fd);
+        return;
+    }
+    ConnectionInfo &info = it->second;
+    const bool is_ssl = info.ssl != nullptr;
+    // 🟢 Если клиент уже закрыл соединение — не вызываем SSL_shutdown()
+    if (is_ssl && info.ssl)
+    {
+        // 🟢 Проверяем, был ли уже вызван SSL_shutdown()
+        int shutdown_state = SSL_get_shutdown(info.ssl);
+        if (shutdown_state & SSL_RECEIVED_SHUTDOWN)
+        {
+            LOG_DEBUG("[DEBUG] [server.cpp:590] 🟡 Клиент уже закрыл соединение. SSL_shutdown() не требуется.");
+        }
+        else
         {
-            // Проверяем, что SSL-объект существует
-            if (conn.second.ssl != nullptr)
+            LOG_DEBUG("[DEBUG] [server.cpp:593] 🔄 Вызов SSL_shutdown() для клиента {}", client_fd);
+            int shutdown_result = SSL_shutdown(info.ssl);
+            if (shutdown_result < 0)
             {
-                return conn.second.ssl;
+                LOG_WARN("[WARN] [server.cpp:597] ⚠️ SSL_shutdown() вернул ошибку: {}", ERR_error_string(ERR_get_error(), nullptr));
             }
             else
             {
-                LOG_WARN("[WARN] [server.cpp:648] ⚠️ Найден fd={}, но SSL-объект равен nullptr", fd);
-                return nullptr;
+                LOG_INFO("[INFO] [server.cpp:600] ✅ SSL_shutdown() успешно завершён для клиента {}", client_fd);
             }
         }
     }
-    return nullptr;
+    // 🟢 Закрываем сокеты и освобождаем SSL-объект
+    close_connection(client_fd);
 }
 
-bool Http1Server::forward_data(int from_fd, int to_fd, SSL *ssl) noexcept
+SSL *Http1Server::get_ssl_for_fd(int fd) noexcept
 {
-    LOG_DEBUG("[DEBUG] [server.cpp:657] 🔄 Начало forward_data(from_fd={}, to_fd={}, ssl={})", from_fd, to_fd, ssl ? "true" : "false");
+    // Сокеты бэкендов не ключи connections_ — для них nullptr
+    auto it = connections_.find(fd);
+    return it != connections_.end() ? it->second.ssl : nullptr;
+}
 
-    // 🟡 ЧТЕНИЕ ДАННЫХ
-    char buffer[8192];
-    bool use_ssl = (ssl != nullptr);
-    ssize_t bytes_read = 0;
+bool Http1Server::forward_data(int from_fd, int to_fd, SSL *ssl, bool hold) noexcept
+{
+    LOG_DEBUG("[DEBUG] [server.cpp:657] 🔄 Начало forward_data(from_fd={}, to_fd={}, ssl={})", from_fd, to_fd, ssl ? "true" : "false");
 
-    if (use_ssl)
+    // 🟡 EDGE-TRIGGERED: следующее событие придёт только с новыми данными — читаем источник до EAGAIN
+    char *buffer = io_buffer_.get();
+    for (;;)
     {
-        LOG_INFO("[INFO] [server.cpp:665] [READ] 🔐 Попытка чтения через SSL из fd={}", from_fd);
-        bytes_read = SSL_read(ssl, buffer, sizeof(buffer));
-        if (bytes_read < 0)
+        bool eof = false;
+        const size_t bytes_read = read_source(from_fd, ssl, buffer, HTTP1_IO_BUFFER_SIZE, eof);
+        if (bytes_read > 0)
         {
-            int ssl_error = SSL_get_error(ssl, bytes_read);
-            if (ssl_error == SSL_ERROR_WANT_READ || ssl_error == SSL_ERROR_WANT_WRITE)
+            LOG_INFO("[INFO] [server.cpp:738] ✅ Получено {} байт данных от {} (fd={})", bytes_read, ssl != nullptr ? "клиента" : "сервера", from_fd);
+            refresh_timeout(from_fd);
+            if (hold && ssl != nullptr)
             {
-                LOG_WARN("[WARN] [server.cpp:671] [READ] ⏳ SSL_ERROR_WANT_READ/WRITE — повторная попытка позже");
-                return true;
+                connect_stats_.early_bytes += static_cast<uint64_t>(bytes_read); // От клиента, бэкенд ещё подключается
             }
-            else if (ssl_error == SSL_ERROR_ZERO_RETURN)
+            if (!send_or_queue(to_fd, buffer, bytes_read, hold))
             {
-                LOG_INFO("[INFO] [server.cpp:675] [READ] ✅ Клиент корректно закрыл соединение (SSL_ERROR_ZERO_RETURN)");
                 return false;
             }
-            else
+            // 🟡 ПОЛУЧАТЕЛЬ НЕ УСПЕВАЕТ — ОСТАВЛЯЕМ ДАННЫЕ В СОКЕТЕ ИСТОЧНИКА (TCP притормозит отправителя)
+            const FdSlot *target = fd_slot(to_fd);
+            if (!eof && target != nullptr && target->queued > (target->backend ? backend_marks_ : client_marks_).high)
             {
-                LOG_ERROR("[ERROR] [server.cpp:679] [READ] ❌ Фатальная ошибка SSL: {}", ERR_error_string(ERR_get_error(), nullptr));
-                return false;
+                set_read_paused(from_fd, true);
+                return true;
             }
         }
-        else if (bytes_read == 0)
+        if (eof)
         {
-            LOG_WARN("[WARN] [server.cpp:684] [READ] ⚠️ SSL_read вернул 0 — возможно, соединение закрыто.");
             return false;
         }
-        else
+        if (bytes_read < HTTP1_IO_BUFFER_SIZE)
         {
-            LOG_INFO("[INFO] [server.cpp:688] [READ] ✅ Прочитано {} байт через SSL", bytes_read);
+            // Источник опустошён (буфер заполнен — возможно, данные ещё есть: читаем дальше)
+            LOG_DEBUG("[DEBUG] [server.cpp:849] 🔄 Конец forward_data — соединение остаётся активным");
+            return true;
         }
     }
-    else
+}
+
+size_t Http1Server::read_source(int fd, SSL *ssl, char *buffer, size_t len, bool &eof) noexcept
+{
+    size_t filled = 0;
+    while (filled < len)
     {
-        LOG_INFO("[INFO] [server.cpp:692] [READ] 📥 Попытка чтения через recv из fd={}", from_fd);
-        bytes_read = recv(from_fd, buffer, sizeof(buffer), 0);
-        if (bytes_read < 0)
+        if (ssl != nullptr)
         {
-            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            // SSL_read сначала отдаёт уже расшифрованные записи (SSL_pending), и только потом читает сокет,
+            // поэтому SSL_ERROR_WANT_READ означает, что опустошены и SSL, и сокет
+            const int bytes_read = SSL_read(ssl, buffer + filled, static_cast<int>(len - filled));
+            if (bytes_read > 0)
             {
-                LOG_WARN("[WARN] [server.cpp:697] [READ] ⏳ recv() вернул EAGAIN/EWOULDBLOCK — буфер пуст");
-                return true;
+                filled += static_cast<size_t>(bytes_read);
+                continue;
+            }
+            const int ssl_error = SSL_get_error(ssl, bytes_read);
+            if (ssl_error == SSL_ERROR_WANT_READ || ssl_error == SSL_ERROR_WANT_WRITE)
+            {
+                break;
+            }
+            if (ssl_error == SSL_ERROR_ZERO_RETURN)
+            {
+                LOG_INFO("[INFO] [server.cpp:675] [READ] ✅ Клиент корректно закрыл соединение (SSL_ERROR_ZERO_RETURN)");
             }
             else
             {
-                LOG_ERROR("[ERROR] [server.cpp:701] [READ] ❌ recv ошибка: {} (errno={})", strerror(errno), errno);
-                return false;
+                LOG_ERROR("[ERROR] [server.cpp:679] [READ] ❌ Фатальная ошибка SSL: {}", ERR_error_string(ERR_get_error(), nullptr));
             }
+            eof = true;
+            break;
         }
-        else if (bytes_read == 0)
+
+        const ssize_t bytes_read = recv(fd, buffer + filled, len - filled, 0);
+        if (bytes_read > 0)
         {
-            LOG_WARN("[WARN] [server.cpp:706] [READ] ⚠️ recv вернул 0 — соединение закрыто.");
-            return false;
+            filled += static_cast<size_t>(bytes_read);
+            continue;
+        }
+        if (bytes_read < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (bytes_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            break;
+        }
+        if (bytes_read == 0)
+        {
+            LOG_INFO("[INFO] [server.cpp:706] [READ] ✅ recv вернул 0 — соединение закрыто (fd={})", fd);
         }
         else
         {
-            LOG_INFO("[INFO] [server.cpp:710] [READ] ✅ Прочитано {} байт через recv", bytes_read);
+            LOG_ERROR("[ERROR] [server.cpp:701] [READ] ❌ recv ошибка: {} (errno={})", strerror(errno), errno);
         }
+        eof = true;
+        break;
     }
+    return filled;
+}
 
-    if (bytes_read <= 0)
+ssize_t Http1Server::write_some(int fd, SSL *ssl, const char *data, size_t len) noexcept
+{
+    size_t written = 0;
+    while (written < len)
     {
-        LOG_DEBUG("[DEBUG] [server.cpp:715] [READ] 🛑 Обработка ошибки чтения или закрытия соединения");
-        if (use_ssl)
+        ssize_t bytes_sent = 0;
+        if (ssl != nullptr)
         {
-            int ssl_error = SSL_get_error(ssl, bytes_read);
-            if (ssl_error == SSL_ERROR_WANT_READ || ssl_error == SSL_ERROR_WANT_WRITE)
-            {
-                LOG_WARN("[WARN] [server.cpp:720] [READ] ⏳ SSL_ERROR_WANT_READ/WRITE — повторная попытка позже");
-                return true;
-            }
-            else
-            {
-                LOG_ERROR("[ERROR] [server.cpp:724] [READ] ❌ Фатальная ошибка SSL: {}", ERR_error_string(ERR_get_error(), nullptr));
-                return false;
-            }
+            // SSL_MODE_ENABLE_PARTIAL_WRITE: возвращает число байт в уже отправленных записях
+            bytes_sent = SSL_write(ssl, data + written, static_cast<int>(std::min<size_t>(len - written, INT_MAX)));
         }
         else
         {
-            if (errno == EAGAIN || errno == EWOULDBLOCK)
-            {
-                LOG_WARN("[WARN] [server.cpp:729] [READ] ⏳ recv() вернул EAGAIN/EWOULDBLOCK — буфер пуст");
-                return true;
-            }
-            else
-            {
-                LOG_ERROR("[ERROR] [server.cpp:733] [READ] ❌ Фатальная ошибка recv(): {}", strerror(errno));
-                return false;
-            }
+            bytes_sent = send(fd, data + written, len - written, MSG_NOSIGNAL);
         }
-    }
-
-    LOG_INFO("[INFO] [server.cpp:738] ✅ Получено {} байт данных от {} (fd={})", bytes_read, use_ssl ? "клиента" : "сервера", from_fd);
-
-    // 🟢 ПРОСТАЯ ПЕРЕДАЧА ДАННЫХ БЕЗ CHUNKED PROCESSING
-    SSL *target_ssl = get_ssl_for_fd(to_fd);
-    LOG_DEBUG("[DEBUG] [server.cpp:743] [WRITE] 🎯 Целевой fd={} имеет SSL? {}", to_fd, target_ssl ? "да" : "нет");
-
-    // 🟢 ПРОВЕРКА: ЕСТЬ ЛИ НЕЗАВЕРШЁННЫЕ ОТПРАВКИ?
-    if (!pending_sends_.empty() && pending_sends_.find(to_fd) != pending_sends_.end() && !pending_sends_[to_fd].empty())
-    {
-        LOG_INFO("[INFO] [server.cpp:748] [PENDING] 🕒 Есть незавершённые отправки для fd={}", to_fd);
-        auto &pending_queue = pending_sends_[to_fd];
-        while (!pending_queue.empty())
+        if (bytes_sent > 0)
         {
-            auto &pending = pending_queue.front();
-            if (pending.fd != to_fd)
-            {
-                LOG_WARN("[WARN] [server.cpp:753] [PENDING] 🗑️ Некорректный fd в очереди — пропускаем элемент");
-                pending_queue.pop();
-                continue;
-            }
-            // 🟠 ПОПЫТКА ОТПРАВИТЬ ОСТАВШИЕСЯ ДАННЫЕ
-            LOG_DEBUG("[DEBUG] [server.cpp:758] [PENDING] 📤 Отправка оставшихся {} байт из {} (уже отправлено {})", pending.len - pending.sent, pending.len, pending.sent);
-            ssize_t bytes_sent = 0;
-            if (target_ssl != nullptr)
-            {
-                LOG_INFO("[INFO] [server.cpp:762] [PENDING] 🔐 SSL_write для fd={}", to_fd);
-                bytes_sent = SSL_write(target_ssl, pending.data.get() + pending.sent, pending.len - pending.sent);
-            }
-            else
-            {
-                LOG_INFO("[INFO] [server.cpp:766] [PENDING] 📤 send() для fd={}", to_fd);
-                bytes_sent = send(to_fd, pending.data.get() + pending.sent, pending.len - pending.sent, MSG_NOSIGNAL);
-            }
-            if (bytes_sent <= 0)
-            {
-                if (target_ssl != nullptr)
-                {
-                    int ssl_error = SSL_get_error(target_ssl, bytes_sent);
-                    if (ssl_error == SSL_ERROR_WANT_READ || ssl_error == SSL_ERROR_WANT_WRITE)
-                    {
-                        LOG_WARN("[WARN] [server.cpp:773] [PENDING] ⏳ SSL_write требует повторной попытки — оставляем в очереди");
-                        return true; // Оставляем в очереди
-                    }
-                    else
-                    {
-                        LOG_ERROR("[ERROR] [server.cpp:777] [PENDING] ❌ SSL_write фатальная ошибка: {}", ERR_error_string(ERR_get_error(), nullptr));
-                        pending_queue.pop(); // Удаляем из очереди при фатальной ошибке
-                        return false;
-                    }
-                }
-                else
-                {
-                    if (errno == EAGAIN || errno == EWOULDBLOCK)
-                    {
-                        LOG_WARN("[WARN] [server.cpp:783] [PENDING] ⏳ send() вернул EAGAIN/EWOULDBLOCK — буфер заполнен");
-                        return true;
-                    }
-                    else
-                    {
-                        LOG_ERROR("[ERROR] [server.cpp:787] [PENDING] ❌ send() фатальная ошибка: {}", strerror(errno));
-                        pending_queue.pop();
-                        return false;
-                    }
-                }
-            }
-            pending.sent += static_cast<size_t>(bytes_sent);
-            LOG_DEBUG("[DEBUG] [server.cpp:793] [PENDING] 📈 Отправлено {} байт, всего {}/{}", bytes_sent, pending.sent, pending.len);
-            if (pending.sent >= pending.len)
-            {
-                LOG_SUCCESS("[SUCCESS] [server.cpp:796] ✅ Полностью отправлена порция данных ({} байт)", pending.len);
-                pending_queue.pop(); // Успешно отправили всю порцию
-            }
-            else
-            {
-                LOG_INFO("[INFO] [server.cpp:800] [PENDING] 📥 Остались неотправленные данные: {} байт", pending.len - pending.sent);
-                return true; // Остались неотправленные данные
-            }
+            written += static_cast<size_t>(bytes_sent);
+            continue;
         }
+        if (ssl == nullptr && bytes_sent < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        bool retry = bytes_sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        if (ssl != nullptr)
+        {
+            const int ssl_error = SSL_get_error(ssl, static_cast<int>(bytes_sent));
+            retry = ssl_error == SSL_ERROR_WANT_WRITE || ssl_error == SSL_ERROR_WANT_READ;
+        }
+        if (!retry)
+        {
+            LOG_ERROR("[ERROR] [server.cpp:504] ❌ Ошибка отправки на fd={}: {}", fd,
+                      ssl != nullptr ? ERR_error_string(ERR_get_error(), nullptr) : strerror(errno));
+            return -1;
+        }
+        break; // Буфер отправки заполнен — остаток досылается по EPOLLOUT
     }
+    return static_cast<ssize_t>(written);
+}
 
-    // 🟢 ЗАПИСЬ НОВЫХ ДАННЫХ
-    LOG_INFO("[INFO] [server.cpp:806] [NEW] 🆕 Создаём новый элемент для отправки {} байт на fd={}", bytes_read, to_fd);
-    PendingSend new_send;
-    new_send.fd = to_fd;
-    new_send.len = static_cast<size_t>(bytes_read);
-    new_send.sent = 0;
-    new_send.data = std::make_unique<char[]>(new_send.len);
-    std::memcpy(new_send.data.get(), buffer, new_send.len);
-
-    // Пытаемся отправить сразу
-    LOG_INFO("[INFO] [server.cpp:815] [NEW] 📤 Попытка немедленной отправки {} байт на fd={}", new_send.len, to_fd);
-    ssize_t bytes_sent = 0;
-    if (target_ssl != nullptr)
-    {
-        LOG_INFO("[INFO] [server.cpp:819] [NEW] 🔐 SSL_write для нового блока на fd={}", to_fd);
-        bytes_sent = SSL_write(target_ssl, new_send.data.get(), new_send.len);
-    }
-    else
-    {
-        LOG_INFO("[INFO] [server.cpp:823] [NEW] 📤 send() для нового блока на fd={}", to_fd);
-        bytes_sent = send(to_fd, new_send.data.get(), new_send.len, MSG_NOSIGNAL);
-    }
-
-    if (bytes_sent <= 0)
+bool Http1Server::send_or_queue(int to_fd, const char *data, size_t len, bool hold) noexcept
+{
+    auto &pending_queue = pending_sends_[to_fd];
+    FdSlot *slot = fd_slot(to_fd);
+    if (!hold)
     {
-        if (target_ssl != nullptr)
+        // 🟢 Очередь, накопленная до готовности получателя (EPOLLOUT ещё не взведён), уходит первой
+        if (!pending_queue.empty() && slot != nullptr && !slot->want_write && !flush_pending(to_fd))
         {
-            int ssl_error = SSL_get_error(target_ssl, bytes_sent);
-            if (ssl_error == SSL_ERROR_WANT_READ || ssl_error == SSL_ERROR_WANT_WRITE)
-            {
-                LOG_WARN("[WARN] [server.cpp:830] [NEW] ⏳ SSL_write требует повторной попытки — добавляем в очередь");
-                pending_sends_[to_fd].push(std::move(new_send));
-                return true;
-            }
-            else
-            {
-                LOG_ERROR("[ERROR] [server.cpp:834] [NEW] ❌ SSL_write фатальная ошибка: {}", ERR_error_string(ERR_get_error(), nullptr));
-                return false;
-            }
+            return false;
         }
-        else
+        // 🟢 Очереди нет — пишем прямо из буфера чтения, без копирования
+        if (pending_queue.empty())
         {
-            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            const ssize_t bytes_sent = write_some(to_fd, get_ssl_for_fd(to_fd), data, len);
+            if (bytes_sent < 0)
             {
-                LOG_WARN("[WARN] [server.cpp:839] [NEW] ⏳ send() вернул EAGAIN/EWOULDBLOCK — буфер заполнен");
-                pending_sends_[to_fd].push(std::move(new_send));
-                return true;
+                return false;
             }
-            else
+            data += bytes_sent;
+            len -= static_cast<size_t>(bytes_sent);
+            if (len == 0)
             {
-                LOG_ERROR("[ERROR] [server.cpp:843] [NEW] ❌ send() фатальная ошибка: {}", strerror(errno));
-                return false;
+                return true;
             }
         }
     }
 
-    // Успешно отправили всё сразу
-    LOG_SUCCESS("[SUCCESS] [server.cpp:848] 🎉 Успешно передано {} байт от {} к {}", bytes_read, from_fd, to_fd);
-    LOG_DEBUG("[DEBUG] [server.cpp:849] 🔄 Конец forward_data — соединение остаётся активным");
+    // 🟡 НЕОТПРАВЛЕННЫЙ ОСТАТОК — В ОЧЕРЕДЬ, ДОСЫЛКА ПО EPOLLOUT
+    PendingSend rest;
+    rest.fd = to_fd;
+    rest.len = len;
+    rest.sent = 0;
+    rest.data = std::make_unique_for_overwrite<char[]>(len);
+    std::memcpy(rest.data.get(), data, len);
+    pending_queue.push(std::move(rest));
+    if (slot != nullptr)
+    {
+        slot->queued += len;
+        (slot->backend ? queue_stats_.to_backends : queue_stats_.to_clients) += len;
+        queue_stats_.peak = std::max<uint64_t>(queue_stats_.peak, slot->queued);
+    }
+    LOG_DEBUG("[DEBUG] [server.cpp:748] [PENDING] 🕒 fd={} ещё не принимает данные — {} байт в очередь", to_fd, len);
+    if (!hold)
+    {
+        update_epoll_interest(to_fd);
+    }
     return true;
 }
 
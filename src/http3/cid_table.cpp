@@ -0,0 +1,169 @@
+// src/http3/cid_table.cpp
+/**
+ * @file cid_table.cpp
+ * @brief Реализация таблицы Connection ID с открытой адресацией.
+ *
+ * @author Telian Edward <telianedward@icloud.com>
+ * @assisted-by AI-Assistant
+ * @date 2025-11-13
+ * @version 1.0
+ * @license MIT
+ */
+#include "../../include/http3/cid_table.hpp"
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+namespace
+{
+
+__extension__ typedef unsigned __int128 uint128_t;
+
+/// Перемножение 64×64 → 128 со сложением половин (смешивание в стиле wyhash)
+inline uint64_t mix(uint64_t a, uint64_t b) noexcept
+{
+    const uint128_t r = static_cast<uint128_t>(a) * b;
+    return static_cast<uint64_t>(r) ^ static_cast<uint64_t>(r >> 64);
+}
+
+/// Наименьшая степень двойки, в которую count записей помещается с заполнением не выше 3/4
+size_t capacity_for(size_t count) noexcept
+{
+    size_t capacity = 16;
+    while (capacity * 3 / 4 < count + 1)
+    {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+constexpr size_t NPOS = SIZE_MAX;
+
+} // namespace
+
+CidTable::CidTable(size_t initial_capacity)
+{
+    std::random_device rd;
+    for (auto &word : seed_)
+    {
+        word = (static_cast<uint64_t>(rd()) << 32) | rd();
+    }
+    rehash(capacity_for(initial_capacity));
+}
+
+uint64_t CidTable::hash(std::span<const uint8_t> cid) const noexcept
+{
+    // CID не длиннее 20 байт: три 64-битных слова с нулевым дополнением
+    uint64_t words[3]{};
+    std::memcpy(words, cid.data(), cid.size());
+    const uint64_t a = mix(words[0] ^ seed_[0], words[1] ^ seed_[1]);
+    return mix(words[2] ^ seed_[2] ^ cid.size(), a ^ seed_[3]);
+}
+
+size_t CidTable::find_slot(std::span<const uint8_t> cid, uint64_t h) const noexcept
+{
+    const uint8_t tag = tag_of(h);
+    for (size_t i = h & mask_;; i = (i + 1) & mask_)
+    {
+        const uint8_t t = tags_[i];
+        if (t == EMPTY)
+        {
+            return NPOS;
+        }
+        if (t == tag && slots_[i].len == cid.size() && std::memcmp(slots_[i].key, cid.data(), cid.size()) == 0)
+        {
+            return i;
+        }
+    }
+}
+
+uint32_t CidTable::find(std::span<const uint8_t> cid) const noexcept
+{
+    if (cid.size() > MAX_CID_LENGTH)
+    {
+        return NOT_FOUND;
+    }
+    const size_t i = find_slot(cid, hash(cid));
+    return i == NPOS ? NOT_FOUND : slots_[i].value;
+}
+
+void CidTable::place(std::span<const uint8_t> cid, uint64_t h, uint32_t value) noexcept
+{
+    size_t i = h & mask_;
+    while (tags_[i] != EMPTY)
+    {
+        i = (i + 1) & mask_;
+    }
+    tags_[i] = tag_of(h);
+    Slot &slot = slots_[i];
+    std::memcpy(slot.key, cid.data(), cid.size());
+    slot.len = static_cast<uint8_t>(cid.size());
+    slot.value = value;
+    ++size_;
+}
+
+bool CidTable::insert(std::span<const uint8_t> cid, uint32_t value)
+{
+    if (cid.size() > MAX_CID_LENGTH || value == NOT_FOUND)
+    {
+        return false;
+    }
+    uint64_t h = hash(cid);
+    if (find_slot(cid, h) != NPOS)
+    {
+        return false;
+    }
+    if ((size_ + 1) > tags_.size() * 3 / 4)
+    {
+        rehash(tags_.size() * 2);
+    }
+    place(cid, h, value);
+    return true;
+}
+
+bool CidTable::erase(std::span<const uint8_t> cid) noexcept
+{
+    if (cid.size() > MAX_CID_LENGTH)
+    {
+        return false;
+    }
+    size_t hole = find_slot(cid, hash(cid));
+    if (hole == NPOS)
+    {
+        return false;
+    }
+    // Обратный сдвиг: подтягиваем следующие записи цепочки, чьё «домашнее» место не позже дыры
+    for (size_t j = (hole + 1) & mask_; tags_[j] != EMPTY; j = (j + 1) & mask_)
+    {
+        const Slot &slot = slots_[j];
+        const size_t home = hash(std::span<const uint8_t>(slot.key, slot.len)) & mask_;
+        if (((j - home) & mask_) >= ((j - hole) & mask_))
+        {
+            tags_[hole] = tags_[j];
+            slots_[hole] = slot;
+            hole = j;
+        }
+    }
+    tags_[hole] = EMPTY;
+    --size_;
+    return true;
+}
+
+void CidTable::rehash(size_t new_capacity)
+{
+    std::vector<uint8_t> old_tags(new_capacity, EMPTY);
+    std::vector<Slot> old_slots(new_capacity);
+    old_tags.swap(tags_);
+    old_slots.swap(slots_);
+    mask_ = new_capacity - 1;
+    size_ = 0;
+    for (size_t i = 0; i < old_tags.size(); ++i)
+    {
+        if (old_tags[i] != EMPTY)
+        {
+            const Slot &slot = old_slots[i];
+            std::span<const uint8_t> key(slot.key, slot.len);
+            place(key, hash(key), slot.value);
+        }
+    }
+}
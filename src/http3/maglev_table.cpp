@@ -0,0 +1,124 @@
+// src/http3/maglev_table.cpp
+/**
+ * @file maglev_table.cpp
+ * @brief Реализация таблицы согласованного хэширования Maglev.
+ *
+ * @author Telian Edward <telianedward@icloud.com>
+ * @assisted-by AI-Assistant
+ * @date 2025-11-19
+ * @version 1.0
+ * @license MIT
+ */
+#include "../../include/http3/maglev_table.hpp"
+#include <algorithm>
+
+namespace
+{
+
+/// Финализатор splitmix64
+constexpr uint64_t mix(uint64_t x) noexcept
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+/// FNV-1a с последующим перемешиванием
+uint64_t hash_bytes(const uint8_t *data, size_t len, uint64_t seed) noexcept
+{
+    uint64_t h = 14695981039346656037ULL ^ seed;
+    for (size_t i = 0; i < len; ++i)
+    {
+        h ^= data[i];
+        h *= 1099511628211ULL;
+    }
+    return mix(h);
+}
+
+constexpr bool is_prime(uint32_t n) noexcept
+{
+    if (n < 2)
+    {
+        return false;
+    }
+    for (uint32_t d = 2; static_cast<uint64_t>(d) * d <= n; ++d)
+    {
+        if (n % d == 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+constexpr uint64_t OFFSET_SEED = 0x6d61676c65763031ULL; ///< Ключи хэшей offset и skip (фиксированы)
+constexpr uint64_t SKIP_SEED = 0x736b697073656564ULL;
+
+} // namespace
+
+MaglevTable::MaglevTable(uint32_t size)
+    : size_(std::max<uint32_t>(size, 3))
+{
+    while (!is_prime(size_))
+    {
+        ++size_;
+    }
+}
+
+uint64_t MaglevTable::hash(std::span<const uint8_t> key) noexcept
+{
+    return hash_bytes(key.data(), key.size(), 0);
+}
+
+bool MaglevTable::build(const std::vector<std::string> &names, const std::vector<bool> &enabled)
+{
+    struct Permutation {
+        uint16_t backend;
+        uint64_t offset;
+        uint64_t skip;
+        uint64_t next;
+    };
+    std::vector<Permutation> permutations;
+    for (size_t i = 0; i < names.size() && i < NO_BACKEND; ++i)
+    {
+        if (!enabled.empty() && (i >= enabled.size() || !enabled[i]))
+        {
+            continue;
+        }
+        const auto *name = reinterpret_cast<const uint8_t *>(names[i].data());
+        permutations.push_back({static_cast<uint16_t>(i),
+                                hash_bytes(name, names[i].size(), OFFSET_SEED) % size_,
+                                hash_bytes(name, names[i].size(), SKIP_SEED) % (size_ - 1) + 1,
+                                0});
+    }
+    if (permutations.empty())
+    {
+        table_.clear();
+        return false;
+    }
+
+    // Бэкенды по очереди занимают следующий свободный слот своей перестановки
+    table_.assign(size_, NO_BACKEND);
+    uint32_t filled = 0;
+    while (true)
+    {
+        for (Permutation &p : permutations)
+        {
+            uint64_t slot = (p.offset + p.next * p.skip) % size_;
+            while (table_[slot] != NO_BACKEND)
+            {
+                ++p.next;
+                slot = (p.offset + p.next * p.skip) % size_;
+            }
+            table_[slot] = p.backend;
+            ++p.next;
+            if (++filled == size_)
+            {
+                return true;
+            }
+        }
+    }
+}
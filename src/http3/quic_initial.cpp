@@ -0,0 +1,451 @@
+// src/http3/quic_initial.cpp
+/**
+ * @file quic_initial.cpp
+ * @brief Реализация снятия защиты Initial-пакетов и разбора ClientHello.
+ *
+ * @author Telian Edward <telianedward@icloud.com>
+ * @assisted-by AI-Assistant
+ * @date 2025-11-18
+ * @version 1.0
+ * @license MIT
+ */
+#include "../../include/http3/quic_initial.hpp"
+#include <algorithm>
+#include <cstring>
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+
+namespace
+{
+
+/// Соль Initial QUIC v1 (RFC 9001 §5.2)
+constexpr uint8_t INITIAL_SALT_V1[20] = {0x38, 0x76, 0x2c, 0xf7, 0xf5, 0x59, 0x34, 0xb3, 0x4d, 0x17,
+                                         0x9a, 0xe6, 0xa4, 0xc8, 0x0c, 0xad, 0xcc, 0xbb, 0x7f, 0x0a};
+/// Соль Initial QUIC v2 (RFC 9369 §3.3.1)
+constexpr uint8_t INITIAL_SALT_V2[20] = {0x0d, 0xed, 0xe3, 0xde, 0xf7, 0x00, 0xa6, 0xdb, 0x81, 0x93,
+                                         0x81, 0xbe, 0x6e, 0x26, 0x9d, 0xcb, 0xf9, 0xbd, 0x2e, 0xd9};
+
+constexpr size_t SECRET_SIZE = 32;   ///< Размер секретов HKDF-SHA256
+constexpr size_t AEAD_TAG_SIZE = 16;
+constexpr size_t HP_SAMPLE_SIZE = 16;
+constexpr size_t MAX_PACKET_NUMBER_LENGTH = 4;
+
+/// Типы фреймов, допустимые в Initial (RFC 9000 §12.4)
+constexpr uint64_t FRAME_PADDING = 0x00;
+constexpr uint64_t FRAME_PING = 0x01;
+constexpr uint64_t FRAME_ACK = 0x02;
+constexpr uint64_t FRAME_ACK_ECN = 0x03;
+constexpr uint64_t FRAME_CRYPTO = 0x06;
+constexpr uint64_t FRAME_CONNECTION_CLOSE = 0x1c;
+
+/// Типы TLS
+constexpr uint8_t HANDSHAKE_CLIENT_HELLO = 1;
+constexpr uint16_t EXTENSION_SERVER_NAME = 0;
+constexpr uint16_t EXTENSION_ALPN = 16;
+constexpr uint8_t SERVER_NAME_HOST = 0;
+
+/// Последовательное чтение полей TLS с проверкой границ
+class TlsReader {
+public:
+    explicit TlsReader(std::span<const uint8_t> data) noexcept : data_(data) {}
+
+    [[nodiscard]] bool ok() const noexcept { return ok_; }
+    [[nodiscard]] bool empty() const noexcept { return pos_ >= data_.size(); }
+
+    uint32_t number(size_t bytes) noexcept
+    {
+        if (!ok_ || data_.size() - pos_ < bytes)
+        {
+            ok_ = false;
+            return 0;
+        }
+        uint32_t value = 0;
+        for (size_t i = 0; i < bytes; ++i)
+        {
+            value = (value << 8) | data_[pos_++];
+        }
+        return value;
+    }
+
+    /// Отрезок с длиной в length_bytes байт перед ним
+    std::span<const uint8_t> vector(size_t length_bytes) noexcept
+    {
+        const size_t len = number(length_bytes);
+        return bytes(len);
+    }
+
+    std::span<const uint8_t> bytes(size_t len) noexcept
+    {
+        if (!ok_ || data_.size() - pos_ < len)
+        {
+            ok_ = false;
+            return {};
+        }
+        const std::span<const uint8_t> out = data_.subspan(pos_, len);
+        pos_ += len;
+        return out;
+    }
+
+private:
+    std::span<const uint8_t> data_;
+    size_t pos_ = 0;
+    bool ok_ = true;
+};
+
+/// Пропускает count varint-полей фрейма
+bool skip_varints(std::span<const uint8_t> in, size_t &pos, size_t count) noexcept
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (!quic_varint_decode(in, pos, value))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+bool QuicClientHelloInfo::offers_alpn(std::string_view protocol) const noexcept
+{
+    size_t pos = 0;
+    while (pos < alpn.size())
+    {
+        const size_t len = alpn[pos++];
+        if (len > alpn.size() - pos)
+        {
+            return false;
+        }
+        if (len == protocol.size() && std::memcmp(alpn.data() + pos, protocol.data(), len) == 0)
+        {
+            return true;
+        }
+        pos += len;
+    }
+    return false;
+}
+
+bool parse_client_hello(std::span<const uint8_t> message, QuicClientHelloInfo &info) noexcept
+{
+    info = QuicClientHelloInfo{};
+    TlsReader handshake(message);
+    if (handshake.number(1) != HANDSHAKE_CLIENT_HELLO)
+    {
+        return false;
+    }
+    TlsReader hello(handshake.vector(3));
+    hello.bytes(2 + 32); // legacy_version, random
+    hello.vector(1);     // legacy_session_id
+    hello.vector(2);     // cipher_suites
+    hello.vector(1);     // legacy_compression_methods
+    TlsReader extensions(hello.vector(2));
+    if (!handshake.ok() || !hello.ok() || !extensions.ok())
+    {
+        return false;
+    }
+
+    while (!extensions.empty())
+    {
+        const uint16_t type = static_cast<uint16_t>(extensions.number(2));
+        TlsReader body(extensions.vector(2));
+        if (!extensions.ok())
+        {
+            return false;
+        }
+        if (type == EXTENSION_SERVER_NAME)
+        {
+            TlsReader names(body.vector(2));
+            while (names.ok() && !names.empty())
+            {
+                const uint8_t name_type = static_cast<uint8_t>(names.number(1));
+                const std::span<const uint8_t> name = names.vector(2);
+                if (names.ok() && name_type == SERVER_NAME_HOST)
+                {
+                    info.server_name = std::string_view(reinterpret_cast<const char *>(name.data()), name.size());
+                    break;
+                }
+            }
+        }
+        else if (type == EXTENSION_ALPN)
+        {
+            info.alpn = body.vector(2);
+        }
+    }
+    return true;
+}
+
+bool QuicCryptoAssembler::add(uint64_t offset, std::span<const uint8_t> data) noexcept
+{
+    if (data.empty())
+    {
+        return true;
+    }
+    if (offset > MAX_CLIENT_HELLO_SIZE || data.size() > MAX_CLIENT_HELLO_SIZE - offset)
+    {
+        return false;
+    }
+    std::memcpy(data_ + offset, data.data(), data.size());
+
+    // Вставка диапазона с слиянием пересекающихся и соседних
+    Range merged{static_cast<uint16_t>(offset), static_cast<uint16_t>(offset + data.size())};
+    Range out[MAX_RANGES + 1];
+    size_t count = 0;
+    bool placed = false;
+    for (size_t i = 0; i < range_count_; ++i)
+    {
+        const Range &range = ranges_[i];
+        if (range.end < merged.begin)
+        {
+            out[count++] = range;
+        }
+        else if (range.begin > merged.end)
+        {
+            if (!placed)
+            {
+                out[count++] = merged;
+                placed = true;
+            }
+            out[count++] = range;
+        }
+        else
+        {
+            merged.begin = std::min(merged.begin, range.begin);
+            merged.end = std::max(merged.end, range.end);
+        }
+    }
+    if (!placed)
+    {
+        out[count++] = merged;
+    }
+    if (count > MAX_RANGES)
+    {
+        return false;
+    }
+    std::copy(out, out + count, ranges_);
+    range_count_ = count;
+    return true;
+}
+
+std::span<const uint8_t> QuicCryptoAssembler::client_hello() const noexcept
+{
+    const size_t available = prefix();
+    if (available < 4)
+    {
+        return {};
+    }
+    const size_t size = 4 + ((static_cast<size_t>(data_[1]) << 16) | (static_cast<size_t>(data_[2]) << 8) | data_[3]);
+    return size <= available ? std::span<const uint8_t>(data_, size) : std::span<const uint8_t>{};
+}
+
+bool QuicCryptoAssembler::malformed() const noexcept
+{
+    const size_t available = prefix();
+    if (available >= 1 && data_[0] != HANDSHAKE_CLIENT_HELLO)
+    {
+        return true;
+    }
+    if (available < 4)
+    {
+        return false;
+    }
+    const size_t size = 4 + ((static_cast<size_t>(data_[1]) << 16) | (static_cast<size_t>(data_[2]) << 8) | data_[3]);
+    return size > MAX_CLIENT_HELLO_SIZE;
+}
+
+QuicInitialDecryptor::QuicInitialDecryptor()
+{
+    aead_ctx_ = EVP_CIPHER_CTX_new();
+    hp_ctx_ = EVP_CIPHER_CTX_new();
+    hkdf_ctx_ = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, nullptr);
+    if (!ready() ||
+        EVP_DecryptInit_ex(aead_ctx_, EVP_aes_128_gcm(), nullptr, nullptr, nullptr) != 1 ||
+        EVP_EncryptInit_ex(hp_ctx_, EVP_aes_128_ecb(), nullptr, nullptr, nullptr) != 1 ||
+        EVP_CIPHER_CTX_set_padding(hp_ctx_, 0) != 1)
+    {
+        EVP_CIPHER_CTX_free(aead_ctx_);
+        EVP_CIPHER_CTX_free(hp_ctx_);
+        EVP_PKEY_CTX_free(hkdf_ctx_);
+        aead_ctx_ = hp_ctx_ = nullptr;
+        hkdf_ctx_ = nullptr;
+    }
+}
+
+QuicInitialDecryptor::~QuicInitialDecryptor()
+{
+    EVP_CIPHER_CTX_free(aead_ctx_);
+    EVP_CIPHER_CTX_free(hp_ctx_);
+    EVP_PKEY_CTX_free(hkdf_ctx_);
+}
+
+bool QuicInitialDecryptor::expand_label(std::span<const uint8_t> secret, std::string_view label,
+                                        uint8_t *out, size_t out_len) noexcept
+{
+    // HkdfLabel: длина (2) | "tls13 " + метка (1 + N) | контекст (1 + 0)
+    constexpr std::string_view PREFIX = "tls13 ";
+    uint8_t info[2 + 1 + 32 + 1];
+    const size_t label_len = PREFIX.size() + label.size();
+    if (label_len > 32)
+    {
+        return false;
+    }
+    size_t pos = 0;
+    info[pos++] = static_cast<uint8_t>(out_len >> 8);
+    info[pos++] = static_cast<uint8_t>(out_len);
+    info[pos++] = static_cast<uint8_t>(label_len);
+    std::memcpy(info + pos, PREFIX.data(), PREFIX.size());
+    pos += PREFIX.size();
+    std::memcpy(info + pos, label.data(), label.size());
+    pos += label.size();
+    info[pos++] = 0;
+
+    size_t len = out_len;
+    return EVP_PKEY_derive_init(hkdf_ctx_) == 1 &&
+           EVP_PKEY_CTX_hkdf_mode(hkdf_ctx_, EVP_PKEY_HKDEF_MODE_EXPAND_ONLY) == 1 &&
+           EVP_PKEY_CTX_set_hkdf_md(hkdf_ctx_, EVP_sha256()) == 1 &&
+           EVP_PKEY_CTX_set1_hkdf_key(hkdf_ctx_, secret.data(), static_cast<int>(secret.size())) == 1 &&
+           EVP_PKEY_CTX_add1_hkdf_info(hkdf_ctx_, info, static_cast<int>(pos)) == 1 &&
+           EVP_PKEY_derive(hkdf_ctx_, out, &len) == 1 && len == out_len;
+}
+
+bool QuicInitialDecryptor::derive_keys(uint32_t version, std::span<const uint8_t> dcid, QuicInitialKeys &keys) noexcept
+{
+    const uint8_t *salt = version == QUIC_VERSION_1 ? INITIAL_SALT_V1 : version == QUIC_VERSION_2 ? INITIAL_SALT_V2 : nullptr;
+    if (salt == nullptr || !ready())
+    {
+        return false;
+    }
+    const bool v2 = version == QUIC_VERSION_2;
+
+    // initial_secret = HKDF-Extract(salt, DCID); client_initial_secret = Expand-Label(.., "client in")
+    uint8_t initial_secret[SECRET_SIZE];
+    size_t len = SECRET_SIZE;
+    if (EVP_PKEY_derive_init(hkdf_ctx_) != 1 ||
+        EVP_PKEY_CTX_hkdf_mode(hkdf_ctx_, EVP_PKEY_HKDEF_MODE_EXTRACT_ONLY) != 1 ||
+        EVP_PKEY_CTX_set_hkdf_md(hkdf_ctx_, EVP_sha256()) != 1 ||
+        EVP_PKEY_CTX_set1_hkdf_salt(hkdf_ctx_, salt, sizeof(INITIAL_SALT_V1)) != 1 ||
+        EVP_PKEY_CTX_set1_hkdf_key(hkdf_ctx_, dcid.data(), static_cast<int>(dcid.size())) != 1 ||
+        EVP_PKEY_derive(hkdf_ctx_, initial_secret, &len) != 1 || len != SECRET_SIZE)
+    {
+        return false;
+    }
+    uint8_t client_secret[SECRET_SIZE];
+    return expand_label(initial_secret, "client in", client_secret, SECRET_SIZE) &&
+           expand_label(client_secret, v2 ? "quicv2 key" : "quic key", keys.key, sizeof(keys.key)) &&
+           expand_label(client_secret, v2 ? "quicv2 iv" : "quic iv", keys.iv, sizeof(keys.iv)) &&
+           expand_label(client_secret, v2 ? "quicv2 hp" : "quic hp", keys.hp, sizeof(keys.hp));
+}
+
+bool QuicInitialDecryptor::open(const QuicHeaderView &initial, const QuicInitialKeys &keys, QuicCryptoAssembler &crypto) noexcept
+{
+    const size_t pn_offset = initial.packet_number_offset();
+    const size_t size = initial.packet_size();
+    if (!ready() || initial.type() != QuicPacketType::Initial || pn_offset == 0 ||
+        size < pn_offset + MAX_PACKET_NUMBER_LENGTH + HP_SAMPLE_SIZE)
+    {
+        return false;
+    }
+    const std::span<const uint8_t> packet = initial.packet();
+
+    // Header Protection (RFC 9001 §5.4): маска — AES-ECB(hp, образец шифротекста)
+    uint8_t mask[HP_SAMPLE_SIZE];
+    int len = 0;
+    if (EVP_EncryptInit_ex(hp_ctx_, nullptr, nullptr, keys.hp, nullptr) != 1 ||
+        EVP_EncryptUpdate(hp_ctx_, mask, &len, packet.data() + pn_offset + MAX_PACKET_NUMBER_LENGTH, HP_SAMPLE_SIZE) != 1)
+    {
+        return false;
+    }
+    plaintext_.resize(size);
+    const uint8_t first = static_cast<uint8_t>(packet[0] ^ (mask[0] & 0x0F));
+    const size_t pn_len = static_cast<size_t>(first & 0x03) + 1;
+    const size_t header_len = pn_offset + pn_len;
+    if (size < header_len + AEAD_TAG_SIZE)
+    {
+        return false;
+    }
+    std::memcpy(plaintext_.data(), packet.data(), header_len);
+    plaintext_[0] = first;
+    uint64_t packet_number = 0;
+    for (size_t i = 0; i < pn_len; ++i)
+    {
+        plaintext_[pn_offset + i] = static_cast<uint8_t>(packet[pn_offset + i] ^ mask[1 + i]);
+        packet_number = (packet_number << 8) | plaintext_[pn_offset + i];
+    }
+
+    // Первые пакеты клиента имеют малые номера, поэтому усечённый номер равен полному
+    uint8_t nonce[sizeof(keys.iv)];
+    std::memcpy(nonce, keys.iv, sizeof(nonce));
+    for (size_t i = 0; i < 8; ++i)
+    {
+        nonce[sizeof(nonce) - 1 - i] ^= static_cast<uint8_t>(packet_number >> (8 * i));
+    }
+    const size_t payload_len = size - header_len - AEAD_TAG_SIZE;
+    uint8_t tag[AEAD_TAG_SIZE];
+    std::memcpy(tag, packet.data() + size - AEAD_TAG_SIZE, AEAD_TAG_SIZE);
+    uint8_t *payload = plaintext_.data() + header_len;
+    if (EVP_DecryptInit_ex(aead_ctx_, nullptr, nullptr, keys.key, nonce) != 1 ||
+        EVP_DecryptUpdate(aead_ctx_, nullptr, &len, plaintext_.data(), static_cast<int>(header_len)) != 1 ||
+        EVP_DecryptUpdate(aead_ctx_, payload, &len, packet.data() + header_len, static_cast<int>(payload_len)) != 1 ||
+        EVP_CIPHER_CTX_ctrl(aead_ctx_, EVP_CTRL_GCM_SET_TAG, AEAD_TAG_SIZE, tag) != 1 ||
+        EVP_DecryptFinal_ex(aead_ctx_, payload + len, &len) != 1)
+    {
+        return false;
+    }
+
+    // Фреймы Initial: CRYPTO собираются, остальные допустимые пропускаются
+    const std::span<const uint8_t> frames(payload, payload_len);
+    size_t pos = 0;
+    while (pos < frames.size())
+    {
+        uint64_t type = 0;
+        if (!quic_varint_decode(frames, pos, type))
+        {
+            return false;
+        }
+        switch (type)
+        {
+        case FRAME_PADDING:
+        case FRAME_PING:
+            break;
+        case FRAME_ACK:
+        case FRAME_ACK_ECN:
+        {
+            uint64_t range_count = 0;
+            if (!skip_varints(frames, pos, 2) || !quic_varint_decode(frames, pos, range_count) ||
+                range_count > frames.size() || !skip_varints(frames, pos, 1 + 2 * static_cast<size_t>(range_count)) ||
+                (type == FRAME_ACK_ECN && !skip_varints(frames, pos, 3)))
+            {
+                return false;
+            }
+            break;
+        }
+        case FRAME_CRYPTO:
+        {
+            uint64_t offset = 0;
+            uint64_t length = 0;
+            if (!quic_varint_decode(frames, pos, offset) || !quic_varint_decode(frames, pos, length) ||
+                length > frames.size() - pos || !crypto.add(offset, frames.subspan(pos, static_cast<size_t>(length))))
+            {
+                return false;
+            }
+            pos += static_cast<size_t>(length);
+            break;
+        }
+        case FRAME_CONNECTION_CLOSE:
+        {
+            uint64_t reason_len = 0;
+            if (!skip_varints(frames, pos, 2) || !quic_varint_decode(frames, pos, reason_len) ||
+                reason_len > frames.size() - pos)
+            {
+                return false;
+            }
+            pos += static_cast<size_t>(reason_len);
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return true;
+}
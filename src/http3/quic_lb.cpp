@@ -0,0 +1,147 @@
+// src/http3/quic_lb.cpp
+/**
+ * @file quic_lb.cpp
+ * @brief Реализация маршрутизируемых CID QUIC-LB.
+ *
+ * @author Telian Edward <telianedward@icloud.com>
+ * @assisted-by AI-Assistant
+ * @date 2025-11-20
+ * @version 1.0
+ * @license MIT
+ */
+#include "../../include/http3/quic_lb.hpp"
+#include <cstring>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+
+namespace
+{
+
+constexpr size_t AES_BLOCK = 16;
+constexpr size_t MIN_NONCE_LENGTH = 4;
+constexpr size_t MAX_LB_CID_LENGTH = 20;
+
+} // namespace
+
+QuicLbCodec::QuicLbCodec(const QuicLbConfig &config)
+    : config_(config)
+{
+    const size_t body = static_cast<size_t>(config_.server_id_length) + config_.nonce_length;
+    if (config_.config_id >= QUIC_LB_UNROUTABLE_CONFIG || config_.server_id_length == 0 ||
+        config_.nonce_length < MIN_NONCE_LENGTH || 1 + body > MAX_LB_CID_LENGTH)
+    {
+        return;
+    }
+    if (!config_.encrypted)
+    {
+        ready_ = true;
+        return;
+    }
+    if (body != AES_BLOCK)
+    {
+        return;
+    }
+    encrypt_ctx_ = EVP_CIPHER_CTX_new();
+    decrypt_ctx_ = EVP_CIPHER_CTX_new();
+    ready_ = encrypt_ctx_ != nullptr && decrypt_ctx_ != nullptr &&
+             EVP_EncryptInit_ex(encrypt_ctx_, EVP_aes_128_ecb(), nullptr, config_.key.data(), nullptr) == 1 &&
+             EVP_DecryptInit_ex(decrypt_ctx_, EVP_aes_128_ecb(), nullptr, config_.key.data(), nullptr) == 1 &&
+             EVP_CIPHER_CTX_set_padding(encrypt_ctx_, 0) == 1 &&
+             EVP_CIPHER_CTX_set_padding(decrypt_ctx_, 0) == 1;
+}
+
+QuicLbCodec::~QuicLbCodec()
+{
+    EVP_CIPHER_CTX_free(encrypt_ctx_);
+    EVP_CIPHER_CTX_free(decrypt_ctx_);
+}
+
+bool QuicLbCodec::encode(std::span<const uint8_t> server_id, std::span<const uint8_t> nonce,
+                         std::span<uint8_t> out) noexcept
+{
+    if (!ready_ || server_id.size() != config_.server_id_length || nonce.size() != config_.nonce_length ||
+        out.size() < cid_length())
+    {
+        return false;
+    }
+    // Младшие биты первого байта — длина CID без него или случайные (чтобы не выделять CID прокси)
+    uint8_t low = static_cast<uint8_t>(cid_length() - 1);
+    if (!config_.encode_length && RAND_bytes(&low, 1) != 1)
+    {
+        return false;
+    }
+    out[0] = static_cast<uint8_t>((config_.config_id << 5) | (low & 0x1F));
+    std::memcpy(&out[1], server_id.data(), server_id.size());
+    std::memcpy(&out[1 + server_id.size()], nonce.data(), nonce.size());
+    if (!config_.encrypted)
+    {
+        return true;
+    }
+    uint8_t block[AES_BLOCK];
+    int len = 0;
+    if (EVP_EncryptUpdate(encrypt_ctx_, block, &len, &out[1], AES_BLOCK) != 1 || len != AES_BLOCK)
+    {
+        return false;
+    }
+    std::memcpy(&out[1], block, AES_BLOCK);
+    return true;
+}
+
+bool QuicLbCodec::generate(std::span<const uint8_t> server_id, std::span<uint8_t> out) noexcept
+{
+    uint8_t nonce[MAX_LB_CID_LENGTH];
+    return ready_ && RAND_bytes(nonce, config_.nonce_length) == 1 &&
+           encode(server_id, {nonce, config_.nonce_length}, out);
+}
+
+bool QuicLbCodec::decode(std::span<const uint8_t> cid, std::span<uint8_t> server_id) noexcept
+{
+    if (!ready_ || cid.size() < cid_length() || server_id.size() < config_.server_id_length ||
+        (cid[0] >> 5) != config_.config_id ||
+        (config_.encode_length && static_cast<size_t>(cid[0] & 0x1F) != cid_length() - 1))
+    {
+        return false;
+    }
+    if (!config_.encrypted)
+    {
+        std::memcpy(server_id.data(), &cid[1], config_.server_id_length);
+        return true;
+    }
+    uint8_t block[AES_BLOCK];
+    int len = 0;
+    if (EVP_DecryptUpdate(decrypt_ctx_, block, &len, &cid[1], AES_BLOCK) != 1 || len != AES_BLOCK)
+    {
+        return false;
+    }
+    std::memcpy(server_id.data(), block, config_.server_id_length);
+    return true;
+}
+
+uint64_t QuicLbCodec::decode_index(std::span<const uint8_t> cid) noexcept
+{
+    uint8_t server_id[MAX_LB_CID_LENGTH];
+    if (!decode(cid, server_id))
+    {
+        return UINT64_MAX;
+    }
+    uint64_t index = 0;
+    for (size_t i = 0; i < config_.server_id_length; ++i)
+    {
+        index = (index << 8) | server_id[i];
+    }
+    return index;
+}
+
+bool QuicLbCodec::server_id_of(uint64_t index, std::span<uint8_t> server_id) const noexcept
+{
+    const size_t len = config_.server_id_length;
+    if (server_id.size() < len || (len < 8 && (index >> (8 * len)) != 0))
+    {
+        return false;
+    }
+    for (size_t i = 0; i < len; ++i)
+    {
+        server_id[len - 1 - i] = static_cast<uint8_t>(i < 8 ? index >> (8 * i) : 0);
+    }
+    return true;
+}
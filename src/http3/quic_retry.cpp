@@ -0,0 +1,228 @@
+// src/http3/quic_retry.cpp
+/**
+ * @file quic_retry.cpp
+ * @brief Реализация stateless Retry: токены AES-256-GCM и Retry Integrity Tag.
+ *
+ * @author Telian Edward <telianedward@icloud.com>
+ * @assisted-by AI-Assistant
+ * @date 2025-11-16
+ * @version 1.0
+ * @license MIT
+ */
+#include "../../include/http3/quic_retry.hpp"
+#include <algorithm>
+#include <cstring>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+
+namespace
+{
+
+/// Ключ и nonce Retry Integrity Tag QUIC v1 (RFC 9001 §5.8)
+constexpr uint8_t RETRY_KEY_V1[16] = {0xbe, 0x0c, 0x69, 0x0b, 0x9f, 0x66, 0x57, 0x5a,
+                                      0x1d, 0x76, 0x6b, 0x54, 0xe3, 0x68, 0xc8, 0x4e};
+constexpr uint8_t RETRY_NONCE_V1[12] = {0x46, 0x15, 0x99, 0xd3, 0x5d, 0x63, 0x2b, 0xf2, 0x23, 0x98, 0x25, 0xbb};
+/// Ключ и nonce Retry Integrity Tag QUIC v2 (RFC 9369 §3.3.3)
+constexpr uint8_t RETRY_KEY_V2[16] = {0x8f, 0xb4, 0xb0, 0x1b, 0x56, 0xac, 0x48, 0xe2,
+                                      0x60, 0xfb, 0xcb, 0xce, 0xad, 0x7c, 0xcc, 0x92};
+constexpr uint8_t RETRY_NONCE_V2[12] = {0xd8, 0x69, 0x69, 0xbc, 0x2d, 0x7c, 0x6d, 0x99, 0x90, 0xef, 0xb0, 0x4a};
+
+constexpr size_t TIMESTAMP_SIZE = 8;
+/// Допустимое опережение метки времени (часы потоков и бэкенда могут немного расходиться)
+constexpr uint64_t MAX_CLOCK_SKEW_SECONDS = 5;
+/// Максимальный размер associated data токена
+constexpr size_t MAX_TOKEN_AAD = 2 + MAX_CID_LENGTH + 4 + MAX_CID_LENGTH;
+
+uint64_t unix_seconds() noexcept
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(
+                                     std::chrono::system_clock::now().time_since_epoch())
+                                     .count());
+}
+
+} // namespace
+
+QuicRetry::QuicRetry(std::span<const uint8_t> key, std::chrono::seconds lifetime)
+    : lifetime_(lifetime)
+{
+    if (key.size() != RETRY_TOKEN_KEY_SIZE)
+    {
+        return;
+    }
+    seal_ctx_ = EVP_CIPHER_CTX_new();
+    open_ctx_ = EVP_CIPHER_CTX_new();
+    tag_ctx_ = EVP_CIPHER_CTX_new();
+    if (!ready() ||
+        EVP_EncryptInit_ex(seal_ctx_, EVP_aes_256_gcm(), nullptr, key.data(), nullptr) != 1 ||
+        EVP_DecryptInit_ex(open_ctx_, EVP_aes_256_gcm(), nullptr, key.data(), nullptr) != 1 ||
+        EVP_EncryptInit_ex(tag_ctx_, EVP_aes_128_gcm(), nullptr, nullptr, nullptr) != 1)
+    {
+        EVP_CIPHER_CTX_free(seal_ctx_);
+        EVP_CIPHER_CTX_free(open_ctx_);
+        EVP_CIPHER_CTX_free(tag_ctx_);
+        seal_ctx_ = open_ctx_ = tag_ctx_ = nullptr;
+    }
+}
+
+bool QuicRetry::generate_key(std::span<uint8_t> key) noexcept
+{
+    return key.size() == RETRY_TOKEN_KEY_SIZE && RAND_bytes(key.data(), static_cast<int>(key.size())) == 1;
+}
+
+QuicRetry::~QuicRetry()
+{
+    EVP_CIPHER_CTX_free(seal_ctx_);
+    EVP_CIPHER_CTX_free(open_ctx_);
+    EVP_CIPHER_CTX_free(tag_ctx_);
+}
+
+size_t QuicRetry::token_aad(std::span<const uint8_t> odcid, uint32_t client_addr,
+                            std::span<const uint8_t> token_dcid, uint8_t *out) noexcept
+{
+    size_t pos = 0;
+    out[pos++] = TOKEN_FORMAT;
+    out[pos++] = static_cast<uint8_t>(odcid.size());
+    std::memcpy(out + pos, odcid.data(), odcid.size());
+    pos += odcid.size();
+    std::memcpy(out + pos, &client_addr, sizeof(client_addr));
+    pos += sizeof(client_addr);
+    std::memcpy(out + pos, token_dcid.data(), token_dcid.size());
+    return pos + token_dcid.size();
+}
+
+bool QuicRetry::integrity_tag(uint32_t version, std::span<const uint8_t> odcid,
+                              std::span<const uint8_t> retry, uint8_t *tag) noexcept
+{
+    const uint8_t *key = version == QUIC_VERSION_1 ? RETRY_KEY_V1 : version == QUIC_VERSION_2 ? RETRY_KEY_V2 : nullptr;
+    const uint8_t *nonce = version == QUIC_VERSION_1 ? RETRY_NONCE_V1 : RETRY_NONCE_V2;
+    if (key == nullptr || !ready())
+    {
+        return false;
+    }
+    // Тег — AES-128-GCM с пустым открытым текстом над Retry Pseudo-Packet:
+    // ODCID Length | ODCID | Retry-пакет без тега
+    const uint8_t odcid_len = static_cast<uint8_t>(odcid.size());
+    int len = 0;
+    return EVP_EncryptInit_ex(tag_ctx_, nullptr, nullptr, key, nonce) == 1 &&
+           EVP_EncryptUpdate(tag_ctx_, nullptr, &len, &odcid_len, 1) == 1 &&
+           (odcid.empty() || EVP_EncryptUpdate(tag_ctx_, nullptr, &len, odcid.data(), static_cast<int>(odcid.size())) == 1) &&
+           EVP_EncryptUpdate(tag_ctx_, nullptr, &len, retry.data(), static_cast<int>(retry.size())) == 1 &&
+           EVP_EncryptFinal_ex(tag_ctx_, nullptr, &len) == 1 &&
+           EVP_CIPHER_CTX_ctrl(tag_ctx_, EVP_CTRL_GCM_GET_TAG, TAG_SIZE, tag) == 1;
+}
+
+size_t QuicRetry::build_retry(const QuicHeaderView &initial, uint32_t client_addr, std::span<uint8_t> out) noexcept
+{
+    const std::span<const uint8_t> odcid = initial.dcid();
+    const std::span<const uint8_t> client_cid = initial.scid();
+    const uint32_t version = initial.version();
+    if (!ready() || out.size() < MAX_RETRY_PACKET_SIZE || (version != QUIC_VERSION_1 && version != QUIC_VERSION_2))
+    {
+        return 0;
+    }
+
+    uint8_t random[1 + RETRY_CID_LENGTH + NONCE_SIZE];
+    if (RAND_bytes(random, sizeof(random)) != 1)
+    {
+        return 0;
+    }
+    const uint8_t *retry_scid = random + 1;
+    const uint8_t *nonce = random + 1 + RETRY_CID_LENGTH;
+
+    // Заголовок: тип Retry (v1 — 0b11, v2 — 0b00), младшие 4 бита не используются
+    size_t pos = 0;
+    out[pos++] = static_cast<uint8_t>((version == QUIC_VERSION_1 ? 0xF0 : 0xC0) | (random[0] & 0x0F));
+    out[pos++] = static_cast<uint8_t>(version >> 24);
+    out[pos++] = static_cast<uint8_t>(version >> 16);
+    out[pos++] = static_cast<uint8_t>(version >> 8);
+    out[pos++] = static_cast<uint8_t>(version);
+    out[pos++] = static_cast<uint8_t>(client_cid.size());
+    std::memcpy(&out[pos], client_cid.data(), client_cid.size());
+    pos += client_cid.size();
+    out[pos++] = static_cast<uint8_t>(RETRY_CID_LENGTH);
+    std::memcpy(&out[pos], retry_scid, RETRY_CID_LENGTH);
+    pos += RETRY_CID_LENGTH;
+
+    // Токен: открытая часть
+    out[pos++] = TOKEN_FORMAT;
+    out[pos++] = static_cast<uint8_t>(odcid.size());
+    std::memcpy(&out[pos], odcid.data(), odcid.size());
+    pos += odcid.size();
+    std::memcpy(&out[pos], nonce, NONCE_SIZE);
+    pos += NONCE_SIZE;
+
+    // Токен: зашифрованная метка времени и тег
+    uint8_t aad[MAX_TOKEN_AAD];
+    const size_t aad_len = token_aad(odcid, client_addr, {retry_scid, RETRY_CID_LENGTH}, aad);
+    uint8_t timestamp[TIMESTAMP_SIZE];
+    const uint64_t now = unix_seconds();
+    for (size_t i = 0; i < TIMESTAMP_SIZE; ++i)
+    {
+        timestamp[i] = static_cast<uint8_t>(now >> (8 * (TIMESTAMP_SIZE - 1 - i)));
+    }
+    int len = 0;
+    if (EVP_EncryptInit_ex(seal_ctx_, nullptr, nullptr, nullptr, nonce) != 1 ||
+        EVP_EncryptUpdate(seal_ctx_, nullptr, &len, aad, static_cast<int>(aad_len)) != 1 ||
+        EVP_EncryptUpdate(seal_ctx_, &out[pos], &len, timestamp, TIMESTAMP_SIZE) != 1 ||
+        EVP_EncryptFinal_ex(seal_ctx_, &out[pos + TIMESTAMP_SIZE], &len) != 1 ||
+        EVP_CIPHER_CTX_ctrl(seal_ctx_, EVP_CTRL_GCM_GET_TAG, TAG_SIZE, &out[pos + TIMESTAMP_SIZE]) != 1)
+    {
+        return 0;
+    }
+    pos += TIMESTAMP_SIZE + TAG_SIZE;
+
+    if (!integrity_tag(version, odcid, out.first(pos), &out[pos]))
+    {
+        return 0;
+    }
+    return pos + QuicHeaderView::RETRY_INTEGRITY_TAG_SIZE;
+}
+
+RetryTokenStatus QuicRetry::validate(const QuicHeaderView &initial, uint32_t client_addr) noexcept
+{
+    const std::span<const uint8_t> token = initial.token();
+    if (token.empty())
+    {
+        return RetryTokenStatus::Missing;
+    }
+    if (token.size() < 2 || token[0] != TOKEN_FORMAT || token[1] > MAX_CID_LENGTH ||
+        token.size() != 2 + token[1] + NONCE_SIZE + TIMESTAMP_SIZE + TAG_SIZE || !ready())
+    {
+        return RetryTokenStatus::Foreign;
+    }
+    const std::span<const uint8_t> odcid = token.subspan(2, token[1]);
+    const uint8_t *nonce = token.data() + 2 + odcid.size();
+    const uint8_t *sealed = nonce + NONCE_SIZE;
+    const std::span<const uint8_t> dcid = initial.dcid();
+
+    uint8_t aad[MAX_TOKEN_AAD];
+    const size_t aad_len = token_aad(odcid, client_addr, dcid, aad);
+    uint8_t timestamp[TIMESTAMP_SIZE];
+    uint8_t tag[TAG_SIZE];
+    std::memcpy(tag, sealed + TIMESTAMP_SIZE, TAG_SIZE);
+    int len = 0;
+    if (EVP_DecryptInit_ex(open_ctx_, nullptr, nullptr, nullptr, nonce) != 1 ||
+        EVP_DecryptUpdate(open_ctx_, nullptr, &len, aad, static_cast<int>(aad_len)) != 1 ||
+        EVP_DecryptUpdate(open_ctx_, timestamp, &len, sealed, TIMESTAMP_SIZE) != 1 ||
+        EVP_CIPHER_CTX_ctrl(open_ctx_, EVP_CTRL_GCM_SET_TAG, TAG_SIZE, tag) != 1 ||
+        EVP_DecryptFinal_ex(open_ctx_, timestamp + len, &len) != 1)
+    {
+        return RetryTokenStatus::Invalid;
+    }
+
+    uint64_t issued = 0;
+    for (size_t i = 0; i < TIMESTAMP_SIZE; ++i)
+    {
+        issued = (issued << 8) | timestamp[i];
+    }
+    const uint64_t now = unix_seconds();
+    if (issued > now + MAX_CLOCK_SKEW_SECONDS)
+    {
+        return RetryTokenStatus::Invalid;
+    }
+    if (now - std::min(now, issued) > static_cast<uint64_t>(lifetime_.count()))
+    {
+        return RetryTokenStatus::Expired;
+    }
+    return RetryTokenStatus::Valid;
+}
@@ -1,9 +1,6 @@
 /**
  * @file quic_udp_deduplicator.cpp
- * @brief Реализация методов, объявленных в соответствующем .h файле.
- *
- * Здесь реализуются методы, утилитные функции, бизнес-логика.
- * Файл работает с PostgreSQL через libpqxx и соответствует стандартам C++23.
+ * @brief Реализация дедупликации по отпечатку пакета.
  *
  * @author Telian Edward <telianedward@icloud.com>
  * @assisted-by AI-Assistant
@@ -13,71 +10,68 @@
  */
 // src/quic_udp_deduplicator.cpp
 #include "../../include/http3/quic_udp_deduplicator.hpp"
-#include "../../include/http3/client_key.hpp"
 #include <cstring>
+#include <random>
 
-size_t Deduplicator::PacketKeyHash::operator()(const PacketKey &key) const noexcept
+namespace
 {
-    size_t result = 0;
-    // Хэшируем ClientKey
-    result ^= std::hash<uint32_t>()(key.client_key.addr);
-    result ^= std::hash<uint16_t>()(key.client_key.port);
-    for (uint8_t b : key.client_key.cid)
-    {
-        result ^= std::hash<uint8_t>()(b) + 2654435761U + (result << 6) + (result >> 2);
-    }
-    // Хэшируем SCID
-    for (uint8_t b : key.scid)
-    {
-        result ^= std::hash<uint8_t>()(b) + 2654435761U + (result << 6) + (result >> 2);
-    }
-    // Хэшируем DCID
-    for (uint8_t b : key.dcid)
-    {
-        result ^= std::hash<uint8_t>()(b) + 2654435761U + (result << 6) + (result >> 2);
-    }
-    // Хэшируем Packet Number
-    result ^= std::hash<uint64_t>()(key.packet_number);
-    return result;
-}
 
-bool Deduplicator::PacketKeyEqual::operator()(const PacketKey &a, const PacketKey &b) const noexcept
-{
-    return a.client_key == b.client_key &&
-           a.scid == b.scid &&
-           a.dcid == b.dcid &&
-           a.packet_number == b.packet_number;
-}
+__extension__ typedef unsigned __int128 uint128_t;
 
-void Deduplicator::add_packet(const ClientKey &key, const PacketInfo &info)
+/// Перемножение 64×64 → 128 со сложением половин (смешивание в стиле wyhash)
+inline uint64_t mix(uint64_t a, uint64_t b) noexcept
 {
-    PacketKey packet_key{};
-    packet_key.client_key = key;
-    packet_key.scid = info.scid;
-    packet_key.dcid = {}; // DCID пока неизвестен, можно установить позже
-    packet_key.packet_number = info.packet_number;
-
-    seen_packets_[packet_key] = true;
+    const uint128_t r = static_cast<uint128_t>(a) * b;
+    return static_cast<uint64_t>(r) ^ static_cast<uint64_t>(r >> 64);
 }
 
-bool Deduplicator::is_duplicate(const ClientKey &key, const std::vector<uint8_t> &scid, const std::vector<uint8_t> &dcid, uint64_t packet_number) const
-{
-    PacketKey packet_key{};
-    packet_key.client_key = key;
-    packet_key.scid = scid;
-    packet_key.dcid = dcid;
-    packet_key.packet_number = packet_number;
+/// Ключ отпечатков, случайный на процесс: подобрать пакет с чужим отпечатком заранее нельзя
+struct FingerprintSeed {
+    uint64_t words[2];
 
-    auto it = seen_packets_.find(packet_key);
-    if (it != seen_packets_.end())
+    FingerprintSeed()
     {
-        return true; // Это дубликат
+        std::random_device rd;
+        for (auto &word : words)
+        {
+            word = (static_cast<uint64_t>(rd()) << 32) | rd() | 1;
+        }
     }
+};
+
+const FingerprintSeed SEED;
 
-    return false; // Это первый пакет
+/// 64-битный отпечаток байтов пакета: по 16 байт за шаг, хвост дополняется нулями
+uint64_t fingerprint(std::span<const uint8_t> packet) noexcept
+{
+    const uint8_t *data = packet.data();
+    size_t len = packet.size();
+    uint64_t h = SEED.words[0] ^ len;
+    for (; len >= 16; data += 16, len -= 16)
+    {
+        uint64_t words[2];
+        std::memcpy(words, data, sizeof(words));
+        h = mix(words[0] ^ SEED.words[0] ^ h, words[1] ^ SEED.words[1]);
+    }
+    uint64_t tail[2]{};
+    std::memcpy(tail, data, len);
+    h = mix(tail[0] ^ SEED.words[0] ^ h, tail[1] ^ SEED.words[1]);
+    return h == 0 ? 1 : h; // 0 — пустая запись
 }
 
-void Deduplicator::remove_connection(const ClientKey &key)
+} // namespace
+
+bool Deduplicator::check_and_record(std::span<const uint8_t> packet) noexcept
 {
-    (void)key; // Подавление предупреждения "unused parameter"
-}
\ No newline at end of file
+    const uint64_t print = fingerprint(packet);
+    for (uint64_t seen : fingerprints_)
+    {
+        if (seen == print)
+        {
+            return true;
+        }
+    }
+    fingerprints_[next_] = print;
+    next_ = static_cast<uint8_t>((next_ + 1) % HISTORY);
+    return false;
+}
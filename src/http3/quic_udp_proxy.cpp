@@ -4,7 +4,8 @@
  * @brief Реализация QUIC-UDP прокси.
  *
  * Обеспечивает прозрачное перенаправление QUIC-пакетов от клиента к серверу в России.
- * Использует асинхронный I/O (select) для масштабируемости.
+ * Цикл событий — edge-triggered epoll с пакетным приёмом/отправкой (recvmmsg/sendmmsg)
+ * либо io_uring (multishot recvmsg + зарегистрированные буферы); выбирается в настройках.
  *
  * @author Telian Edward <telianedward@icloud.com>
  * @assisted-by AI-Assistant
@@ -17,29 +18,172 @@
 #include <cstdio>
 #include <ctime>
 #include <random>
+#include <algorithm>
+#include <bit>
+#include <thread>
+#include <linux/filter.h>
+
+namespace
+{
+
+/// Текстовый IPv4-адрес в буфере на стеке (inet_ntoa возвращает общий статический буфер)
+struct Ipv4Text {
+    char text[INET_ADDRSTRLEN]{};
+
+    explicit Ipv4Text(uint32_t addr) noexcept {
+        const in_addr a{addr};
+        inet_ntop(AF_INET, &a, text, sizeof(text));
+    }
+};
+
+} // namespace
 
 // === Реализация методов класса QuicUdpProxy ===
 
-QuicUdpProxy::QuicUdpProxy(int listen_port, const std::string& backend_ip, int backend_port)
+QuicUdpProxy::QuicUdpProxy(int listen_port, const std::string& backend_ip, int backend_port,
+                           const QuicUdpProxyOptions& options)
     : udp_fd_(-1),
       wg_fd_(-1),
       listen_port_(listen_port),
       backend_port_(backend_port),
       backend_ip_(backend_ip),
+      options_(options),
       running_(true),
-      session_map_{},
-      reverse_map_{},
-      deduplicator_{} {}
+      client_rx_(options.batch_size, MAX_PACKET_SIZE),
+      backend_rx_(options.batch_size, MAX_PACKET_SIZE),
+      client_tx_(options.batch_size),
+      backend_tx_(options.batch_size),
+      sessions_{},
+      client_cids_{},
+      server_cids_{},
+      maglev_(options.maglev_table_size) {
+    if (options_.stateless_retry) {
+        // Ключ создаётся один раз и копируется в настройки потоков вместе с options_
+        if (options_.retry_token_key.empty()) {
+            options_.retry_token_key.resize(RETRY_TOKEN_KEY_SIZE);
+            if (!QuicRetry::generate_key(options_.retry_token_key)) {
+                LOG_ERROR("[ERROR] Не удалось сгенерировать ключ Retry-токенов");
+                options_.retry_token_key.clear();
+            }
+        }
+        retry_ = std::make_unique<QuicRetry>(options_.retry_token_key, options_.retry_token_lifetime);
+        if (!retry_->ready()) {
+            LOG_ERROR("[ERROR] Ключ Retry-токенов должен быть {} байт — stateless Retry выключен", RETRY_TOKEN_KEY_SIZE);
+            retry_.reset();
+        }
+    }
+    if (options_.admission_rate > 0) {
+        admission_ = std::make_unique<PrefixRateLimiter>(options_.admission_rate, options_.admission_burst,
+                                                         options_.admission_buckets);
+    }
+    if (options_.quic_lb) {
+        quic_lb_ = std::make_unique<QuicLbCodec>(options_.quic_lb_config);
+        if (!quic_lb_->ready()) {
+            LOG_ERROR("[ERROR] Некорректные настройки QUIC-LB — маршрутизация по CID выключена");
+            quic_lb_.reset();
+        }
+    }
+    // Список версий Version Negotiation собирается один раз; зарезервированная версия
+    // не даёт клиентам рассчитывать на неизменность списка (RFC 9000 §6.3)
+    if (options_.version_negotiation) {
+        std::random_device rd;
+        const uint32_t grease = (rd() & 0xf0f0f0f0U) | 0x0a0a0a0aU;
+        for (uint32_t version : options_.supported_versions) {
+            for (int shift = 24; shift >= 0; shift -= 8) {
+                vn_versions_.push_back(static_cast<uint8_t>(version >> shift));
+            }
+        }
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            vn_versions_.push_back(static_cast<uint8_t>(grease >> shift));
+        }
+    }
+    if (options_.route_client_hello) {
+        initial_decryptor_ = std::make_unique<QuicInitialDecryptor>();
+        if (!initial_decryptor_->ready()) {
+            LOG_ERROR("[ERROR] Не удалось создать контексты OpenSSL — маршрутизация по ClientHello выключена");
+            initial_decryptor_.reset();
+        }
+    }
+}
 
 bool QuicUdpProxy::run() {
-    // Инициализация генератора случайных чисел
-    std::random_device rd;
-    std::mt19937 gen(rd());
-
     // Регистрация обработчика сигналов
     std::signal(SIGINT, signal_handler);
     std::signal(SIGTERM, signal_handler);
 
+    // Один поток проверки на все рабочие потоки: состояние бэкендов у них общее
+    if (options_.health_check) {
+        std::vector<HealthTarget> targets{{backend_ip_, backend_port_, HealthProbeKind::Udp}};
+        for (const QuicBackendEndpoint &endpoint : options_.backends) {
+            targets.push_back({endpoint.ip, endpoint.port, HealthProbeKind::Udp});
+        }
+        health_ = std::make_shared<BackendHealthChecker>(std::move(targets), options_.health_check_options);
+        if (!health_->start()) {
+            LOG_ERROR("[ERROR] Проверка бэкендов не запущена — выбираются все бэкенды");
+            health_.reset();
+        }
+    }
+
+    const unsigned worker_count = std::max(1U, options_.workers);
+    workers_.clear();
+    for (unsigned i = 1; i < worker_count; ++i) {
+        auto worker = std::make_unique<QuicUdpProxy>(listen_port_, backend_ip_, backend_port_, options_);
+        worker->worker_index_ = i;
+        worker->health_ = health_;
+        workers_.push_back(std::move(worker));
+    }
+
+    // Сокеты открываются строго по порядку: индекс в reuseport-группе совпадает с номером потока
+    bool opened = open_sockets();
+    for (size_t i = 0; opened && i < workers_.size(); ++i) {
+        opened = workers_[i]->open_sockets();
+    }
+    if (!opened) {
+        close_sockets();
+        for (auto &worker : workers_) {
+            worker->close_sockets();
+        }
+        workers_.clear();
+        health_.reset();
+        return false;
+    }
+
+    // В режиме flow NAT поток клиента привязан к 4-tuple — хэша ядра достаточно
+    if (worker_count > 1 && options_.cid_steering && options_.forwarding == QuicForwardingMode::Cid &&
+        !attach_cid_steering(worker_count)) {
+        LOG_WARN("[WARN] CID-распределение недоступно — ядро распределяет пакеты по хэшу 4-tuple");
+    }
+
+    LOG_INFO("[INFO] Запущен на порту {}, слушает 0.0.0.0, бэкенд: {}:{}, batch={}, reactor={}, workers={}, mode={}",
+             listen_port_, backend_ip_, backend_port_, client_rx_.capacity(),
+             options_.reactor == QuicReactorKind::IoUring ? "io_uring" : "epoll", worker_count,
+             options_.forwarding == QuicForwardingMode::FlowNat ? "flow-nat" : "cid");
+
+    std::vector<std::thread> threads;
+    threads.reserve(workers_.size());
+    for (auto &worker : workers_) {
+        QuicUdpProxy *w = worker.get();
+        threads.emplace_back([w]() {
+            if (!w->serve()) {
+                LOG_ERROR("[ERROR] Поток QUIC #{} завершился с ошибкой", w->worker_index_);
+            }
+        });
+    }
+
+    bool result = serve();
+
+    for (auto &worker : workers_) {
+        worker->stop();
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    workers_.clear();
+    health_.reset();
+    return result;
+}
+
+bool QuicUdpProxy::open_sockets() noexcept {
     // --- Создание сокета для клиентов (порт 443) ---
     udp_fd_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
     if (udp_fd_ < 0) {
@@ -56,7 +200,7 @@ bool QuicUdpProxy::run() {
     }
     if (set_nonblocking(udp_fd_) == -1) {
         LOG_ERROR("[ERROR] set_nonblocking udp_fd failed: {}", strerror(errno));
-        ::close(udp_fd_);
+        close_sockets();
         return false;
     }
 
@@ -69,92 +213,410 @@ bool QuicUdpProxy::run() {
 
     if (bind(udp_fd_, (struct sockaddr *)&listen_addr, sizeof(listen_addr)) < 0) {
         LOG_ERROR("[ERROR] bind udp_fd failed: {}", strerror(errno));
-        ::close(udp_fd_);
+        close_sockets();
         return false;
     }
 
-    // --- Создание сокета для отправки в РФ ---
+    // --- Создание сокета для отправки в РФ (у каждого потока свой) ---
     wg_fd_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
     if (wg_fd_ < 0) {
         LOG_ERROR("[ERROR] socket wg_fd failed: {}", strerror(errno));
-        ::close(udp_fd_);
+        close_sockets();
         return false;
     }
     if (set_nonblocking(wg_fd_) == -1) {
         LOG_ERROR("[ERROR] set_nonblocking wg_fd failed: {}", strerror(errno));
+        close_sockets();
+        return false;
+    }
+
+    memset(&backend_addr_, 0, sizeof(backend_addr_));
+    backend_addr_.sin_family = AF_INET;
+    if (inet_pton(AF_INET, backend_ip_.c_str(), &backend_addr_.sin_addr) <= 0) {
+        LOG_ERROR("[ERROR] Некорректный IP бэкенда: {}", backend_ip_);
+        close_sockets();
+        return false;
+    }
+    backend_addr_.sin_port = htons(backend_port_);
+
+    backends_.assign(1, backend_addr_);
+    for (const QuicBackendEndpoint &endpoint : options_.backends) {
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(endpoint.port));
+        if (inet_pton(AF_INET, endpoint.ip.c_str(), &addr.sin_addr) <= 0) {
+            LOG_ERROR("[ERROR] Некорректный IP бэкенда: {}", endpoint.ip);
+            close_sockets();
+            return false;
+        }
+        backends_.push_back(addr);
+    }
+    // Имена «ip:port» делают таблицу одинаковой во всех потоках и не зависящей от порядка запуска
+    backend_names_.assign(1, backend_ip_ + ":" + std::to_string(backend_port_));
+    backend_hashed_.assign(1, true);
+    for (const QuicBackendEndpoint &endpoint : options_.backends) {
+        backend_names_.push_back(endpoint.ip + ":" + std::to_string(endpoint.port));
+        backend_hashed_.push_back(endpoint.hashed);
+    }
+    rebuild_backend_table();
+
+    if (options_.udp_gso) {
+        enable_segmentation(udp_fd_, client_tx_);
+        enable_segmentation(wg_fd_, backend_tx_);
+    }
+    return true;
+}
+
+void QuicUdpProxy::enable_segmentation(int fd, UdpSendBatch &tx) noexcept {
+    if (!enable_udp_gro(fd)) {
+        LOG_WARN("[WARN] UDP_GRO недоступен на fd={}: {}", fd, strerror(errno));
+    }
+    tx.set_gso(udp_gso_supported(fd));
+    if (!tx.gso()) {
+        LOG_WARN("[WARN] UDP_SEGMENT недоступен на fd={}: {}", fd, strerror(errno));
+    }
+}
+
+void QuicUdpProxy::close_sockets() noexcept {
+    if (udp_fd_ != -1) {
         ::close(udp_fd_);
+        udp_fd_ = -1;
+    }
+    if (wg_fd_ != -1) {
         ::close(wg_fd_);
+        wg_fd_ = -1;
+    }
+    for (uint32_t i = 0; i < flows_.size(); ++i) {
+        remove_flow(i);
+    }
+}
+
+bool QuicUdpProxy::attach_cid_steering(unsigned worker_count) noexcept {
+    const uint32_t k = options_.steering_cid_byte;
+    // Программа видит полезную нагрузку UDP с нулевого смещения.
+    // Long Header: длина DCID в байте 5, DCID с байта 6; Short Header: DCID с байта 1.
+    // Возврат >= числа сокетов (или выход за границу пакета для индекса 0) — выбор ядра по хэшу/поток 0.
+    struct sock_filter code[] = {
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 0),                   // 0: A = первый байт
+        BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x80, 0, 4),         // 1: Long Header? → 2, иначе → 6
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 5),                   // 2: A = длина DCID
+        BPF_JUMP(BPF_JMP | BPF_JGT | BPF_K, k, 0, 5),            // 3: длина > k? → 4, иначе → 9
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 6 + k),               // 4: A = DCID[k]
+        BPF_JUMP(BPF_JMP | BPF_JA, 1, 0, 0),                     // 5: → 7
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 1 + k),               // 6: A = DCID[k] (Short Header)
+        BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, worker_count),       // 7: A %= число потоков
+        BPF_STMT(BPF_RET | BPF_A, 0),                            // 8: вернуть номер потока
+        BPF_STMT(BPF_RET | BPF_K, 0xFFFFFFFFU),                  // 9: DCID короче — выбор по хэшу
+    };
+    struct sock_fprog prog{};
+    prog.len = static_cast<unsigned short>(sizeof(code) / sizeof(code[0]));
+    prog.filter = code;
+    if (setsockopt(udp_fd_, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) < 0) {
+        LOG_ERROR("[ERROR] setsockopt SO_ATTACH_REUSEPORT_CBPF failed: {}", strerror(errno));
         return false;
     }
+    LOG_INFO("[INFO] Пакеты распределяются по {} потокам по байту DCID[{}]", worker_count, k);
+    return true;
+}
 
-    struct sockaddr_in backend_addr{};
-    memset(&backend_addr, 0, sizeof(backend_addr));
-    backend_addr.sin_family = AF_INET;
-    inet_pton(AF_INET, backend_ip_.c_str(), &backend_addr.sin_addr);
-    backend_addr.sin_port = htons(backend_port_);
+bool QuicUdpProxy::serve() noexcept {
+    now_tick_ = current_tick();
+    session_timers_ = TimerWheel(now_tick_);
+    flow_timers_ = TimerWheel(now_tick_);
+    bool result = false;
+    if (options_.reactor == QuicReactorKind::IoUring && options_.forwarding == QuicForwardingMode::FlowNat) {
+        // Набор сокетов io_uring фиксируется при init(), а сокеты потоков появляются на лету
+        LOG_WARN("[WARN] flow NAT работает только с epoll — io_uring не используется");
+        result = run_epoll_loop();
+    } else if (options_.reactor == QuicReactorKind::IoUring) {
+        uring_ = std::make_unique<UringReactor>(options_.uring_entries, options_.uring_buffers, MAX_PACKET_SIZE,
+                                                options_.udp_gso ? UDP_SEGMENT_CMSG_SPACE : 0);
+        if (uring_->init({udp_fd_, wg_fd_})) {
+            result = run_uring_loop();
+        }
+        if (!result && running_) {
+            LOG_WARN("[WARN] io_uring недоступен — переключаемся на epoll");
+            uring_.reset();
+            result = run_epoll_loop();
+        }
+    } else {
+        result = run_epoll_loop();
+    }
 
-    LOG_INFO("[INFO] Запущен на порту {}, слушает 0.0.0.0, бэкенд: {}:{}",
-             listen_port_, backend_ip_, backend_port_);
+    log_io_stats();
+    uring_.reset();
+    LOG_INFO("[INFO] Поток QUIC #{} остановлен.", worker_index_);
+    close_sockets();
+    return result;
+}
 
-    char buf[MAX_PACKET_SIZE];
-    fd_set read_fds;
+bool QuicUdpProxy::run_epoll_loop() noexcept {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ == -1) {
+        LOG_ERROR("[ERROR] epoll_create1 failed: {}", strerror(errno));
+        return false;
+    }
+    for (int fd : {udp_fd_, wg_fd_}) {
+        struct epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLET;
+        ev.data.fd = fd;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) == -1) {
+            LOG_ERROR("[ERROR] epoll_ctl ADD fd={} failed: {}", fd, strerror(errno));
+            ::close(epoll_fd_);
+            epoll_fd_ = -1;
+            return false;
+        }
+    }
 
+    // Edge-triggered: датаграммы, пришедшие до регистрации, события не дадут — вычитываем сразу
+    drain_socket(udp_fd_, true);
+    drain_socket(wg_fd_, false);
+
+    auto last_stats = std::chrono::steady_clock::now();
+    struct epoll_event events[MAX_EPOLL_EVENTS];
     while (running_) {
-        FD_ZERO(&read_fds);
-        FD_SET(udp_fd_, &read_fds);
-        FD_SET(wg_fd_, &read_fds);
-        int max_fd = std::max(udp_fd_, wg_fd_);
-        timeval timeout{.tv_sec = 0, .tv_usec = 100000}; // 100 мс
-        int activity = select(max_fd + 1, &read_fds, nullptr, nullptr, &timeout);
-
-        if (activity < 0 && errno != EINTR) {
-            LOG_ERROR("[ERROR] select error: {}", strerror(errno));
-            continue;
+        int nfds = epoll_wait(epoll_fd_, events, MAX_EPOLL_EVENTS, 100); // 100 мс — для проверки running_ и статистики
+        if (nfds < 0 && errno != EINTR) {
+            LOG_ERROR("[ERROR] epoll_wait error: {}", strerror(errno));
+        }
+        for (int i = 0; i < nfds; ++i) {
+            // === НАПРАВЛЕНИЕ: КЛИЕНТ → СЕРВЕР / СЕРВЕР → КЛИЕНТ ===
+            int fd = events[i].data.fd;
+            if (fd == udp_fd_ || fd == wg_fd_) {
+                drain_socket(fd, fd == udp_fd_);
+            } else {
+                drain_flow_socket(fd);
+            }
+        }
+        expire_sessions();
+        refresh_backend_health();
+        maybe_log_stats(last_stats);
+    }
+    ::close(epoll_fd_);
+    epoll_fd_ = -1;
+    return true;
+}
+
+bool QuicUdpProxy::run_uring_loop() noexcept {
+    auto on_datagram = [this](const UringDatagram &dgram) {
+        const bool from_client = dgram.socket_index == URING_CLIENT_SOCKET;
+        UdpBatchStats &stats = from_client ? client_stats_ : backend_stats_;
+        stats.rx_packets += (dgram.len + dgram.segment_size - 1) / std::max<size_t>(dgram.segment_size, 1);
+        if (dgram.segment_size < dgram.len) {
+            ++stats.rx_gro;
         }
+        if (dgram.truncated) {
+            LOG_WARN("Датаграмма больше {} байт — отброшена", MAX_PACKET_SIZE);
+            return;
+        }
+        dispatch_datagrams(dgram.data, dgram.len, dgram.segment_size, *dgram.addr, dgram.addr_len, from_client);
+    };
+
+    auto last_stats = std::chrono::steady_clock::now();
+    while (running_) {
+        if (uring_->run_once(100, on_datagram) < 0) {
+            return false;
+        }
+        // Отправки превращаются в SQE и уйдут в ядро вместе со следующим io_uring_enter
+        flush_send_queues();
+        uring_->recycle_buffers();
+        expire_sessions();
+        refresh_backend_health();
+        maybe_log_stats(last_stats);
+    }
+    return true;
+}
+
+void QuicUdpProxy::maybe_log_stats(std::chrono::steady_clock::time_point &last) const noexcept {
+    if (options_.stats_interval.count() <= 0) {
+        return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (now - last >= options_.stats_interval) {
+        log_io_stats();
+        last = now;
+    }
+}
+
+void QuicUdpProxy::rebuild_backend_table() noexcept {
+    if (health_) {
+        health_generation_ = health_->generation();
+    }
+    std::vector<bool> enabled = backend_hashed_;
+    bool any = false;
+    for (size_t i = 0; i < enabled.size(); ++i) {
+        enabled[i] = enabled[i] && (!health_ || health_->is_up(i));
+        any = any || enabled[i];
+    }
+    // Все недоступны — лучше пробовать все, чем отбрасывать каждое новое соединение
+    (void)maglev_.build(backend_names_, any ? enabled : backend_hashed_);
+}
+
+void QuicUdpProxy::refresh_backend_health() noexcept {
+    if (health_ && health_->generation() != health_generation_) {
+        rebuild_backend_table();
+        LOG_INFO("[INFO] #{} Таблица бэкендов перестроена по результатам проверки", worker_index_);
+    }
+}
+
+void QuicUdpProxy::stop() {
+    running_ = false;
+    for (auto &worker : workers_) {
+        worker->stop();
+    }
+}
 
-        // === НАПРАВЛЕНИЕ: КЛИЕНТ → СЕРВЕР ===
-        if (FD_ISSET(udp_fd_, &read_fds)) {
-            struct sockaddr_in client_addr{};
-            socklen_t client_len = sizeof(client_addr);
-            ssize_t n = recvfrom(udp_fd_, buf, sizeof(buf), 0,
-                                 (struct sockaddr *)&client_addr, &client_len);
-            if (n < 0 || static_cast<size_t>(n) >= MAX_PACKET_SIZE) {
-                if (errno != EAGAIN && errno != EWOULDBLOCK) {
-                    LOG_ERROR("recvfrom client failed: {}", strerror(errno));
-                }
+void QuicUdpProxy::drain_socket(int fd, bool from_client) noexcept {
+    UdpRecvBatch &rx = from_client ? client_rx_ : backend_rx_;
+    UdpBatchStats &stats = from_client ? client_stats_ : backend_stats_;
+
+    // Читаем пачками, пока recvmmsg возвращает полную пачку (дальше сокет пуст)
+    while (running_) {
+        int count = rx.receive(fd, stats);
+        if (count < 0) {
+            if (errno == ECONNREFUSED || errno == EHOSTUNREACH || errno == ENETUNREACH) {
+                // Отложенная ICMP-ошибка сокета — она уже снята, читаем дальше
                 continue;
             }
-            handle_client_packet(buf, n, client_addr, client_len);
-        }
-
-        // === НАПРАВЛЕНИЕ: СЕРВЕР → КЛИЕНТ ===
-        if (FD_ISSET(wg_fd_, &read_fds)) {
-            struct sockaddr_in backend_addr{};
-            socklen_t backend_len = sizeof(backend_addr);
-            ssize_t n = recvfrom(wg_fd_, buf, sizeof(buf), 0,
-                                 (struct sockaddr *)&backend_addr, &backend_len);
-            if (n < 0 || static_cast<size_t>(n) >= MAX_PACKET_SIZE) {
-                if (errno != EAGAIN && errno != EWOULDBLOCK) {
-                    LOG_ERROR("recvfrom backend failed: {}", strerror(errno));
-                }
+            LOG_ERROR("recvmmsg {} failed: {}", from_client ? "client" : "backend", strerror(errno));
+            return;
+        }
+        for (int i = 0; i < count; ++i) {
+            if (rx.truncated(i)) {
+                LOG_WARN("Датаграмма больше {} байт — отброшена", MAX_PACKET_SIZE);
                 continue;
             }
-            handle_backend_packet(buf, n, backend_addr, backend_len);
+            dispatch_datagrams(rx.data(i), rx.length(i), rx.segment_size(i), rx.addr(i), rx.addr_len(i), from_client);
+        }
+        // Очереди ссылаются на буферы rx — сбрасываем до следующего recvmmsg
+        flush_send_queues();
+        if (static_cast<size_t>(count) < rx.capacity()) {
+            return;
         }
     }
+}
 
-    LOG_INFO("[INFO] Прокси остановлен.");
-    if (udp_fd_ != -1) {
-        ::close(udp_fd_);
+void QuicUdpProxy::dispatch_datagrams(uint8_t *data, size_t len, size_t segment_size,
+                                      const sockaddr_in &addr, socklen_t addr_len, bool from_client) noexcept {
+    if (options_.forwarding == QuicForwardingMode::FlowNat) {
+        // Сокет бэкенда в этом режиме не используется: ответы приходят на сокеты потоков
+        if (from_client) {
+            forward_client_flow(data, len, segment_size, addr);
+        }
+        return;
     }
-    if (wg_fd_ != -1) {
-        ::close(wg_fd_);
+
+    // Каждый GRO-сегмент — отдельная QUIC-датаграмма со своим заголовком.
+    // Сегменты пересылаются по месту, поэтому очередь GSO склеит их обратно с теми же границами.
+    const size_t step = segment_size == 0 ? len : segment_size;
+    for (size_t offset = 0; offset < len; offset += step) {
+        char *buf = reinterpret_cast<char *>(data + offset);
+        ssize_t n = static_cast<ssize_t>(std::min(step, len - offset));
+        if (from_client) {
+            handle_client_packet(buf, n, addr, addr_len);
+        } else {
+            handle_backend_packet(buf, n, addr, addr_len);
+        }
     }
-    return true;
 }
 
-void QuicUdpProxy::stop() {
-    running_ = false;
+void QuicUdpProxy::queue_to_client(const uint8_t *data, size_t len, const sockaddr_in &dest) noexcept {
+    if (!client_tx_.push(data, len, dest)) {
+        flush_queue(client_tx_, udp_fd_, URING_CLIENT_SOCKET, client_stats_);
+        (void)client_tx_.push(data, len, dest);
+    }
+}
+
+void QuicUdpProxy::queue_to_backend(const uint8_t *data, size_t len, const sockaddr_in &dest) noexcept {
+    if (!backend_tx_.push(data, len, dest)) {
+        flush_queue(backend_tx_, wg_fd_, URING_BACKEND_SOCKET, backend_stats_);
+        (void)backend_tx_.push(data, len, dest);
+    }
+}
+
+void QuicUdpProxy::flush_send_queues() noexcept {
+    flush_queue(backend_tx_, wg_fd_, URING_BACKEND_SOCKET, backend_stats_);
+    flush_queue(client_tx_, udp_fd_, URING_CLIENT_SOCKET, client_stats_);
+}
+
+void QuicUdpProxy::flush_queue(UdpSendBatch &batch, int fd, int uring_socket, UdpBatchStats &stats) noexcept {
+    if (batch.size() == 0) {
+        return;
+    }
+    if (!uring_) {
+        batch.flush(fd, stats);
+        return;
+    }
+    for (size_t i = 0; i < batch.size(); ++i) {
+        if (uring_->queue_send(uring_socket, batch.message(i))) {
+            stats.tx_packets += batch.segments(i);
+            if (batch.segments(i) > 1) {
+                ++stats.tx_gso;
+            }
+        } else {
+            LOG_WARN("io_uring: нет свободных слотов отправки — датаграмма отброшена");
+        }
+    }
+    batch.clear();
+}
+
+void QuicUdpProxy::log_io_stats() const noexcept {
+    if (options_.forwarding == QuicForwardingMode::FlowNat) {
+        LOG_INFO("[STATS] #{} flow NAT: потоков {} / {}, создано {}, истекло {}, отклонено {}, "
+                 "сверх лимита префикса {}, память {} байт",
+                 worker_index_, session_stats_.active, options_.max_flows, session_stats_.created,
+                 session_stats_.expired, session_stats_.rejected, session_stats_.admission_dropped,
+                 session_stats_.memory_bytes);
+    } else {
+        LOG_INFO("[STATS] #{} sessions: активных {}, создано {}, истекло {}, вытеснено {}, "
+                 "сверх лимита префикса {}, сверх лимита 3x {} пак./{} байт, смен адреса {} (отклонено {}), "
+                 "память {} / {} байт",
+                 worker_index_, session_stats_.active, session_stats_.created, session_stats_.expired,
+                 session_stats_.evicted, session_stats_.admission_dropped, session_stats_.amplification_dropped,
+                 session_stats_.amplification_dropped_bytes, session_stats_.migrated,
+                 session_stats_.migration_limited, session_stats_.memory_bytes,
+                 options_.session_memory_budget);
+    }
+    if (initial_decryptor_) {
+        LOG_INFO("[STATS] #{} ClientHello: по SNI {}, по Maglev {}, переполнение {}, задержано датаграмм {}",
+                 worker_index_, routing_stats_.routed, routing_stats_.fallback, routing_stats_.overflow,
+                 routing_stats_.held);
+    }
+    if (options_.forwarding == QuicForwardingMode::Cid) {
+        LOG_INFO("[STATS] #{} edge: Version Negotiation {}, неподдерживаемая версия < 1200 байт {}, "
+                 "Initial < 1200 байт {}, неразборных {}, невозможная Length {}, VN от клиента {}",
+                 worker_index_, edge_stats_.version_negotiation, edge_stats_.unsupported_small,
+                 edge_stats_.small_initial, edge_stats_.malformed, edge_stats_.bad_length,
+                 edge_stats_.client_negotiation);
+    }
+    if (quic_lb_) {
+        LOG_INFO("[STATS] #{} QUIC-LB: Short Header по server ID {}", worker_index_, routing_stats_.cid_routed);
+    }
+    if (retry_) {
+        LOG_INFO("[STATS] #{} retry: отправлено {}, подтверждено {}, просрочено {}, отброшено {}",
+                 worker_index_, retry_stats_.sent, retry_stats_.validated, retry_stats_.expired,
+                 retry_stats_.invalid);
+    }
+    if (uring_) {
+        uint64_t packets = client_stats_.rx_packets + client_stats_.tx_packets +
+                           backend_stats_.rx_packets + backend_stats_.tx_packets;
+        uint64_t enters = uring_->enter_calls();
+        LOG_INFO("[STATS] #{} io_uring: client rx {} / tx {}, backend rx {} / tx {}, GRO {} / GSO {}, "
+                 "io_uring_enter {} ({:.2f} пак./выз.)",
+                 worker_index_, client_stats_.rx_packets, client_stats_.tx_packets,
+                 backend_stats_.rx_packets, backend_stats_.tx_packets,
+                 client_stats_.rx_gro + backend_stats_.rx_gro, client_stats_.tx_gso + backend_stats_.tx_gso,
+                 enters, enters == 0 ? 0.0 : static_cast<double>(packets) / static_cast<double>(enters));
+        return;
+    }
+    LOG_INFO("[STATS] #{} client: rx {} пак./{} выз. ({:.2f} пак./выз., GRO {}), tx {} пак./{} выз. ({:.2f} пак./выз., GSO {})",
+             worker_index_,
+             client_stats_.rx_packets, client_stats_.rx_syscalls, client_stats_.rx_packets_per_syscall(), client_stats_.rx_gro,
+             client_stats_.tx_packets, client_stats_.tx_syscalls, client_stats_.tx_packets_per_syscall(), client_stats_.tx_gso);
+    LOG_INFO("[STATS] #{} backend: rx {} пак./{} выз. ({:.2f} пак./выз., GRO {}), tx {} пак./{} выз. ({:.2f} пак./выз., GSO {})",
+             worker_index_,
+             backend_stats_.rx_packets, backend_stats_.rx_syscalls, backend_stats_.rx_packets_per_syscall(), backend_stats_.rx_gro,
+             backend_stats_.tx_packets, backend_stats_.tx_syscalls, backend_stats_.tx_packets_per_syscall(), backend_stats_.tx_gso);
 }
 
 int QuicUdpProxy::set_nonblocking(int fd) noexcept {
@@ -221,110 +683,551 @@ void QuicUdpProxy::signal_handler(int sig) {
     exit(0);
 }
 
+uint64_t QuicUdpProxy::current_tick() noexcept {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(now / SESSION_TIMER_TICK);
+}
+
+size_t QuicUdpProxy::session_footprint(const QuicSession &session) noexcept {
+    return sizeof(QuicSession) + session.key.token.capacity() +
+           (1 + static_cast<size_t>(session.server_cid_count)) * CidTable::bytes_per_entry();
+}
+
+uint32_t QuicUdpProxy::create_session(const ClientKey &key, const ConnectionId &scid) {
+    // Бюджет памяти: освобождаем место под новую запись, вытесняя холодные сессии
+    const size_t needed = sizeof(QuicSession) + CidTable::bytes_per_entry();
+    while (session_stats_.memory_bytes + needed > options_.session_memory_budget && evict_session()) {
+    }
+
+    uint32_t index;
+    if (!free_sessions_.empty()) {
+        index = free_sessions_.back();
+        free_sessions_.pop_back();
+    } else {
+        index = static_cast<uint32_t>(sessions_.size());
+        sessions_.emplace_back();
+    }
+    QuicSession &session = sessions_[index];
+    session.key = key;
+    session.client_cid = scid;
+    session.bytes_received = 0;
+    session.bytes_sent = 0;
+    session.address_validated = false;
+    session.path_changes = 0;
+    session.path_window_start = now_tick_;
+    session.pending_hello = NO_PENDING_HELLO;
+    session.backend = maglev_.lookup(MaglevTable::hash({scid.data(), scid.size()}));
+    session.routed = initial_decryptor_ == nullptr;
+    session.active = true;
+    session.referenced = true;
+    session.last_active = now_tick_;
+    client_cids_.insert({scid.data(), scid.size()}, index);
+    client_cid_lengths_ |= 1U << scid.size();
+
+    const uint64_t timeout_ticks = static_cast<uint64_t>(options_.session_idle_timeout / SESSION_TIMER_TICK);
+    session_timers_.schedule(index, now_tick_ + timeout_ticks);
+
+    ++session_stats_.active;
+    ++session_stats_.created;
+    session_stats_.memory_bytes += session_footprint(session);
+    return index;
+}
+
+bool QuicUdpProxy::charge_amplification_budget(QuicSession &session, size_t n) noexcept {
+    if (session.address_validated) {
+        return true;
+    }
+    const uint64_t budget = std::min<uint64_t>(uint64_t{session.bytes_received} * AMPLIFICATION_FACTOR, UINT32_MAX);
+    if (session.bytes_sent + n > budget) {
+        ++session_stats_.amplification_dropped;
+        session_stats_.amplification_dropped_bytes += n;
+        return false;
+    }
+    session.bytes_sent += static_cast<uint32_t>(n);
+    return true;
+}
+
+void QuicUdpProxy::credit_amplification_budget(QuicSession &session, size_t n) noexcept {
+    if (!session.address_validated) {
+        session.bytes_received = static_cast<uint32_t>(
+            std::min<uint64_t>(uint64_t{session.bytes_received} + n, UINT32_MAX));
+    }
+}
+
+bool QuicUdpProxy::add_server_cid(uint32_t index, const uint8_t *cid, size_t len) {
+    QuicSession &session = sessions_[index];
+    if (session.server_cid_count >= MAX_SERVER_CIDS_PER_SESSION) {
+        return false;
+    }
+    if (!server_cids_.insert({cid, len}, index)) {
+        return false;
+    }
+    session.server_cids[session.server_cid_count++] = ConnectionId(cid, len);
+    server_cid_lengths_ |= 1U << len;
+    session_stats_.memory_bytes += CidTable::bytes_per_entry();
+    return true;
+}
+
+void QuicUdpProxy::remove_session(uint32_t index) noexcept {
+    QuicSession &session = sessions_[index];
+    if (!session.active) {
+        return;
+    }
+    session_stats_.memory_bytes -= std::min(session_stats_.memory_bytes, session_footprint(session));
+    client_cids_.erase({session.client_cid.data(), session.client_cid.size()});
+    for (uint8_t i = 0; i < session.server_cid_count; ++i) {
+        server_cids_.erase({session.server_cids[i].data(), session.server_cids[i].size()});
+    }
+    session_timers_.cancel(index);
+    if (session.pending_hello != NO_PENDING_HELLO) {
+        free_pending_hellos_.push_back(session.pending_hello);
+    }
+    session = QuicSession{};
+    free_sessions_.push_back(index);
+    --session_stats_.active;
+}
+
+void QuicUdpProxy::expire_sessions() noexcept {
+    now_tick_ = current_tick();
+    if (options_.forwarding == QuicForwardingMode::FlowNat) {
+        expire_flows();
+        return;
+    }
+    const uint64_t timeout_ticks = static_cast<uint64_t>(options_.session_idle_timeout / SESSION_TIMER_TICK);
+    session_timers_.advance(now_tick_, [this, timeout_ticks](uint32_t index) {
+        QuicSession &session = sessions_[index];
+        if (!session.active) {
+            return;
+        }
+        // Таймер не переставляется на каждом пакете: при срабатывании сверяем время последней активности
+        const uint64_t deadline = session.last_active + timeout_ticks;
+        if (deadline > now_tick_) {
+            session_timers_.schedule(index, deadline);
+            return;
+        }
+        LOG_INFO("Сессия {}:{} удалена по таймауту простоя",
+                 Ipv4Text(session.key.addr).text, ntohs(session.key.port));
+        remove_session(index);
+        ++session_stats_.expired;
+    });
+}
+
+bool QuicUdpProxy::evict_session() noexcept {
+    if (session_stats_.active == 0 || sessions_.empty()) {
+        return false;
+    }
+    // CLOCK: за два оборота стрелки найдётся сессия со сброшенным битом обращения
+    for (size_t step = 0; step < 2 * sessions_.size(); ++step) {
+        const uint32_t index = clock_hand_;
+        clock_hand_ = (clock_hand_ + 1) % static_cast<uint32_t>(sessions_.size());
+        QuicSession &session = sessions_[index];
+        if (!session.active) {
+            continue;
+        }
+        if (session.referenced) {
+            session.referenced = false;
+            continue;
+        }
+        LOG_WARN("Бюджет памяти сессий исчерпан — вытеснена сессия {}:{}",
+                 Ipv4Text(session.key.addr).text, ntohs(session.key.port));
+        remove_session(index);
+        ++session_stats_.evicted;
+        return true;
+    }
+    return false;
+}
+
+QuicSessionStats QuicUdpProxy::session_stats() const noexcept {
+    return session_stats_;
+}
+
+uint32_t QuicUdpProxy::create_flow(const sockaddr_in &client_addr) noexcept {
+    if (session_stats_.active >= options_.max_flows || epoll_fd_ == -1) {
+        ++session_stats_.rejected;
+        return CidTable::NOT_FOUND;
+    }
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+    if (fd < 0) {
+        LOG_ERROR("[ERROR] socket для потока {}:{} failed: {}",
+                  Ipv4Text(client_addr.sin_addr.s_addr).text, ntohs(client_addr.sin_port), strerror(errno));
+        ++session_stats_.rejected;
+        return CidTable::NOT_FOUND;
+    }
+    uint8_t key[6];
+    std::memcpy(key, &client_addr.sin_addr.s_addr, 4);
+    std::memcpy(key + 4, &client_addr.sin_port, 2);
+    const uint16_t backend = maglev_.lookup(MaglevTable::hash(key));
+    const sockaddr_in &backend_addr = backends_[backend];
+    // connect() выбирает эфемерный порт: ответы бэкенда приходят только на этот сокет
+    if (::connect(fd, reinterpret_cast<const sockaddr *>(&backend_addr), sizeof(backend_addr)) < 0) {
+        LOG_ERROR("[ERROR] connect потока к бэкенду failed: {}", strerror(errno));
+        ::close(fd);
+        ++session_stats_.rejected;
+        return CidTable::NOT_FOUND;
+    }
+    if (options_.udp_gso) {
+        (void)enable_udp_gro(fd);
+    }
+    struct epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = fd;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        LOG_ERROR("[ERROR] epoll_ctl ADD fd={} failed: {}", fd, strerror(errno));
+        ::close(fd);
+        ++session_stats_.rejected;
+        return CidTable::NOT_FOUND;
+    }
+
+    uint32_t index;
+    if (!free_flows_.empty()) {
+        index = free_flows_.back();
+        free_flows_.pop_back();
+    } else {
+        index = static_cast<uint32_t>(flows_.size());
+        flows_.emplace_back();
+    }
+    NatFlow &flow = flows_[index];
+    flow.client = client_addr;
+    flow.fd = fd;
+    flow.backend = backend;
+    flow.active = true;
+    flow.last_active = now_tick_;
+
+    flow_by_client_.insert(key, index);
+    if (static_cast<size_t>(fd) >= flow_by_fd_.size()) {
+        flow_by_fd_.resize(static_cast<size_t>(fd) + 1, CidTable::NOT_FOUND);
+    }
+    flow_by_fd_[fd] = index;
+
+    const uint64_t timeout_ticks = static_cast<uint64_t>(options_.session_idle_timeout / SESSION_TIMER_TICK);
+    flow_timers_.schedule(index, now_tick_ + timeout_ticks);
+    session_stats_.memory_bytes += sizeof(NatFlow) + CidTable::bytes_per_entry() + sizeof(uint32_t);
+    ++session_stats_.created;
+    ++session_stats_.active;
+    LOG_INFO("Новый поток flow NAT: {}:{} → fd {}",
+             Ipv4Text(client_addr.sin_addr.s_addr).text, ntohs(client_addr.sin_port), fd);
+    return index;
+}
+
+void QuicUdpProxy::remove_flow(uint32_t index) noexcept {
+    NatFlow &flow = flows_[index];
+    if (!flow.active) {
+        return;
+    }
+    uint8_t key[6];
+    std::memcpy(key, &flow.client.sin_addr.s_addr, 4);
+    std::memcpy(key + 4, &flow.client.sin_port, 2);
+    flow_by_client_.erase(key);
+    flow_by_fd_[flow.fd] = CidTable::NOT_FOUND;
+    ::close(flow.fd); // Закрытие снимает сокет с epoll
+    flow_timers_.cancel(index);
+    flow = NatFlow{};
+    free_flows_.push_back(index);
+    session_stats_.memory_bytes -= std::min(session_stats_.memory_bytes,
+                                            sizeof(NatFlow) + CidTable::bytes_per_entry() + sizeof(uint32_t));
+    --session_stats_.active;
+}
+
+void QuicUdpProxy::expire_flows() noexcept {
+    const uint64_t timeout_ticks = static_cast<uint64_t>(options_.session_idle_timeout / SESSION_TIMER_TICK);
+    flow_timers_.advance(now_tick_, [this, timeout_ticks](uint32_t index) {
+        NatFlow &flow = flows_[index];
+        if (!flow.active) {
+            return;
+        }
+        const uint64_t deadline = flow.last_active + timeout_ticks;
+        if (deadline > now_tick_) {
+            flow_timers_.schedule(index, deadline);
+            return;
+        }
+        LOG_INFO("Поток flow NAT {}:{} закрыт по таймауту простоя",
+                 Ipv4Text(flow.client.sin_addr.s_addr).text, ntohs(flow.client.sin_port));
+        remove_flow(index);
+        ++session_stats_.expired;
+    });
+}
+
+void QuicUdpProxy::forward_client_flow(const uint8_t *data, size_t len, size_t segment_size,
+                                       const sockaddr_in &client_addr) noexcept {
+    uint8_t key[6];
+    std::memcpy(key, &client_addr.sin_addr.s_addr, 4);
+    std::memcpy(key + 4, &client_addr.sin_port, 2);
+    uint32_t index = flow_by_client_.find(key);
+    if (index == CidTable::NOT_FOUND) {
+        if (admission_ && !admit_new_connection(client_addr)) {
+            return;
+        }
+        index = create_flow(client_addr);
+        if (index == CidTable::NOT_FOUND) {
+            return;
+        }
+    }
+    NatFlow &flow = flows_[index];
+    flow.last_active = now_tick_;
+    // GRO-буфер одного клиента уходит в его сокет одним sendmsg с теми же границами сегментов
+    (void)udp_send_segments(flow.fd, data, len, segment_size, backend_tx_.gso(), backend_stats_);
+}
+
+void QuicUdpProxy::drain_flow_socket(int fd) noexcept {
+    if (fd < 0 || static_cast<size_t>(fd) >= flow_by_fd_.size() || flow_by_fd_[fd] == CidTable::NOT_FOUND) {
+        return;
+    }
+    const uint32_t index = flow_by_fd_[fd];
+    while (running_) {
+        int count = backend_rx_.receive(fd, backend_stats_);
+        if (count < 0) {
+            if (errno == ECONNREFUSED || errno == EHOSTUNREACH || errno == ENETUNREACH) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOG_ERROR("recvmmsg flow fd={} failed: {}", fd, strerror(errno));
+            }
+            return;
+        }
+        NatFlow &flow = flows_[index];
+        if (count > 0) {
+            flow.last_active = now_tick_;
+        }
+        for (int i = 0; i < count; ++i) {
+            if (backend_rx_.truncated(i)) {
+                LOG_WARN("Датаграмма больше {} байт — отброшена", MAX_PACKET_SIZE);
+                continue;
+            }
+            const size_t len = backend_rx_.length(i);
+            const size_t segment = backend_rx_.segment_size(i) == 0 ? len : backend_rx_.segment_size(i);
+            for (size_t offset = 0; offset < len; offset += segment) {
+                queue_to_client(backend_rx_.data(i) + offset, std::min(segment, len - offset), flow.client);
+            }
+        }
+        flush_send_queues();
+        if (static_cast<size_t>(count) < backend_rx_.capacity()) {
+            return;
+        }
+    }
+}
+
+void QuicUdpProxy::forward_client_short_header(const uint8_t *buf, size_t n, const sockaddr_in &client_addr) noexcept {
+    // Длины CID обычно одна-две, поэтому перебор по маске — O(1) поисков без выделения памяти
+    for (uint32_t lengths = server_cid_lengths_; lengths != 0; lengths &= lengths - 1) {
+        const size_t len = static_cast<size_t>(std::countr_zero(lengths));
+        if (1 + len > n) {
+            break;
+        }
+        const uint32_t index = server_cids_.find({buf + 1, len});
+        if (index != CidTable::NOT_FOUND) {
+            QuicSession &session = sessions_[index];
+            touch_session(index);
+            (void)update_client_path(session, client_addr);
+            credit_amplification_budget(session, n);
+            queue_to_backend(buf, n, backends_[session.backend]);
+            return;
+        }
+    }
+
+    // QUIC-LB: бэкенд записан в самом CID — ни таблиц, ни состояния на соединение
+    if (quic_lb_ && n > quic_lb_->cid_length()) {
+        const uint64_t server = quic_lb_->decode_index({buf + 1, n - 1});
+        if (server < backends_.size()) {
+            ++routing_stats_.cid_routed;
+            queue_to_backend(buf, n, backends_[server]);
+            return;
+        }
+    }
+    LOG_DEBUG("Short Header с неизвестным DCID — отброшен");
+}
+
+bool QuicUdpProxy::update_client_path(QuicSession &session, const sockaddr_in &client_addr) noexcept {
+    if (session.key.addr == client_addr.sin_addr.s_addr && session.key.port == client_addr.sin_port) {
+        return false;
+    }
+    const uint64_t window = std::max<uint64_t>(
+        1, static_cast<uint64_t>(options_.path_change_window / SESSION_TIMER_TICK));
+    if (now_tick_ - session.path_window_start >= window) {
+        session.path_window_start = now_tick_;
+        session.path_changes = 0;
+    }
+    if (session.path_changes >= options_.max_path_changes) {
+        ++session_stats_.migration_limited;
+        return false;
+    }
+    ++session.path_changes;
+    ++session_stats_.migrated;
+    LOG_DEBUG("Смена адреса клиента: {}:{} → {}:{}", Ipv4Text(session.key.addr).text, ntohs(session.key.port),
+              Ipv4Text(client_addr.sin_addr.s_addr).text, ntohs(client_addr.sin_port));
+    session.key.addr = client_addr.sin_addr.s_addr;
+    session.key.port = client_addr.sin_port;
+    // Пакет с чужим адресом источника может прислать любой, кто знает CID:
+    // пока новый адрес не подтверждён, ответы ему ограничены лимитом 3x
+    session.bytes_received = 0;
+    session.bytes_sent = 0;
+    session.address_validated = false;
+    return true;
+}
+
+void QuicUdpProxy::forward_backend_short_header(const uint8_t *buf, size_t n) noexcept {
+    for (uint32_t lengths = client_cid_lengths_; lengths != 0; lengths &= lengths - 1) {
+        const size_t len = static_cast<size_t>(std::countr_zero(lengths));
+        if (1 + len > n) {
+            break;
+        }
+        const uint32_t index = client_cids_.find({buf + 1, len});
+        if (index != CidTable::NOT_FOUND) {
+            touch_session(index);
+            if (!charge_amplification_budget(sessions_[index], n)) {
+                LOG_DEBUG("Short Header сверх лимита 3x для неподтверждённого адреса — отброшен");
+                return;
+            }
+            const ClientKey &key = sessions_[index].key;
+            struct sockaddr_in client_dest{};
+            client_dest.sin_family = AF_INET;
+            client_dest.sin_addr.s_addr = key.addr;
+            client_dest.sin_port = key.port;
+            queue_to_client(buf, n, client_dest);
+            return;
+        }
+    }
+    LOG_DEBUG("Short Header от сервера с неизвестным DCID — отброшен");
+}
+
 void QuicUdpProxy::handle_client_packet(char *buf, ssize_t n, const sockaddr_in &client_addr, socklen_t client_len) noexcept {
     (void)client_len; // Подавление предупреждения "unused parameter"
 
-    std::string client_ip = inet_ntoa(client_addr.sin_addr);
+    // Горячий путь: 1-RTT пакеты пересылаются без разбора и логирования
+    if (n > 0 && (static_cast<uint8_t>(buf[0]) & 0x80) == 0) {
+        forward_client_short_header(reinterpret_cast<const uint8_t *>(buf), static_cast<size_t>(n), client_addr);
+        return;
+    }
+
+    const std::span<const uint8_t> packet(reinterpret_cast<const uint8_t *>(buf), static_cast<size_t>(n));
+    QuicHeaderView header;
+    const bool parsed = header.parse(packet);
+    if (!filter_client_long_header(reinterpret_cast<uint8_t *>(buf), packet.size(), header, parsed, client_addr)) {
+        return;
+    }
+
+    // Допуск новых соединений — до логов и любого состояния; пакеты живых сессий его не проходят.
+    // С Retry допуск — после проверки токена: Initial без токена получает только Retry без состояния,
+    // а иначе одно соединение расходовало бы два токена корзины
+    const bool new_connection = parsed && admission_ && header.type() == QuicPacketType::Initial &&
+                                client_cids_.find(header.scid()) == CidTable::NOT_FOUND;
+    if (new_connection && !retry_ && !admit_new_connection(client_addr)) {
+        return;
+    }
+
+    const Ipv4Text client_ip(client_addr.sin_addr.s_addr);
     uint16_t client_port = ntohs(client_addr.sin_port);
 
     LOG_INFO("=== [CLIENT → SERVER] ===");
     LOG_INFO("Получено {} байт от {}:{}",
              n,
-             client_ip.c_str(),
+             client_ip.text,
              client_port);
-    print_hex(reinterpret_cast<uint8_t *>(buf), static_cast<size_t>(n), "HEADER");
+    print_hex(packet.data(), packet.size(), "HEADER");
 
-    if (n < 6) {
-        LOG_WARN("Слишком короткий пакет ({}) байт", n);
-        return;
-    }
-
-    uint8_t packet_type = buf[0];
-
-    if ((packet_type & 0xC0) != 0xC0) {
-        LOG_DEBUG("Short Header — пропускаем");
+    if (!header.fixed_bit()) {
+        LOG_DEBUG("Long Header без фиксированного бита — пропускаем");
         return;
     }
 
     // Обработка Retry-пакета
-    if (n >= 9 && static_cast<unsigned char>(buf[0]) == 0xF0) {
+    if (header.type() == QuicPacketType::Retry) {
         LOG_INFO("Received Retry packet");
-        size_t token_offset = 9;
-        size_t token_len = buf[token_offset];
-        std::vector<uint8_t> token(buf + token_offset + 1, buf + token_offset + 1 + token_len);
-
-        ClientKey key{};
-        key.addr = client_addr.sin_addr.s_addr;
-        key.port = client_addr.sin_port;
-        std::memset(key.cid, 0, 8);
-        std::memcpy(key.cid, buf + 9, 8); // Первые 8 байт после токена — это SCID.
-
-        key.token = token;
-        session_map_[key] = key;
-
-        // Отправляем Retry-пакет клиенту
-        ssize_t sent = sendto(udp_fd_, buf, n, 0,
-                              (struct sockaddr *)&client_addr, sizeof(client_addr));
-        if (sent < 0) {
-            LOG_ERROR("sendto client failed: {}", strerror(errno));
-        } else {
-            LOG_INFO("Retry packet sent to client");
-        }
+        queue_to_client(packet.data(), packet.size(), client_addr);
+        LOG_INFO("Retry packet queued to client");
         return;
     }
 
-    uint32_t version = (buf[1] << 24) | (buf[2] << 16) | (buf[3] << 8) | buf[4];
-    size_t pos = 5;
-    uint8_t dcil = (buf[pos] >> 4) & 0x0F;
-    uint8_t scil = buf[pos] & 0x0F;
-
+    const std::span<const uint8_t> scid = header.scid();
     LOG_INFO("QUIC Версия: 0x{:08x}, DCIL={}, SCIL={}",
-             version,
-             static_cast<int>(dcil),
-             static_cast<int>(scil));
+             header.version(),
+             header.dcid().size(),
+             scid.size());
 
-    if (dcil == 0 || scil == 0 || pos + 2 + dcil + scil > static_cast<size_t>(n)) {
+    if (header.dcid().empty() || scid.empty()) {
         LOG_WARN("Некорректные CID длины");
         return;
     }
 
-    uint8_t *scid = reinterpret_cast<uint8_t *>(&buf[pos + 2 + dcil]);
+    if (retry_ && !validate_client_address(reinterpret_cast<uint8_t *>(buf), packet.size(), header, client_addr)) {
+        return;
+    }
+    if (new_connection && retry_ && !admit_new_connection(client_addr)) {
+        return;
+    }
 
     ClientKey key{};
     key.addr = client_addr.sin_addr.s_addr;
     key.port = client_addr.sin_port;
     std::memset(key.cid, 0, 8);
-    std::memcpy(key.cid, scid, std::min(static_cast<size_t>(scil), 8UL));
-
-    Deduplicator::PacketInfo info;
-    info.scid = std::vector<uint8_t>(scid, scid + scil);
-    info.token = {};
-
-    size_t cid_offset = pos + 2;
-    size_t pn_offset = cid_offset + dcil + scil;
-    if (pn_offset >= static_cast<size_t>(n)) {
-        LOG_WARN("Пакет слишком короткий для Packet Number");
-        return;
+    std::memcpy(key.cid, scid.data(), std::min(scid.size(), 8UL));
+
+    // Запись сессии с отпечатками недавних пакетов ищется по SCID клиента
+    bool new_session = false;
+    uint32_t index = client_cids_.find(scid);
+    if (index == CidTable::NOT_FOUND) {
+        index = create_session(key, ConnectionId(scid.data(), scid.size()));
+        new_session = true;
     }
-
-    uint64_t packet_number = 0;
-    for (size_t i = 0; i < 4 && pn_offset + i < static_cast<size_t>(n); ++i) {
-        packet_number = (packet_number << 8) | buf[pn_offset + i];
+    QuicSession &session = sessions_[index];
+    touch_session(index);
+
+    // Handshake потерянной сессии (перезапуск, другой поток) адресован CID сервера: бэкенд — из CID
+    if (new_session && quic_lb_ && header.type() == QuicPacketType::Handshake) {
+        const uint64_t server = quic_lb_->decode_index(header.dcid());
+        if (server < backends_.size()) {
+            session.backend = static_cast<uint16_t>(server);
+            session.routed = true;
+        }
     }
 
-    if (deduplicator_.is_duplicate(key, info.scid, info.token, packet_number)) {
+    // Склеенные пакеты (RFC 9000 §12.2) учитываются каждый: отпечатки, подтверждение адреса, ClientHello.
+    // Датаграмма повторная, только если все её пакеты — побайтовые копии недавних; пересылается она целиком и один раз
+    bool fresh = false;
+    bool handshake_to_server = false;
+    QuicHeaderView initial;
+    bool has_initial = false;
+    QuicPacketIterator packets(packet);
+    QuicHeaderView inner;
+    while (packets.next(inner)) {
+        if (!inner.is_long()) {
+            fresh = true; // 1-RTT — последний пакет датаграммы, его повторы отбрасывает сам бэкенд
+            break;
+        }
+        // Пакеты с другим DCID склеивать нельзя (RFC 9000 §12.2) — не учитываем их
+        if (packets.count() > 1 && !std::ranges::equal(inner.dcid(), header.dcid())) {
+            continue;
+        }
+        // Пакет неизвестной версии не разобрать дальше — пересылаем как есть
+        if (inner.packet_number_offset() == 0) {
+            fresh = true;
+            continue;
+        }
+        // Номер пакета под Header Protection — сравниваем отпечаток защищённых байтов пакета
+        if (!session.dedup.check_and_record(inner.packet())) {
+            fresh = true;
+        }
+        if (inner.type() == QuicPacketType::Handshake && server_cids_.find(inner.dcid()) == index) {
+            handshake_to_server = true;
+        } else if (inner.type() == QuicPacketType::Initial && !has_initial) {
+            initial = inner;
+            has_initial = true;
+        }
+    }
+    if (!fresh) {
         LOG_INFO("Повторный пакет — игнорируем");
         return;
     }
 
-    deduplicator_.add_packet(key, info);
-
-    auto it = session_map_.find(key);
-    if (it == session_map_.end()) {
-        session_map_[key] = key;
-        reverse_map_[info.scid] = key;
+    // Смену адреса update_client_path() сама пишет в лог (DEBUG) и считает в migrated
+    const bool path_changed = !new_session && update_client_path(session, client_addr);
+    if (new_session || path_changed) {
+        // Лимит 3x считается заново для нового адреса; при Retry сюда доходит только
+        // Initial с действительным токеном, то есть адрес уже подтверждён
+        session.address_validated = retry_ != nullptr;
+    }
+    if (new_session) {
         LOG_INFO("Новая сессия: {}:{} → SCID: {:02x}{:02x}{:02x}{:02x}{:02x}{:02x}{:02x}{:02x}",
-                 client_ip.c_str(),
+                 client_ip.text,
                  client_port,
                  key.cid[0],
                  key.cid[1],
@@ -334,7 +1237,7 @@ void QuicUdpProxy::handle_client_packet(char *buf, ssize_t n, const sockaddr_in
                  key.cid[5],
                  key.cid[6],
                  key.cid[7]);
-    } else {
+    } else if (!path_changed) {
         LOG_DEBUG("Reuse SCID: {:02x}{:02x}{:02x}{:02x}{:02x}{:02x}{:02x}{:02x}",
                   key.cid[0],
                   key.cid[1],
@@ -346,153 +1249,315 @@ void QuicUdpProxy::handle_client_packet(char *buf, ssize_t n, const sockaddr_in
                   key.cid[7]);
     }
 
-    if (it != session_map_.end() && !it->second.token.empty()) {
-        LOG_INFO("Adding token to packet for SCID: {:02x}{:02x}{:02x}{:02x}{:02x}{:02x}{:02x}{:02x}",
-                 key.cid[0], key.cid[1], key.cid[2], key.cid[3],
-                 key.cid[4], key.cid[5], key.cid[6], key.cid[7]);
-        if (static_cast<size_t>(n) < 9 + 1 + it->second.token.size()) {
-            LOG_WARN("Packet too short to add token");
-            return;
+    if (!session.address_validated) {
+        // Handshake на CID, выданный сервером этой сессии, может прислать только тот,
+        // кто получил ответ сервера, — владелец адреса (RFC 9000 §8.1)
+        if (handshake_to_server) {
+            session.address_validated = true;
+            LOG_DEBUG("Адрес клиента {}:{} подтверждён Handshake-пакетом", client_ip.text, client_port);
+        } else {
+            credit_amplification_budget(session, packet.size());
         }
-        buf[9] = static_cast<uint8_t>(it->second.token.size());
-        std::memcpy(buf + 10, it->second.token.data(), it->second.token.size());
-        n = std::max(n, 10 + static_cast<ssize_t>(it->second.token.size()));
+    }
+
+    if (!session.routed && !route_client_hello(index, has_initial ? initial : header, packet)) {
+        LOG_INFO("Датаграмма задержана до сборки ClientHello");
+        return;
     }
 
     LOG_INFO("Пакет до отправки в РФ:");
-    print_hex(reinterpret_cast<uint8_t *>(buf), static_cast<size_t>(n), "SEND_TO_RF");
-
-    struct sockaddr_in backend_addr{};
-    memset(&backend_addr, 0, sizeof(backend_addr));
-    backend_addr.sin_family = AF_INET;
-    inet_pton(AF_INET, backend_ip_.c_str(), &backend_addr.sin_addr);
-    backend_addr.sin_port = htons(backend_port_);
-
-    ssize_t sent = sendto(wg_fd_, buf, n, 0,
-                          (struct sockaddr *)&backend_addr, sizeof(backend_addr));
-    if (sent < 0) {
-        LOG_ERROR("sendto backend failed: {}", strerror(errno));
-    } else {
-        LOG_INFO("Переслано {} байт в РФ", sent);
+    print_hex(packet.data(), packet.size(), "SEND_TO_RF");
+
+    queue_to_backend(packet.data(), packet.size(), backends_[session.backend]);
+    LOG_INFO("Поставлено в очередь {} байт в РФ", n);
+}
+
+bool QuicUdpProxy::filter_client_long_header(uint8_t *buf, size_t n, const QuicHeaderView &header, bool parsed,
+                                             const sockaddr_in &client_addr) noexcept {
+    if (!parsed) {
+        ++edge_stats_.malformed;
+        return false;
+    }
+    if (header.type() == QuicPacketType::VersionNegotiation) {
+        // Клиент не отправляет Version Negotiation (RFC 9000 §6.1)
+        ++edge_stats_.client_negotiation;
+        return false;
     }
+
+    const uint32_t version = header.version();
+    const bool supported = header.type() != QuicPacketType::Unknown &&
+                           std::find(options_.supported_versions.begin(), options_.supported_versions.end(),
+                                     version) != options_.supported_versions.end();
+    if (!supported && options_.version_negotiation) {
+        // Отвечать на короткие датаграммы нельзя: иначе прокси — усилитель отражённых атак
+        if (n < MIN_INITIAL_DATAGRAM_SIZE) {
+            ++edge_stats_.unsupported_small;
+            return false;
+        }
+        // Ответ пишется поверх датаграммы, как Retry: буфер приёма живёт до сброса очереди
+        // У неизвестной версии CID бывают до 255 байт (RFC 9000 §17.2)
+        uint8_t dcid[UINT8_MAX];
+        uint8_t scid[UINT8_MAX];
+        const std::span<const uint8_t> client_dcid = header.dcid();
+        const std::span<const uint8_t> client_scid = header.scid();
+        std::memcpy(dcid, client_scid.data(), client_scid.size());
+        std::memcpy(scid, client_dcid.data(), client_dcid.size());
+        size_t pos = 0;
+        buf[pos++] = static_cast<uint8_t>(0x80 | (buf[0] & 0x7F));
+        std::memset(&buf[pos], 0, 4);
+        pos += 4;
+        buf[pos++] = static_cast<uint8_t>(client_scid.size());
+        std::memcpy(&buf[pos], dcid, client_scid.size());
+        pos += client_scid.size();
+        buf[pos++] = static_cast<uint8_t>(client_dcid.size());
+        std::memcpy(&buf[pos], scid, client_dcid.size());
+        pos += client_dcid.size();
+        std::memcpy(&buf[pos], vn_versions_.data(), vn_versions_.size());
+        pos += vn_versions_.size();
+        queue_to_client(buf, pos, client_addr);
+        ++edge_stats_.version_negotiation;
+        return false;
+    }
+    if (!supported) {
+        // Без Version Negotiation пакет уходит бэкенду, но таблицы сессий хранят CID не длиннее 20 байт
+        if (header.dcid().size() > MAX_CID_LENGTH || header.scid().size() > MAX_CID_LENGTH) {
+            ++edge_stats_.malformed;
+            return false;
+        }
+        return true;
+    }
+
+    if (header.type() == QuicPacketType::Initial && n < MIN_INITIAL_DATAGRAM_SIZE) {
+        ++edge_stats_.small_initial;
+        return false;
+    }
+    if (header.packet_number_offset() != 0 && header.length() < MIN_PROTECTED_LENGTH) {
+        ++edge_stats_.bad_length;
+        return false;
+    }
+    return true;
 }
 
-void QuicUdpProxy::handle_backend_packet(char *buf, ssize_t n, const sockaddr_in &backend_addr, socklen_t backend_len) noexcept {
-    (void)backend_addr; // Подавление предупреждения "unused parameter"
-    (void)backend_len; // Подавление предупреждения "unused parameter"
+bool QuicUdpProxy::route_client_hello(uint32_t index, const QuicHeaderView &header,
+                                      std::span<const uint8_t> packet) noexcept {
+    QuicSession &session = sessions_[index];
+    if (session.pending_hello == NO_PENDING_HELLO) {
+        if (!free_pending_hellos_.empty()) {
+            session.pending_hello = free_pending_hellos_.back();
+            free_pending_hellos_.pop_back();
+        } else if (pending_hellos_.size() < options_.max_pending_client_hellos) {
+            session.pending_hello = static_cast<uint32_t>(pending_hellos_.size());
+            pending_hellos_.emplace_back();
+        } else {
+            ++routing_stats_.overflow;
+            pin_session(index, session.backend);
+            return true;
+        }
+        PendingClientHello &fresh = pending_hellos_[session.pending_hello];
+        fresh.keys_dcid = ConnectionId{};
+        fresh.crypto.reset();
+        fresh.held_count = 0;
+        fresh.held_bytes = 0;
+    }
+    PendingClientHello &pending = pending_hellos_[session.pending_hello];
+
+    if (header.type() == QuicPacketType::Initial) {
+        // Ключи выводятся один раз на соединение (заново — только если клиент сменил DCID)
+        const ConnectionId dcid(header.dcid().data(), header.dcid().size());
+        if (!(pending.keys_dcid == dcid)) {
+            if (!initial_decryptor_->derive_keys(header.version(), header.dcid(), pending.keys)) {
+                ++routing_stats_.fallback;
+                pin_session(index, session.backend);
+                return true;
+            }
+            pending.keys_dcid = dcid;
+        }
+        if (!initial_decryptor_->open(header, pending.keys, pending.crypto) || pending.crypto.malformed()) {
+            LOG_DEBUG("Initial не расшифрован или не содержит ClientHello — бэкенд по Maglev");
+            ++routing_stats_.fallback;
+            pin_session(index, session.backend);
+            return true;
+        }
+        const std::span<const uint8_t> message = pending.crypto.client_hello();
+        if (!message.empty()) {
+            QuicClientHelloInfo info;
+            if (!parse_client_hello(message, info)) {
+                LOG_DEBUG("ClientHello не разобран — бэкенд по Maglev");
+                ++routing_stats_.fallback;
+                pin_session(index, session.backend);
+                return true;
+            }
+            const size_t backend = options_.route_client_hello(info);
+            LOG_INFO("ClientHello: SNI '{}' → бэкенд {}", info.server_name, backend);
+            ++routing_stats_.routed;
+            pin_session(index, backend);
+            return true;
+        }
+    }
 
-    LOG_INFO("Пакет после получения от РФ:");
-    print_hex(reinterpret_cast<uint8_t *>(buf), static_cast<size_t>(n), "RECV_FROM_RF");
-    LOG_INFO("=== [SERVER → CLIENT] ===");
-    LOG_INFO("Получено {} байт от сервера", n);
-    print_hex(reinterpret_cast<uint8_t *>(buf), static_cast<size_t>(n), "REPLY_HEADER");
+    // ClientHello ещё не собран: датаграмма копируется и уйдёт вместе с последней
+    if (pending.held_count == MAX_HELD_DATAGRAMS || packet.size() > HELD_DATAGRAM_BYTES - pending.held_bytes) {
+        ++routing_stats_.overflow;
+        pin_session(index, session.backend);
+        return true;
+    }
+    std::memcpy(pending.held + pending.held_bytes, packet.data(), packet.size());
+    pending.held_sizes[pending.held_count++] = static_cast<uint16_t>(packet.size());
+    pending.held_bytes += packet.size();
+    ++routing_stats_.held;
+    return false;
+}
 
-    if (n < 6) {
-        LOG_WARN("Слишком короткий пакет ({}) байт", n);
+void QuicUdpProxy::pin_session(uint32_t index, size_t backend) noexcept {
+    QuicSession &session = sessions_[index];
+    // Недоступный бэкенд обработчика заменяется выбором Maglev (он учитывает проверку)
+    if (backend < backends_.size() && (!health_ || health_->is_up(backend))) {
+        session.backend = static_cast<uint16_t>(backend);
+    }
+    session.routed = true;
+    if (session.pending_hello == NO_PENDING_HELLO) {
         return;
     }
 
-    uint8_t packet_type = buf[0];
-
-    // Обработка Retry-пакета
-    if ((packet_type & 0xF0) == 0xF0) {
-        LOG_INFO("Received Retry packet from server");
-        if (n < 9) {
-            LOG_WARN("Retry packet too short");
-            return;
+    // Задержанные датаграммы уходят сразу через sendto: ядро копирует их до возврата,
+    // поэтому запись освобождается, не дожидаясь сброса очереди (sendmmsg или io_uring)
+    PendingClientHello &pending = pending_hellos_[session.pending_hello];
+    const sockaddr_in &dest = backends_[session.backend];
+    size_t offset = 0;
+    for (uint8_t i = 0; i < pending.held_count; ++i) {
+        ++backend_stats_.tx_syscalls;
+        if (sendto(wg_fd_, pending.held + offset, pending.held_sizes[i], 0,
+                   reinterpret_cast<const sockaddr *>(&dest), sizeof(dest)) < 0) {
+            LOG_WARN("Задержанная датаграмма не отправлена: {}", strerror(errno));
+        } else {
+            ++backend_stats_.tx_packets;
         }
-        size_t pos = 5;
-        uint8_t dcil = (buf[pos] >> 4) & 0x0F;
-        uint8_t scil = buf[pos] & 0x0F;
-        LOG_INFO("Retry packet: DCIL={}, SCIL={}", static_cast<int>(dcil), static_cast<int>(scil));
+        offset += pending.held_sizes[i];
+    }
+    free_pending_hellos_.push_back(session.pending_hello);
+    session.pending_hello = NO_PENDING_HELLO;
+}
 
-        size_t min_retry_size = pos + 1 + dcil + scil + 1;
-        if (static_cast<size_t>(n) < min_retry_size) {
-            LOG_WARN("Retry packet too short for CID fields");
-            return;
-        }
+bool QuicUdpProxy::admit_new_connection(const sockaddr_in &client_addr) noexcept {
+    const uint64_t now_ms = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                      std::chrono::steady_clock::now().time_since_epoch())
+                                                      .count());
+    if (admission_->admit_ipv4(client_addr.sin_addr.s_addr, now_ms)) {
+        return true;
+    }
+    ++session_stats_.admission_dropped;
+    return false;
+}
 
-        uint8_t *scid = reinterpret_cast<uint8_t *>(&buf[pos + 1 + dcil]);
-        size_t token_offset = pos + 1 + dcil + scil;
-        size_t token_len = buf[token_offset];
-        if (token_offset + 1 + token_len > static_cast<size_t>(n)) {
-            LOG_WARN("Invalid token length in Retry packet");
-            return;
-        }
-        std::vector<uint8_t> token(buf + token_offset + 1, buf + token_offset + 1 + token_len);
+bool QuicUdpProxy::validate_client_address(uint8_t *buf, size_t n, const QuicHeaderView &header,
+                                           const sockaddr_in &client_addr) noexcept {
+    const uint32_t index = client_cids_.find(header.scid());
+    if (index != CidTable::NOT_FOUND && sessions_[index].key.addr == client_addr.sin_addr.s_addr) {
+        return true;
+    }
+    if (header.type() != QuicPacketType::Initial) {
+        LOG_DEBUG("Long Header без подтверждённого адреса — отброшен");
+        ++retry_stats_.invalid;
+        return false;
+    }
 
-        ClientKey key{};
-        key.addr = 0; // Неизвестно, нужно получить из reverse_map
-        key.port = 0;
-        std::memset(key.cid, 0, 8);
-        std::memcpy(key.cid, scid, std::min(static_cast<size_t>(scil), 8UL));
-        key.token = token;
+    switch (retry_->validate(header, client_addr.sin_addr.s_addr)) {
+    case RetryTokenStatus::Valid:
+        ++retry_stats_.validated;
+        return true;
+    case RetryTokenStatus::Invalid:
+        LOG_WARN("Недействительный Retry-токен от {} — отброшен", Ipv4Text(client_addr.sin_addr.s_addr).text);
+        ++retry_stats_.invalid;
+        return false;
+    case RetryTokenStatus::Expired:
+        ++retry_stats_.expired;
+        break;
+    case RetryTokenStatus::Missing:
+    case RetryTokenStatus::Foreign:
+        break;
+    }
 
-        // Поиск ключа клиента по SCID
-        auto it = reverse_map_.find(std::vector<uint8_t>(scid, scid + scil));
-        if (it == reverse_map_.end()) {
-            LOG_WARN("Неизвестный SCID — пакет потерялся");
-            return;
-        }
-        key = it->second;
+    // Retry пишется поверх Initial: буфер приёма живёт до сброса очереди отправки,
+    // а ответ никогда не больше запроса
+    uint8_t retry[MAX_RETRY_PACKET_SIZE];
+    const size_t retry_len = retry_->build_retry(header, client_addr.sin_addr.s_addr, retry);
+    if (retry_len == 0 || retry_len > n) {
+        LOG_DEBUG("Retry не отправлен (версия 0x{:08x}, датаграмма {} байт)", header.version(), n);
+        return false;
+    }
+    std::memcpy(buf, retry, retry_len);
+    queue_to_client(buf, retry_len, client_addr);
+    ++retry_stats_.sent;
+    LOG_INFO("Отправлен Retry клиенту {}:{}", Ipv4Text(client_addr.sin_addr.s_addr).text, ntohs(client_addr.sin_port));
+    return false;
+}
 
-        session_map_[key] = key;
-        LOG_INFO("Saved Retry token for client: SCID={:02x}{:02x}{:02x}{:02x}{:02x}{:02x}{:02x}{:02x}",
-                 key.cid[0], key.cid[1], key.cid[2], key.cid[3],
-                 key.cid[4], key.cid[5], key.cid[6], key.cid[7]);
+void QuicUdpProxy::handle_backend_packet(char *buf, ssize_t n, const sockaddr_in &backend_addr, socklen_t backend_len) noexcept {
+    (void)backend_addr; // Подавление предупреждения "unused parameter"
+    (void)backend_len; // Подавление предупреждения "unused parameter"
 
-        struct sockaddr_in client_dest{};
-        client_dest.sin_family = AF_INET;
-        client_dest.sin_addr.s_addr = key.addr;
-        client_dest.sin_port = key.port;
+    // Горячий путь: 1-RTT пакеты пересылаются без разбора и логирования
+    if (n > 0 && (static_cast<uint8_t>(buf[0]) & 0x80) == 0) {
+        forward_backend_short_header(reinterpret_cast<const uint8_t *>(buf), static_cast<size_t>(n));
+        return;
+    }
 
-        ssize_t sent = sendto(udp_fd_, buf, n, 0,
-                              (struct sockaddr *)&client_dest, sizeof(client_dest));
-        if (sent < 0) {
-            LOG_ERROR("sendto client failed: {}", strerror(errno));
-        } else {
-            LOG_INFO("Retry packet sent to client");
-        }
+    const std::span<const uint8_t> packet(reinterpret_cast<const uint8_t *>(buf), static_cast<size_t>(n));
+    LOG_INFO("=== [SERVER → CLIENT] ===");
+    LOG_INFO("Получено {} байт от сервера", n);
+    print_hex(packet.data(), packet.size(), "REPLY_HEADER");
+
+    QuicHeaderView header;
+    if (!header.parse(packet)) {
+        LOG_WARN("Некорректный Long Header от сервера ({} байт)", n);
         return;
     }
 
-    // Обработка обычных Long Header пакетов
-    if ((packet_type & 0xC0) == 0xC0) {
-        size_t pos = 5;
-        uint8_t dcil = (buf[pos] >> 4) & 0x0F;
-        uint8_t scil = buf[pos] & 0x0F;
-        LOG_INFO("Long Header: DCIL={}, SCIL={}", static_cast<int>(dcil), static_cast<int>(scil));
+    // У Version Negotiation фиксированный бит произвольный
+    if (header.type() != QuicPacketType::VersionNegotiation && !header.fixed_bit()) {
+        LOG_DEBUG("Long Header без фиксированного бита — пропускаем");
+        return;
+    }
 
-        if (pos + 1 + dcil + scil > static_cast<size_t>(n)) {
-            LOG_WARN("Некорректные CID длины: dcil={}, scil={}, packet_size={}",
-                     dcil, scil, n);
-            return;
+    // Ответы сервера (включая Retry и Version Negotiation) адресованы SCID клиента
+    LOG_INFO("Long Header: DCIL={}, SCIL={}", header.dcid().size(), header.scid().size());
+    const uint32_t index = client_cids_.find(header.dcid());
+    if (index == CidTable::NOT_FOUND) {
+        LOG_WARN("Неизвестный DCID — пакет потерялся");
+        return;
+    }
+    const ClientKey &key = sessions_[index].key;
+    touch_session(index);
+
+    if (header.type() == QuicPacketType::Retry) {
+        LOG_INFO("Received Retry packet from server: токен {} байт", header.token().size());
+    } else if (header.type() != QuicPacketType::VersionNegotiation) {
+        // SCID — CID, выбранный сервером: по нему клиент адресует Short Header пакеты.
+        // Просматриваются все склеенные Long Header пакеты (Initial + Handshake)
+        QuicPacketIterator packets(packet);
+        QuicHeaderView inner;
+        while (packets.next(inner) && inner.is_long()) {
+            const std::span<const uint8_t> server_cid = inner.scid();
+            if (!server_cid.empty() && add_server_cid(index, server_cid.data(), server_cid.size())) {
+                LOG_INFO("Новый CID сервера (длина {}) для клиента {}:{}",
+                         server_cid.size(), Ipv4Text(key.addr).text, ntohs(key.port));
+            }
         }
+    }
 
-        uint8_t *dcid = reinterpret_cast<uint8_t *>(&buf[pos + 1]);
-        auto it = reverse_map_.find(std::vector<uint8_t>(dcid, dcid + dcil));
-        if (it == reverse_map_.end()) {
-            LOG_WARN("Неизвестный DCID — пакет потерялся");
-            return;
-        }
-        ClientKey key = it->second;
+    if (!charge_amplification_budget(sessions_[index], packet.size())) {
+        LOG_DEBUG("Пакет сервера сверх лимита 3x для неподтверждённого адреса — отброшен");
+        return;
+    }
 
-        struct sockaddr_in client_dest{};
-        client_dest.sin_family = AF_INET;
-        client_dest.sin_addr.s_addr = key.addr;
-        client_dest.sin_port = key.port;
+    struct sockaddr_in client_dest{};
+    client_dest.sin_family = AF_INET;
+    client_dest.sin_addr.s_addr = key.addr;
+    client_dest.sin_port = key.port;
 
-        ssize_t sent = sendto(udp_fd_, buf, n, 0,
-                              (struct sockaddr *)&client_dest, sizeof(client_dest));
-        if (sent < 0) {
-            LOG_ERROR("sendto client failed: {}", strerror(errno));
-        } else {
-            LOG_INFO("Отправлено {} байт клиенту {}:{}",
-                     sent,
-                     inet_ntoa(client_dest.sin_addr),
-                     ntohs(client_dest.sin_port));
-        }
-    } else {
-        LOG_DEBUG("Short Header — пропускаем");
-    }
-}
\ No newline at end of file
+    queue_to_client(packet.data(), packet.size(), client_dest);
+    LOG_INFO("Поставлено в очередь {} байт клиенту {}:{}",
+             n,
+             Ipv4Text(key.addr).text,
+             ntohs(client_dest.sin_port));
+}
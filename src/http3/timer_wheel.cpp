@@ -0,0 +1,147 @@
+// src/http3/timer_wheel.cpp
+/**
+ * @file timer_wheel.cpp
+ * @brief Реализация иерархического колеса таймеров.
+ *
+ * @author Telian Edward <telianedward@icloud.com>
+ * @assisted-by AI-Assistant
+ * @date 2025-11-14
+ * @version 1.0
+ * @license MIT
+ */
+#include "../../include/http3/timer_wheel.hpp"
+
+TimerWheel::TimerWheel(uint64_t start_tick)
+    : next_tick_(start_tick),
+      heads_(LEVELS * SLOTS, NONE) {}
+
+void TimerWheel::link(uint32_t id) noexcept
+{
+    Node &node = nodes_[id];
+    const uint64_t delta = node.deadline - next_tick_;
+    // Уровень — по расстоянию до срока, слот — по соответствующим битам самого срока
+    unsigned level = 0;
+    while (level + 1 < LEVELS && delta >= (uint64_t{1} << (SLOT_BITS * (level + 1))))
+    {
+        ++level;
+    }
+    const uint32_t slot = level * SLOTS + static_cast<uint32_t>((node.deadline >> (SLOT_BITS * level)) & (SLOTS - 1));
+
+    node.slot = slot;
+    node.prev = NONE;
+    node.next = heads_[slot];
+    if (node.next != NONE)
+    {
+        nodes_[node.next].prev = id;
+    }
+    heads_[slot] = id;
+}
+
+void TimerWheel::unlink(uint32_t id) noexcept
+{
+    Node &node = nodes_[id];
+    if (node.prev != NONE)
+    {
+        nodes_[node.prev].next = node.next;
+    }
+    else
+    {
+        heads_[node.slot] = node.next;
+    }
+    if (node.next != NONE)
+    {
+        nodes_[node.next].prev = node.prev;
+    }
+    node.prev = NONE;
+    node.next = NONE;
+    node.slot = NONE;
+}
+
+void TimerWheel::schedule(uint32_t id, uint64_t deadline_tick)
+{
+    if (id == NONE)
+    {
+        return;
+    }
+    if (id >= nodes_.size())
+    {
+        nodes_.resize(static_cast<size_t>(id) + 1);
+    }
+    if (nodes_[id].slot != NONE)
+    {
+        unlink(id);
+    }
+    else
+    {
+        ++size_;
+    }
+    if (deadline_tick < next_tick_)
+    {
+        deadline_tick = next_tick_;
+    }
+    if (deadline_tick - next_tick_ > MAX_DELAY)
+    {
+        deadline_tick = next_tick_ + MAX_DELAY;
+    }
+    nodes_[id].deadline = deadline_tick;
+    link(id);
+}
+
+void TimerWheel::cancel(uint32_t id) noexcept
+{
+    if (!scheduled(id))
+    {
+        return;
+    }
+    unlink(id);
+    --size_;
+}
+
+void TimerWheel::cascade(unsigned level) noexcept
+{
+    // Переносим таймеры слота верхнего уровня, срок которых наступает в ближайшем обороте нижнего
+    const uint32_t slot = level * SLOTS + static_cast<uint32_t>((next_tick_ >> (SLOT_BITS * level)) & (SLOTS - 1));
+    uint32_t id = heads_[slot];
+    heads_[slot] = NONE;
+    while (id != NONE)
+    {
+        const uint32_t next = nodes_[id].next;
+        link(id);
+        id = next;
+    }
+}
+
+size_t TimerWheel::advance(uint64_t now_tick, const std::function<void(uint32_t)> &on_expire)
+{
+    size_t expired = 0;
+    while (next_tick_ <= now_tick)
+    {
+        // Начало оборота уровня — подтягиваем следующий слот уровня выше (и так далее вверх)
+        for (unsigned level = 1; level < LEVELS; ++level)
+        {
+            if ((next_tick_ & ((uint64_t{1} << (SLOT_BITS * level)) - 1)) != 0)
+            {
+                break;
+            }
+            cascade(level);
+        }
+
+        const uint32_t slot = static_cast<uint32_t>(next_tick_ & (SLOTS - 1));
+        uint32_t id;
+        while ((id = heads_[slot]) != NONE)
+        {
+            unlink(id);
+            --size_;
+            ++expired;
+            on_expire(id);
+        }
+        ++next_tick_;
+
+        // Колесо пусто — догонять по одному тику незачем
+        if (size_ == 0 && next_tick_ <= now_tick)
+        {
+            next_tick_ = now_tick + 1;
+        }
+    }
+    return expired;
+}
@@ -0,0 +1,349 @@
+// src/http3/udp_batch.cpp
+/**
+ * @file udp_batch.cpp
+ * @brief Реализация пакетного ввода-вывода UDP через recvmmsg/sendmmsg.
+ *
+ * @author Telian Edward <telianedward@icloud.com>
+ * @assisted-by AI-Assistant
+ * @date 2025-11-10
+ * @version 1.0
+ * @license MIT
+ */
+#include "../../include/http3/udp_batch.hpp"
+#include "../../include/logger/logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <netinet/udp.h>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+bool enable_udp_gro(int fd) noexcept
+{
+    int on = 1;
+    return setsockopt(fd, IPPROTO_UDP, UDP_GRO, &on, sizeof(on)) == 0;
+}
+
+bool udp_gso_supported(int fd) noexcept
+{
+    // Нулевой размер сегмента — GSO по умолчанию выключен, но опция известна ядру
+    int zero = 0;
+    return setsockopt(fd, IPPROTO_UDP, UDP_SEGMENT, &zero, sizeof(zero)) == 0;
+}
+
+size_t udp_gro_segment_size(const msghdr &msg) noexcept
+{
+    if (msg.msg_control == nullptr || msg.msg_controllen < sizeof(cmsghdr))
+    {
+        return 0;
+    }
+    for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(const_cast<msghdr *>(&msg), cmsg))
+    {
+        if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO)
+        {
+            int size = 0;
+            std::memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+            return size > 0 ? static_cast<size_t>(size) : 0;
+        }
+    }
+    return 0;
+}
+
+double UdpBatchStats::rx_packets_per_syscall() const noexcept
+{
+    return rx_syscalls == 0 ? 0.0 : static_cast<double>(rx_packets) / static_cast<double>(rx_syscalls);
+}
+
+double UdpBatchStats::tx_packets_per_syscall() const noexcept
+{
+    return tx_syscalls == 0 ? 0.0 : static_cast<double>(tx_packets) / static_cast<double>(tx_syscalls);
+}
+
+// === UdpRecvBatch ===
+
+UdpRecvBatch::UdpRecvBatch(size_t batch_size, size_t buffer_size)
+    : batch_size_(batch_size == 0 ? 1 : batch_size),
+      buffer_size_(buffer_size),
+      buffers_(batch_size_ * buffer_size_),
+      addrs_(batch_size_),
+      iovs_(batch_size_),
+      controls_(batch_size_),
+      segment_sizes_(batch_size_),
+      msgs_(batch_size_)
+{
+    for (size_t i = 0; i < batch_size_; ++i)
+    {
+        iovs_[i].iov_base = buffers_.data() + i * buffer_size_;
+        iovs_[i].iov_len = buffer_size_;
+    }
+}
+
+int UdpRecvBatch::receive(int fd, UdpBatchStats &stats) noexcept
+{
+    // recvmmsg перезаписывает msg_namelen и msg_flags — восстанавливаем заголовки перед каждым вызовом
+    for (size_t i = 0; i < batch_size_; ++i)
+    {
+        std::memset(&msgs_[i], 0, sizeof(mmsghdr));
+        msgs_[i].msg_hdr.msg_name = &addrs_[i];
+        msgs_[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        msgs_[i].msg_hdr.msg_iov = &iovs_[i];
+        msgs_[i].msg_hdr.msg_iovlen = 1;
+        msgs_[i].msg_hdr.msg_control = controls_[i].data;
+        msgs_[i].msg_hdr.msg_controllen = sizeof(controls_[i].data);
+    }
+
+    int n = recvmmsg(fd, msgs_.data(), static_cast<unsigned int>(batch_size_), MSG_DONTWAIT, nullptr);
+    ++stats.rx_syscalls;
+    if (n < 0)
+    {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            return 0;
+        }
+        return -1;
+    }
+    for (int i = 0; i < n; ++i)
+    {
+        const size_t len = msgs_[i].msg_len;
+        size_t segment = udp_gro_segment_size(msgs_[i].msg_hdr);
+        if (segment == 0 || segment >= len)
+        {
+            segment = len;
+        }
+        else
+        {
+            ++stats.rx_gro;
+        }
+        segment_sizes_[i] = segment;
+        stats.rx_packets += segment == 0 ? 1 : (len + segment - 1) / segment;
+    }
+    return n;
+}
+
+// === UdpSendBatch ===
+
+UdpSendBatch::UdpSendBatch(size_t batch_size)
+    : batch_size_(batch_size == 0 ? 1 : batch_size),
+      addrs_(batch_size_),
+      iovs_(batch_size_),
+      entries_(batch_size_),
+      msgs_(batch_size_) {}
+
+bool UdpSendBatch::try_append_segment(const uint8_t *data, size_t len, const sockaddr_in &dest) noexcept
+{
+    if (!gso_ || count_ == 0)
+    {
+        return false;
+    }
+    const size_t last = count_ - 1;
+    Entry &entry = entries_[last];
+    iovec &iov = iovs_[last];
+    const sockaddr_in &addr = addrs_[last];
+    // Сегмент можно дописать, только если он продолжает данные в памяти (без копирования),
+    // не длиннее первого и все предыдущие сегменты полные — иначе границы исказятся
+    if (static_cast<const uint8_t *>(iov.iov_base) + iov.iov_len != data ||
+        len == 0 || len > entry.segment_size ||
+        iov.iov_len != entry.segment_size * entry.segments ||
+        entry.segments >= UDP_GSO_MAX_SEGMENTS ||
+        iov.iov_len + len > UDP_GSO_MAX_BYTES ||
+        addr.sin_addr.s_addr != dest.sin_addr.s_addr || addr.sin_port != dest.sin_port)
+    {
+        return false;
+    }
+
+    iov.iov_len += len;
+    ++entry.segments;
+    if (entry.segments == 2)
+    {
+        msghdr &hdr = msgs_[last].msg_hdr;
+        hdr.msg_control = entry.control;
+        hdr.msg_controllen = sizeof(entry.control);
+        cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+        cmsg->cmsg_level = IPPROTO_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        const auto segment = static_cast<uint16_t>(entry.segment_size);
+        std::memcpy(CMSG_DATA(cmsg), &segment, sizeof(segment));
+        hdr.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+    }
+    return true;
+}
+
+size_t udp_send_segments(int fd, const uint8_t *data, size_t len, size_t segment_size, bool gso,
+                         UdpBatchStats &stats) noexcept
+{
+    const size_t step = segment_size == 0 || segment_size > len ? len : segment_size;
+    const size_t per_message = gso && step < len
+                                   ? std::min(UDP_GSO_MAX_SEGMENTS, std::max<size_t>(1, UDP_GSO_MAX_BYTES / step))
+                                   : 1;
+    size_t sent = 0;
+    size_t offset = 0;
+    while (offset < len)
+    {
+        const size_t chunk = std::min(len - offset, per_message * step);
+        const size_t segments = (chunk + step - 1) / step;
+
+        iovec iov{const_cast<uint8_t *>(data + offset), chunk};
+        msghdr hdr{};
+        hdr.msg_iov = &iov;
+        hdr.msg_iovlen = 1;
+        alignas(cmsghdr) uint8_t control[CMSG_SPACE(sizeof(uint16_t))]{};
+        if (segments > 1)
+        {
+            hdr.msg_control = control;
+            hdr.msg_controllen = sizeof(control);
+            cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+            cmsg->cmsg_level = IPPROTO_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            const auto segment = static_cast<uint16_t>(step);
+            std::memcpy(CMSG_DATA(cmsg), &segment, sizeof(segment));
+        }
+
+        const ssize_t result = sendmsg(fd, &hdr, MSG_DONTWAIT);
+        ++stats.tx_syscalls;
+        if (result < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (segments > 1 && (errno == EIO || errno == EINVAL))
+            {
+                // Маршрут не принимает GSO — остаток отправляем по одной датаграмме
+                return sent + udp_send_segments(fd, data + offset, len - offset, step, false, stats);
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNREFUSED)
+            {
+                LOG_ERROR("sendmsg failed: {}", strerror(errno));
+            }
+            break;
+        }
+        sent += segments;
+        if (segments > 1)
+        {
+            ++stats.tx_gso;
+        }
+        offset += chunk;
+    }
+    stats.tx_packets += sent;
+    return sent;
+}
+
+bool UdpSendBatch::push(const uint8_t *data, size_t len, const sockaddr_in &dest) noexcept
+{
+    if (try_append_segment(data, len, dest))
+    {
+        return true;
+    }
+    if (count_ == batch_size_)
+    {
+        return false;
+    }
+    addrs_[count_] = dest;
+    iovs_[count_].iov_base = const_cast<uint8_t *>(data);
+    iovs_[count_].iov_len = len;
+
+    mmsghdr &msg = msgs_[count_];
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_hdr.msg_name = &addrs_[count_];
+    msg.msg_hdr.msg_namelen = sizeof(sockaddr_in);
+    msg.msg_hdr.msg_iov = &iovs_[count_];
+    msg.msg_hdr.msg_iovlen = 1;
+    entries_[count_].segment_size = len;
+    entries_[count_].segments = 1;
+    ++count_;
+    return true;
+}
+
+size_t UdpSendBatch::flush(int fd, UdpBatchStats &stats) noexcept
+{
+    size_t offset = 0;
+    size_t total = 0;
+    while (offset < count_)
+    {
+        int sent = sendmmsg(fd, msgs_.data() + offset, static_cast<unsigned int>(count_ - offset), MSG_DONTWAIT);
+        ++stats.tx_syscalls;
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                // Буфер сокета заполнен — UDP допускает потери, остаток очереди отбрасываем
+                LOG_WARN("sendmmsg: буфер сокета заполнен, отброшено {} датаграмм", count_ - offset);
+                break;
+            }
+            if (entries_[offset].segments > 1 && (errno == EIO || errno == EINVAL))
+            {
+                // Устройство или маршрут не принимает GSO — это сообщение и дальнейшие
+                // отправляем по одной датаграмме, не теряя уже склеенные сегменты
+                if (gso_)
+                {
+                    LOG_WARN("UDP GSO отклонён ядром — склейка сегментов выключена");
+                    gso_ = false;
+                }
+                total += send_unsegmented(fd, offset, stats);
+                ++offset;
+                continue;
+            }
+            // Ошибка относится к первому сообщению в очереди — пропускаем его и продолжаем
+            LOG_ERROR("sendmmsg failed: {}", strerror(errno));
+            ++offset;
+            continue;
+        }
+        for (size_t i = offset; i < offset + static_cast<size_t>(sent); ++i)
+        {
+            total += entries_[i].segments;
+            if (entries_[i].segments > 1)
+            {
+                ++stats.tx_gso;
+            }
+        }
+        offset += static_cast<size_t>(sent);
+    }
+    stats.tx_packets += total;
+    count_ = 0;
+    return total;
+}
+
+size_t UdpSendBatch::send_unsegmented(int fd, size_t i, UdpBatchStats &stats) noexcept
+{
+    const auto *data = static_cast<const uint8_t *>(iovs_[i].iov_base);
+    const size_t len = iovs_[i].iov_len;
+    const size_t step = entries_[i].segment_size;
+    size_t sent = 0;
+    for (size_t offset = 0; offset < len;)
+    {
+        iovec iov{const_cast<uint8_t *>(data + offset), std::min(step, len - offset)};
+        msghdr hdr{};
+        hdr.msg_name = &addrs_[i];
+        hdr.msg_namelen = sizeof(sockaddr_in);
+        hdr.msg_iov = &iov;
+        hdr.msg_iovlen = 1;
+        const ssize_t result = sendmsg(fd, &hdr, MSG_DONTWAIT);
+        ++stats.tx_syscalls;
+        if (result < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNREFUSED)
+            {
+                LOG_ERROR("sendmsg failed: {}", strerror(errno));
+            }
+            break;
+        }
+        ++sent;
+        offset += iov.iov_len;
+    }
+    return sent;
+}
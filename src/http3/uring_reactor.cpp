@@ -0,0 +1,543 @@
+// src/http3/uring_reactor.cpp
+/**
+ * @file uring_reactor.cpp
+ * @brief Реализация реактора на io_uring (multishot recvmsg + зарегистрированные буферы).
+ *
+ * @author Telian Edward <telianedward@icloud.com>
+ * @assisted-by AI-Assistant
+ * @date 2025-11-11
+ * @version 1.0
+ * @license MIT
+ */
+#include "../../include/http3/uring_reactor.hpp"
+#include "../../include/http3/udp_batch.hpp"
+#include "../../include/logger/logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <csignal>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+// Тип операции хранится в старших битах user_data, индекс — в младших
+constexpr uint64_t UD_RECV = 1ULL << 62;
+constexpr uint64_t UD_SEND = 2ULL << 62;
+constexpr uint64_t UD_KIND_MASK = 3ULL << 62;
+constexpr uint16_t RECV_BUFFER_GROUP = 0;
+
+int sys_io_uring_setup(unsigned entries, io_uring_params *p) noexcept
+{
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+}
+
+int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags, void *arg, size_t argsz) noexcept
+{
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz));
+}
+
+int sys_io_uring_register(int fd, unsigned opcode, const void *arg, unsigned nr_args) noexcept
+{
+    return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+} // namespace
+
+UringReactor::UringReactor(unsigned entries, unsigned buffer_count, size_t payload_size, size_t control_size)
+    : entries_(entries),
+      buffer_count_(buffer_count),
+      payload_size_(payload_size),
+      control_size_(control_size),
+      // Выравниваем буферы по кэш-линии: cmsg внутри буфера должен быть выровнен как cmsghdr
+      buffer_size_((sizeof(io_uring_recvmsg_out) + sizeof(sockaddr_in) + control_size + payload_size + 63) & ~size_t{63})
+{
+    // Число буферов в кольце должно быть степенью двойки
+    unsigned count = 1;
+    while (count < buffer_count_ && count < 32768)
+    {
+        count <<= 1;
+    }
+    buffer_count_ = count;
+}
+
+UringReactor::~UringReactor()
+{
+    release();
+}
+
+void UringReactor::release() noexcept
+{
+    if (ring_fd_ != -1)
+    {
+        ::close(ring_fd_);
+        ring_fd_ = -1;
+    }
+    if (sqes_)
+    {
+        munmap(sqes_, sqes_size_);
+        sqes_ = nullptr;
+    }
+    if (cq_ring_ && cq_ring_ != sq_ring_)
+    {
+        munmap(cq_ring_, cq_ring_size_);
+    }
+    cq_ring_ = nullptr;
+    if (sq_ring_)
+    {
+        munmap(sq_ring_, sq_ring_size_);
+        sq_ring_ = nullptr;
+    }
+    if (buf_ring_)
+    {
+        munmap(buf_ring_, buf_ring_size_);
+        buf_ring_ = nullptr;
+    }
+    if (buffers_)
+    {
+        munmap(buffers_, buffer_size_ * buffer_count_);
+        buffers_ = nullptr;
+    }
+}
+
+bool UringReactor::init(const std::vector<int> &fds) noexcept
+{
+    // --- Создание кольца ---
+    io_uring_params params{};
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN |
+                   IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+    params.cq_entries = entries_ * 4;
+    ring_fd_ = sys_io_uring_setup(entries_, &params);
+    if (ring_fd_ < 0 && errno == EINVAL)
+    {
+        // Старое ядро — пробуем без дополнительных флагов
+        params = io_uring_params{};
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = entries_ * 4;
+        ring_fd_ = sys_io_uring_setup(entries_, &params);
+    }
+    if (ring_fd_ < 0)
+    {
+        LOG_ERROR("[ERROR] io_uring_setup failed: {}", strerror(errno));
+        return false;
+    }
+    if (!(params.features & IORING_FEAT_EXT_ARG) || !(params.features & IORING_FEAT_NODROP))
+    {
+        LOG_ERROR("[ERROR] Ядро не поддерживает IORING_FEAT_EXT_ARG/NODROP");
+        errno = ENOTSUP;
+        release();
+        return false;
+    }
+
+    // --- Отображение колец в память ---
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        sq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+        cq_ring_size_ = sq_ring_size_;
+    }
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED)
+    {
+        sq_ring_ = nullptr;
+        LOG_ERROR("[ERROR] mmap SQ ring failed: {}", strerror(errno));
+        release();
+        return false;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        cq_ring_ = sq_ring_;
+    }
+    else
+    {
+        cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+        if (cq_ring_ == MAP_FAILED)
+        {
+            cq_ring_ = nullptr;
+            LOG_ERROR("[ERROR] mmap CQ ring failed: {}", strerror(errno));
+            release();
+            return false;
+        }
+    }
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+        LOG_ERROR("[ERROR] mmap SQEs failed: {}", strerror(errno));
+        release();
+        return false;
+    }
+    sqes_ = static_cast<io_uring_sqe *>(sqes);
+
+    auto *sq = static_cast<uint8_t *>(sq_ring_);
+    sq_head_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sq_mask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    sq_entries_ = params.sq_entries;
+
+    auto *cq = static_cast<uint8_t *>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cq_mask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    // --- Регистрация сокетов как fixed files ---
+    fds_ = fds;
+    rearm_pending_.assign(fds_.size(), false);
+    if (sys_io_uring_register(ring_fd_, IORING_REGISTER_FILES, fds_.data(), static_cast<unsigned>(fds_.size())) < 0)
+    {
+        LOG_ERROR("[ERROR] IORING_REGISTER_FILES failed: {}", strerror(errno));
+        release();
+        return false;
+    }
+
+    // --- Кольцо буферов приёма (IORING_REGISTER_PBUF_RING) ---
+    buf_ring_size_ = buffer_count_ * sizeof(io_uring_buf);
+    void *ring_mem = mmap(nullptr, buf_ring_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    void *buf_mem = mmap(nullptr, buffer_size_ * buffer_count_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring_mem == MAP_FAILED || buf_mem == MAP_FAILED)
+    {
+        LOG_ERROR("[ERROR] mmap буферов приёма failed: {}", strerror(errno));
+        if (ring_mem != MAP_FAILED)
+            munmap(ring_mem, buf_ring_size_);
+        if (buf_mem != MAP_FAILED)
+            munmap(buf_mem, buffer_size_ * buffer_count_);
+        release();
+        return false;
+    }
+    buf_ring_ = static_cast<io_uring_buf_ring *>(ring_mem);
+    buffers_ = static_cast<uint8_t *>(buf_mem);
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring_);
+    reg.ring_entries = buffer_count_;
+    reg.bgid = RECV_BUFFER_GROUP;
+    if (sys_io_uring_register(ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+    {
+        LOG_ERROR("[ERROR] IORING_REGISTER_PBUF_RING failed: {}", strerror(errno));
+        release();
+        return false;
+    }
+    std::vector<uint16_t> all(buffer_count_);
+    for (unsigned i = 0; i < buffer_count_; ++i)
+    {
+        all[i] = static_cast<uint16_t>(i);
+    }
+    return_buffers(all);
+    buffer_sends_.assign(buffer_count_, 0);
+    buffer_held_.assign(buffer_count_, 0);
+
+    // --- Слоты отправки: не больше, чем CQE помещается в кольцо ---
+    send_slots_.resize(params.cq_entries);
+    free_slots_.resize(params.cq_entries);
+    for (unsigned i = 0; i < params.cq_entries; ++i)
+    {
+        free_slots_[i] = params.cq_entries - 1 - i;
+    }
+
+    // --- Multishot recvmsg на каждый сокет ---
+    recv_template_ = msghdr{};
+    recv_template_.msg_namelen = sizeof(sockaddr_in);
+    recv_template_.msg_controllen = control_size_;
+    for (size_t i = 0; i < fds_.size(); ++i)
+    {
+        arm_recv(static_cast<int>(i));
+    }
+
+    LOG_INFO("[INFO] io_uring: SQ={}, CQ={}, буферов приёма={} по {} байт",
+             params.sq_entries, params.cq_entries, buffer_count_, buffer_size_);
+    return true;
+}
+
+io_uring_sqe *UringReactor::get_sqe() noexcept
+{
+    unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    unsigned tail = *sq_tail_ + sq_pending_;
+    if (tail - head >= sq_entries_)
+    {
+        // SQ заполнена — передаём накопленное ядру без ожидания
+        if (enter(sq_pending_, 0, 0) < 0)
+        {
+            return nullptr;
+        }
+        head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        tail = *sq_tail_ + sq_pending_;
+        if (tail - head >= sq_entries_)
+        {
+            return nullptr;
+        }
+    }
+    unsigned index = tail & *sq_mask_;
+    io_uring_sqe *sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array_[index] = index;
+    ++sq_pending_;
+    return sqe;
+}
+
+void UringReactor::arm_recv(int socket_index) noexcept
+{
+    io_uring_sqe *sqe = get_sqe();
+    if (!sqe)
+    {
+        rearm_pending_[socket_index] = true;
+        return;
+    }
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = socket_index;
+    sqe->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->addr = reinterpret_cast<uint64_t>(&recv_template_);
+    sqe->buf_group = RECV_BUFFER_GROUP;
+    sqe->user_data = UD_RECV | static_cast<uint64_t>(socket_index);
+    rearm_pending_[socket_index] = false;
+}
+
+void UringReactor::return_buffers(std::vector<uint16_t> &bids) noexcept
+{
+    if (bids.empty())
+    {
+        return;
+    }
+    const unsigned mask = buffer_count_ - 1;
+    // В C++ пустая структура внутри __DECLARE_FLEX_ARRAY имеет размер 1 и сдвигает bufs[] —
+    // адресуем записи кольца напрямую, как это делает ядро
+    auto *ring = reinterpret_cast<io_uring_buf *>(buf_ring_);
+    for (uint16_t bid : bids)
+    {
+        io_uring_buf &buf = ring[buf_tail_ & mask];
+        buf.addr = reinterpret_cast<uint64_t>(buffers_ + static_cast<size_t>(bid) * buffer_size_);
+        buf.len = static_cast<uint32_t>(buffer_size_);
+        buf.bid = bid;
+        ++buf_tail_;
+    }
+    __atomic_store_n(&buf_ring_->tail, buf_tail_, __ATOMIC_RELEASE);
+    bids.clear();
+
+    // Приём, остановленный из-за ENOBUFS, можно возобновить
+    for (size_t i = 0; i < rearm_pending_.size(); ++i)
+    {
+        if (rearm_pending_[i])
+        {
+            arm_recv(static_cast<int>(i));
+        }
+    }
+}
+
+bool UringReactor::queue_send(int socket_index, const msghdr &msg) noexcept
+{
+    if (free_slots_.empty())
+    {
+        return false;
+    }
+    io_uring_sqe *sqe = get_sqe();
+    if (!sqe)
+    {
+        return false;
+    }
+    uint32_t slot_index = free_slots_.back();
+    free_slots_.pop_back();
+
+    SendSlot &slot = send_slots_[slot_index];
+    slot.iov = msg.msg_iov[0];
+    std::memcpy(&slot.addr, msg.msg_name, sizeof(sockaddr_in));
+    slot.msg = msghdr{};
+    slot.msg.msg_name = &slot.addr;
+    slot.msg.msg_namelen = sizeof(sockaddr_in);
+    slot.msg.msg_iov = &slot.iov;
+    slot.msg.msg_iovlen = 1;
+    if (msg.msg_control != nullptr && msg.msg_controllen > 0 && msg.msg_controllen <= sizeof(slot.control))
+    {
+        std::memcpy(slot.control, msg.msg_control, msg.msg_controllen);
+        slot.msg.msg_control = slot.control;
+        slot.msg.msg_controllen = msg.msg_controllen;
+    }
+    // Данные из буфера приёма (сегменты GSO непрерывны и не выходят за один буфер)
+    const auto *data = static_cast<const uint8_t *>(slot.iov.iov_base);
+    slot.buffer = -1;
+    if (data >= buffers_ && data < buffers_ + buffer_size_ * buffer_count_)
+    {
+        slot.buffer = static_cast<int32_t>(static_cast<size_t>(data - buffers_) / buffer_size_);
+        ++buffer_sends_[static_cast<size_t>(slot.buffer)];
+    }
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = socket_index;
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->addr = reinterpret_cast<uint64_t>(&slot.msg);
+    sqe->len = 1;
+    sqe->user_data = UD_SEND | slot_index;
+    ++sends_in_flight_;
+    return true;
+}
+
+int UringReactor::enter(unsigned to_submit, unsigned min_complete, int timeout_ms) noexcept
+{
+    // Публикуем хвост SQ перед передачей ядру
+    __atomic_store_n(sq_tail_, *sq_tail_ + sq_pending_, __ATOMIC_RELEASE);
+    sq_pending_ = 0;
+
+    unsigned flags = IORING_ENTER_GETEVENTS;
+    __kernel_timespec ts{};
+    io_uring_getevents_arg arg{};
+    void *argp = nullptr;
+    size_t argsz = 0;
+    if (min_complete > 0)
+    {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = static_cast<long long>(timeout_ms % 1000) * 1000000LL;
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+        arg.sigmask_sz = _NSIG / 8;
+        flags |= IORING_ENTER_EXT_ARG;
+        argp = &arg;
+        argsz = sizeof(arg);
+    }
+    ++enter_calls_;
+    int ret = sys_io_uring_enter(ring_fd_, to_submit, min_complete, flags, argp, argsz);
+    if (ret < 0 && (errno == ETIME || errno == EINTR || errno == EAGAIN || errno == EBUSY))
+    {
+        return 0;
+    }
+    return ret;
+}
+
+int UringReactor::run_once(int timeout_ms, const std::function<void(const UringDatagram &)> &on_datagram) noexcept
+{
+    if (enter(sq_pending_, 1, timeout_ms) < 0)
+    {
+        LOG_ERROR("[ERROR] io_uring_enter failed: {}", strerror(errno));
+        return -1;
+    }
+
+    int processed = 0;
+    unsigned head = *cq_head_;
+    const unsigned mask = *cq_mask_;
+    for (;;)
+    {
+        unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        if (head == tail)
+        {
+            break;
+        }
+        const io_uring_cqe cqe = cqes_[head & mask];
+        ++head;
+        // Освобождаем CQE сразу: обработчик может поставить новые SQE
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+        ++processed;
+
+        const uint64_t kind = cqe.user_data & UD_KIND_MASK;
+        const uint64_t index = cqe.user_data & ~UD_KIND_MASK;
+
+        if (kind == UD_SEND)
+        {
+            free_slots_.push_back(static_cast<uint32_t>(index));
+            --sends_in_flight_;
+            if (cqe.res < 0 && cqe.res != -EAGAIN)
+            {
+                LOG_ERROR("io_uring sendmsg failed: {}", strerror(-cqe.res));
+            }
+            // Последняя отправка из отпущенного буфера — буфер возвращается в кольцо
+            const int32_t bid = send_slots_[index].buffer;
+            if (bid >= 0 && --buffer_sends_[static_cast<size_t>(bid)] == 0 && buffer_held_[static_cast<size_t>(bid)])
+            {
+                buffer_held_[static_cast<size_t>(bid)] = 0;
+                released_buffers_.push_back(static_cast<uint16_t>(bid));
+            }
+            continue;
+        }
+        if (kind != UD_RECV)
+        {
+            continue;
+        }
+
+        const int socket_index = static_cast<int>(index);
+        const bool more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+        if (cqe.res < 0)
+        {
+            if (cqe.res == -ENOBUFS)
+            {
+                // Все буферы заняты — возобновим приём после их возврата
+                rearm_pending_[socket_index] = true;
+            }
+            else if (cqe.res == -EINVAL || cqe.res == -EOPNOTSUPP)
+            {
+                // Ядро не поддерживает multishot recvmsg — продолжать бессмысленно
+                LOG_ERROR("io_uring multishot recvmsg не поддерживается: {}", strerror(-cqe.res));
+                errno = -cqe.res;
+                return -1;
+            }
+            else
+            {
+                LOG_ERROR("io_uring recvmsg failed: {}", strerror(-cqe.res));
+                if (!more)
+                {
+                    arm_recv(socket_index);
+                }
+            }
+            continue;
+        }
+        if (cqe.flags & IORING_CQE_F_BUFFER)
+        {
+            const uint16_t bid = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+            uint8_t *buf = buffers_ + static_cast<size_t>(bid) * buffer_size_;
+            const auto *out = reinterpret_cast<const io_uring_recvmsg_out *>(buf);
+            uint8_t *name = buf + sizeof(io_uring_recvmsg_out);
+            uint8_t *payload = name + recv_template_.msg_namelen + recv_template_.msg_controllen;
+            used_buffers_.push_back(bid);
+
+            UringDatagram dgram{};
+            dgram.socket_index = socket_index;
+            dgram.data = payload;
+            const size_t capacity = buffer_size_ - sizeof(io_uring_recvmsg_out) -
+                                    recv_template_.msg_namelen - recv_template_.msg_controllen;
+            dgram.len = std::min<size_t>(out->payloadlen, capacity);
+            dgram.addr = reinterpret_cast<const sockaddr_in *>(name);
+            dgram.addr_len = static_cast<socklen_t>(out->namelen);
+            dgram.truncated = (out->flags & MSG_TRUNC) != 0 || out->payloadlen > capacity;
+            dgram.segment_size = dgram.len;
+            if (control_size_ > 0 && out->controllen > 0)
+            {
+                msghdr control{};
+                control.msg_control = name + recv_template_.msg_namelen;
+                control.msg_controllen = std::min<size_t>(out->controllen, control_size_);
+                const size_t segment = udp_gro_segment_size(control);
+                if (segment > 0 && segment < dgram.len)
+                {
+                    dgram.segment_size = segment;
+                }
+            }
+            on_datagram(dgram);
+        }
+        if (!more)
+        {
+            arm_recv(socket_index);
+        }
+    }
+    if (!released_buffers_.empty())
+    {
+        return_buffers(released_buffers_);
+    }
+    return processed;
+}
+
+void UringReactor::recycle_buffers() noexcept
+{
+    // Буферы без незавершённых отправок — сразу в кольцо, остальные — по CQE последней отправки
+    size_t kept = 0;
+    for (uint16_t bid : used_buffers_)
+    {
+        if (buffer_sends_[bid] == 0)
+        {
+            used_buffers_[kept++] = bid;
+        }
+        else
+        {
+            buffer_held_[bid] = 1;
+        }
+    }
+    used_buffers_.resize(kept);
+    return_buffers(used_buffers_);
+}